@@ -0,0 +1,1306 @@
+
+//
+// AUTOTUNE.C
+//
+// Vector width autotuner with a per-host kernel selection profile.
+//
+// CPUIDEX.C shows which of SSE4.2, AVX2, AVX-512, and AVX10 are present, but
+// a present extension is not necessarily the fastest one: 512-bit code can
+// lower the clock, gathers are microcoded on some cores, and under emulation
+// the wider the vector the more it usually costs.  This runs a reduction, a
+// memchr-style scan, a 16-bit dot product, a prefix sum, and a table lookup
+// as portable C and at every width the CPU and the OS support, checks every
+// variant against the C one, and picks the fastest per kernel and buffer
+// size.  A wider variant has to beat a narrower one by WIN_MARGIN to be
+// picked, as the wider registers cost power that the benchmark can't see.
+//
+// The AVX10/256 variants use the AVX-512 instructions on 256-bit registers
+// with masked tails, which is all that an AVX10/256 CPU implements and is
+// also how compilers use AVX-512 by default.
+//
+// The selection can be saved as a profile that services load at startup
+// instead of benchmarking again.  The profile is a text file:
+//
+//   # comment
+//   version 1
+//   signature <vendor>-<leaf 1 EAX>-<ECX>-<EDX>-<leaf 7 EBX>-<ECX>-<EDX>-<leaf 7.1 EDX>-<XCR0>-<build>-<host>
+//   <kernel> <bytes> <variant>
+//
+// A profile is only valid on a host with the same signature, which covers
+// the CPU model and stepping, the features the hypervisor passes through,
+// the register state the OS enables, the binary's ISA, and whether that
+// binary runs emulated.
+//
+// Usage: autotune [-csv] [-save file] [-load file]
+//
+//   -csv   print machine-readable comma-separated records only
+//   -save  write the selection to a profile
+//   -load  check that a profile was made on this host and show it, without
+//          running any benchmark; the exit code is 0 if the profile is valid
+//
+// The -csv records are:
+//
+//   result,kernel,variant,bytes,bytes per tick,check
+//   winner,kernel,bytes,variant,speedup over C
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <intrin.h>
+
+#define MAX_BYTES       (32 * 1024 * 1024)
+#define TARGET_BYTES    (64 * 1024 * 1024)   // bytes processed per trial
+#define TRIALS          (5)                  // the fastest trial is reported
+#define CHECK_BYTES     (4096 + 77)          // odd size so that the tails are checked too
+#define WIN_MARGIN      (1.03)
+#define PROFILE_VERSION (1)
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+#define HAS_X86_SIMD    (1)
+#endif
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+bool CsvOutput = false;
+
+uint32_t Table[256];                   // for the table lookup kernels
+
+//
+// Every kernel takes a buffer of bytes, may write up to as many bytes of
+// output, and returns a result.  Elements that don't fill a whole vector
+// are handled by a scalar tail loop, or by masked loads and stores where
+// AVX-512 provides them.
+//
+
+typedef uint64_t (KERNEL)(const uint8_t *In, uint8_t *Out, size_t Bytes);
+
+// ----------------------------------------------------------------------------
+// Portable C versions, also the reference for the checks.
+// ----------------------------------------------------------------------------
+
+// sum of 32-bit elements, modulo 2^32
+
+uint64_t KernelReduceC(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    size_t Count = Bytes / 4;
+    uint32_t Sum = 0;
+
+    (void)Out;
+
+    for (size_t i = 0; i < Count; i++)
+        Sum += p[i];
+
+    return Sum;
+}
+
+// offset of the first zero byte, or Bytes if there is none
+
+uint64_t KernelScanC(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    (void)Out;
+
+    for (size_t i = 0; i < Bytes; i++)
+    {
+        if (In[i] == 0)
+            return i;
+    }
+
+    return Bytes;
+}
+
+// dot product of the 16-bit elements in the two halves of the buffer, modulo 2^32
+
+uint64_t KernelDotC(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    size_t Count = Bytes / 4;
+    const int16_t *a = (const int16_t *)In;
+    const int16_t *b = (const int16_t *)(In + Count * 2);
+    uint32_t Sum = 0;
+
+    (void)Out;
+
+    for (size_t i = 0; i < Count; i++)
+        Sum += (uint32_t)((int32_t)a[i] * b[i]);
+
+    return Sum;
+}
+
+// inclusive prefix sum of 32-bit elements, returns the total
+
+uint64_t KernelPrefixC(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+    uint32_t Sum = 0;
+
+    for (size_t i = 0; i < Count; i++)
+    {
+        Sum += p[i];
+        q[i] = Sum;
+    }
+
+    return Sum;
+}
+
+// look up the low byte of each 32-bit element in a table of 256 32-bit values
+
+uint64_t KernelLookupC(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+
+    for (size_t i = 0; i < Count; i++)
+        q[i] = Table[p[i] & 255];
+
+    return 0;
+}
+
+#if HAS_X86_SIMD
+
+uint32_t FirstBit32(uint32_t Mask)
+{
+    unsigned long Index;
+
+    _BitScanForward(&Index, Mask);
+    return Index;
+}
+
+// _BitScanForward64 is not available to 32-bit code
+
+uint32_t FirstBit64(uint64_t Mask)
+{
+    if ((uint32_t)Mask != 0)
+        return FirstBit32((uint32_t)Mask);
+
+    return 32 + FirstBit32((uint32_t)(Mask >> 32));
+}
+
+// the mask of the lanes still to do out of a vector of Lanes lanes
+
+uint32_t TailMask32(size_t Left, uint32_t Lanes)
+{
+    return (Left >= Lanes) ? (uint32_t)(((uint64_t)1 << Lanes) - 1) : (uint32_t)(((uint64_t)1 << Left) - 1);
+}
+
+uint64_t TailMask64(size_t Left)
+{
+    return (Left >= 64) ? ~0ull : ((1ull << Left) - 1);
+}
+
+uint32_t HorizontalAdd128(__m128i x)
+{
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0x4E));
+    x = _mm_add_epi32(x, _mm_shuffle_epi32(x, 0xB1));
+
+    return (uint32_t)_mm_cvtsi128_si32(x);
+}
+
+uint32_t HorizontalAdd256(__m256i x)
+{
+    return HorizontalAdd128(_mm_add_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1)));
+}
+
+// ----------------------------------------------------------------------------
+// Reduction.
+// ----------------------------------------------------------------------------
+
+uint64_t KernelReduce128(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    size_t Count = Bytes / 4;
+    size_t i = 0;
+    __m128i Sum0 = _mm_setzero_si128();
+    __m128i Sum1 = _mm_setzero_si128();
+
+    (void)Out;
+
+    for (; i + 8 <= Count; i += 8)
+    {
+        Sum0 = _mm_add_epi32(Sum0, _mm_loadu_si128((const __m128i *)(p + i)));
+        Sum1 = _mm_add_epi32(Sum1, _mm_loadu_si128((const __m128i *)(p + i + 4)));
+    }
+
+    uint32_t Sum = HorizontalAdd128(_mm_add_epi32(Sum0, Sum1));
+
+    for (; i < Count; i++)
+        Sum += p[i];
+
+    return Sum;
+}
+
+uint64_t KernelReduce256(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    size_t Count = Bytes / 4;
+    size_t i = 0;
+    __m256i Sum0 = _mm256_setzero_si256();
+    __m256i Sum1 = _mm256_setzero_si256();
+
+    (void)Out;
+
+    for (; i + 16 <= Count; i += 16)
+    {
+        Sum0 = _mm256_add_epi32(Sum0, _mm256_loadu_si256((const __m256i *)(p + i)));
+        Sum1 = _mm256_add_epi32(Sum1, _mm256_loadu_si256((const __m256i *)(p + i + 8)));
+    }
+
+    uint32_t Sum = HorizontalAdd256(_mm256_add_epi32(Sum0, Sum1));
+
+    for (; i < Count; i++)
+        Sum += p[i];
+
+    return Sum;
+}
+
+uint64_t KernelReduceAvx10(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    size_t Count = Bytes / 4;
+    size_t i = 0;
+    __m256i Sum0 = _mm256_setzero_si256();
+    __m256i Sum1 = _mm256_setzero_si256();
+
+    (void)Out;
+
+    for (; i + 16 <= Count; i += 16)
+    {
+        Sum0 = _mm256_add_epi32(Sum0, _mm256_loadu_si256((const __m256i *)(p + i)));
+        Sum1 = _mm256_add_epi32(Sum1, _mm256_loadu_si256((const __m256i *)(p + i + 8)));
+    }
+
+    for (; i < Count; i += 8)
+        Sum0 = _mm256_add_epi32(Sum0, _mm256_maskz_loadu_epi32((__mmask8)TailMask32(Count - i, 8), p + i));
+
+    return HorizontalAdd256(_mm256_add_epi32(Sum0, Sum1));
+}
+
+uint64_t KernelReduce512(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    size_t Count = Bytes / 4;
+    size_t i = 0;
+    __m512i Sum0 = _mm512_setzero_si512();
+    __m512i Sum1 = _mm512_setzero_si512();
+
+    (void)Out;
+
+    for (; i + 32 <= Count; i += 32)
+    {
+        Sum0 = _mm512_add_epi32(Sum0, _mm512_loadu_si512(p + i));
+        Sum1 = _mm512_add_epi32(Sum1, _mm512_loadu_si512(p + i + 16));
+    }
+
+    for (; i < Count; i += 16)
+        Sum0 = _mm512_add_epi32(Sum0, _mm512_maskz_loadu_epi32((__mmask16)TailMask32(Count - i, 16), p + i));
+
+    return (uint32_t)_mm512_reduce_add_epi32(_mm512_add_epi32(Sum0, Sum1));
+}
+
+// ----------------------------------------------------------------------------
+// Scan for a zero byte.
+// ----------------------------------------------------------------------------
+
+uint64_t KernelScan128(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const __m128i Zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    (void)Out;
+
+    for (; i + 16 <= Bytes; i += 16)
+    {
+        uint32_t Mask = (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(In + i)), Zero));
+
+        if (Mask != 0)
+            return i + FirstBit32(Mask);
+    }
+
+    for (; i < Bytes; i++)
+    {
+        if (In[i] == 0)
+            return i;
+    }
+
+    return Bytes;
+}
+
+uint64_t KernelScan256(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const __m256i Zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    (void)Out;
+
+    for (; i + 32 <= Bytes; i += 32)
+    {
+        uint32_t Mask = (uint32_t)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(In + i)), Zero));
+
+        if (Mask != 0)
+            return i + FirstBit32(Mask);
+    }
+
+    for (; i < Bytes; i++)
+    {
+        if (In[i] == 0)
+            return i;
+    }
+
+    return Bytes;
+}
+
+// the masked-off lanes load as zero, so they are masked off in the compare too
+
+uint64_t KernelScanAvx10(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const __m256i Zero = _mm256_setzero_si256();
+
+    (void)Out;
+
+    for (size_t i = 0; i < Bytes; i += 32)
+    {
+        __mmask32 Load = TailMask32(Bytes - i, 32);
+        __mmask32 Mask = _mm256_mask_cmpeq_epi8_mask(Load, _mm256_maskz_loadu_epi8(Load, In + i), Zero);
+
+        if (Mask != 0)
+            return i + FirstBit32(Mask);
+    }
+
+    return Bytes;
+}
+
+uint64_t KernelScan512(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const __m512i Zero = _mm512_setzero_si512();
+
+    (void)Out;
+
+    for (size_t i = 0; i < Bytes; i += 64)
+    {
+        __mmask64 Load = TailMask64(Bytes - i);
+        __mmask64 Mask = _mm512_mask_cmpeq_epi8_mask(Load, _mm512_maskz_loadu_epi8(Load, In + i), Zero);
+
+        if (Mask != 0)
+            return i + FirstBit64(Mask);
+    }
+
+    return Bytes;
+}
+
+// ----------------------------------------------------------------------------
+// 16-bit dot product.  PMADDWD adds two products, which only overflows for
+// -32768 * -32768 twice, and then wraps just like the C version.
+// ----------------------------------------------------------------------------
+
+uint64_t KernelDot128(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    size_t Count = Bytes / 4;
+    const int16_t *a = (const int16_t *)In;
+    const int16_t *b = (const int16_t *)(In + Count * 2);
+    size_t i = 0;
+    __m128i Sum = _mm_setzero_si128();
+
+    (void)Out;
+
+    for (; i + 8 <= Count; i += 8)
+        Sum = _mm_add_epi32(Sum, _mm_madd_epi16(_mm_loadu_si128((const __m128i *)(a + i)), _mm_loadu_si128((const __m128i *)(b + i))));
+
+    uint32_t Total = HorizontalAdd128(Sum);
+
+    for (; i < Count; i++)
+        Total += (uint32_t)((int32_t)a[i] * b[i]);
+
+    return Total;
+}
+
+uint64_t KernelDot256(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    size_t Count = Bytes / 4;
+    const int16_t *a = (const int16_t *)In;
+    const int16_t *b = (const int16_t *)(In + Count * 2);
+    size_t i = 0;
+    __m256i Sum = _mm256_setzero_si256();
+
+    (void)Out;
+
+    for (; i + 16 <= Count; i += 16)
+        Sum = _mm256_add_epi32(Sum, _mm256_madd_epi16(_mm256_loadu_si256((const __m256i *)(a + i)), _mm256_loadu_si256((const __m256i *)(b + i))));
+
+    uint32_t Total = HorizontalAdd256(Sum);
+
+    for (; i < Count; i++)
+        Total += (uint32_t)((int32_t)a[i] * b[i]);
+
+    return Total;
+}
+
+uint64_t KernelDotAvx10(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    size_t Count = Bytes / 4;
+    const int16_t *a = (const int16_t *)In;
+    const int16_t *b = (const int16_t *)(In + Count * 2);
+    __m256i Sum = _mm256_setzero_si256();
+
+    (void)Out;
+
+    for (size_t i = 0; i < Count; i += 16)
+    {
+        __mmask16 Mask = (__mmask16)TailMask32(Count - i, 16);
+
+        Sum = _mm256_add_epi32(Sum, _mm256_madd_epi16(_mm256_maskz_loadu_epi16(Mask, a + i), _mm256_maskz_loadu_epi16(Mask, b + i)));
+    }
+
+    return HorizontalAdd256(Sum);
+}
+
+uint64_t KernelDot512(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    size_t Count = Bytes / 4;
+    const int16_t *a = (const int16_t *)In;
+    const int16_t *b = (const int16_t *)(In + Count * 2);
+    __m512i Sum = _mm512_setzero_si512();
+
+    (void)Out;
+
+    for (size_t i = 0; i < Count; i += 32)
+    {
+        __mmask32 Mask = TailMask32(Count - i, 32);
+
+        Sum = _mm512_add_epi32(Sum, _mm512_madd_epi16(_mm512_maskz_loadu_epi16(Mask, a + i), _mm512_maskz_loadu_epi16(Mask, b + i)));
+    }
+
+    return (uint32_t)_mm512_reduce_add_epi32(Sum);
+}
+
+// ----------------------------------------------------------------------------
+// Prefix sum.  Each vector is scanned in log2(lanes) shift and add steps,
+// then the running total from the previous vector is added to every lane.
+// ----------------------------------------------------------------------------
+
+uint64_t KernelPrefix128(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+    size_t i = 0;
+    __m128i Carry = _mm_setzero_si128();
+
+    for (; i + 4 <= Count; i += 4)
+    {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + i));
+
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+        x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+        x = _mm_add_epi32(x, Carry);
+
+        _mm_storeu_si128((__m128i *)(q + i), x);
+        Carry = _mm_shuffle_epi32(x, 0xFF);
+    }
+
+    uint32_t Sum = (uint32_t)_mm_cvtsi128_si32(Carry);
+
+    for (; i < Count; i++)
+    {
+        Sum += p[i];
+        q[i] = Sum;
+    }
+
+    return Sum;
+}
+
+// the byte shifts only work within each 128-bit lane, so the low lane's
+// total is added to the high lane separately
+
+uint64_t KernelPrefix256(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+    size_t i = 0;
+    const __m256i Last = _mm256_set1_epi32(7);
+    __m256i Carry = _mm256_setzero_si256();
+
+    for (; i + 8 <= Count; i += 8)
+    {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + i));
+
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 4));
+        x = _mm256_add_epi32(x, _mm256_slli_si256(x, 8));
+
+        __m256i LaneTotals = _mm256_shuffle_epi32(x, 0xFF);
+
+        x = _mm256_add_epi32(x, _mm256_permute2x128_si256(LaneTotals, LaneTotals, 0x08));
+        x = _mm256_add_epi32(x, Carry);
+
+        _mm256_storeu_si256((__m256i *)(q + i), x);
+        Carry = _mm256_permutevar8x32_epi32(x, Last);
+    }
+
+    uint32_t Sum = (uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(Carry));
+
+    for (; i < Count; i++)
+    {
+        Sum += p[i];
+        q[i] = Sum;
+    }
+
+    return Sum;
+}
+
+// VALIGND shifts across the whole register, and the masked-off lanes of
+// the tail load as zero so they don't change the running total
+
+uint64_t KernelPrefixAvx10(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+    const __m256i Zero = _mm256_setzero_si256();
+    const __m256i Last = _mm256_set1_epi32(7);
+    __m256i Carry = _mm256_setzero_si256();
+
+    for (size_t i = 0; i < Count; i += 8)
+    {
+        __mmask8 Mask = (__mmask8)TailMask32(Count - i, 8);
+        __m256i x = _mm256_maskz_loadu_epi32(Mask, p + i);
+
+        x = _mm256_add_epi32(x, _mm256_alignr_epi32(x, Zero, 7));
+        x = _mm256_add_epi32(x, _mm256_alignr_epi32(x, Zero, 6));
+        x = _mm256_add_epi32(x, _mm256_alignr_epi32(x, Zero, 4));
+        x = _mm256_add_epi32(x, Carry);
+
+        _mm256_mask_storeu_epi32(q + i, Mask, x);
+        Carry = _mm256_permutexvar_epi32(Last, x);
+    }
+
+    return (uint32_t)_mm_cvtsi128_si32(_mm256_castsi256_si128(Carry));
+}
+
+uint64_t KernelPrefix512(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+    const __m512i Zero = _mm512_setzero_si512();
+    const __m512i Last = _mm512_set1_epi32(15);
+    __m512i Carry = _mm512_setzero_si512();
+
+    for (size_t i = 0; i < Count; i += 16)
+    {
+        __mmask16 Mask = (__mmask16)TailMask32(Count - i, 16);
+        __m512i x = _mm512_maskz_loadu_epi32(Mask, p + i);
+
+        x = _mm512_add_epi32(x, _mm512_alignr_epi32(x, Zero, 15));
+        x = _mm512_add_epi32(x, _mm512_alignr_epi32(x, Zero, 14));
+        x = _mm512_add_epi32(x, _mm512_alignr_epi32(x, Zero, 12));
+        x = _mm512_add_epi32(x, _mm512_alignr_epi32(x, Zero, 8));
+        x = _mm512_add_epi32(x, Carry);
+
+        _mm512_mask_storeu_epi32(q + i, Mask, x);
+        Carry = _mm512_permutexvar_epi32(Last, x);
+    }
+
+    return (uint32_t)_mm_cvtsi128_si32(_mm512_castsi512_si128(Carry));
+}
+
+// ----------------------------------------------------------------------------
+// Table lookup.  SSE has no gather, so the 128-bit version does scalar loads
+// and vector stores, which is what compilers do too.
+// ----------------------------------------------------------------------------
+
+uint64_t KernelLookup128(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+    size_t i = 0;
+
+    for (; i + 4 <= Count; i += 4)
+    {
+        __m128i x = _mm_setr_epi32(Table[p[i] & 255], Table[p[i + 1] & 255], Table[p[i + 2] & 255], Table[p[i + 3] & 255]);
+
+        _mm_storeu_si128((__m128i *)(q + i), x);
+    }
+
+    for (; i < Count; i++)
+        q[i] = Table[p[i] & 255];
+
+    return 0;
+}
+
+uint64_t KernelLookup256(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+    size_t i = 0;
+    const __m256i Index = _mm256_set1_epi32(255);
+
+    for (; i + 8 <= Count; i += 8)
+    {
+        __m256i x = _mm256_and_si256(_mm256_loadu_si256((const __m256i *)(p + i)), Index);
+
+        _mm256_storeu_si256((__m256i *)(q + i), _mm256_i32gather_epi32((const int *)Table, x, 4));
+    }
+
+    for (; i < Count; i++)
+        q[i] = Table[p[i] & 255];
+
+    return 0;
+}
+
+uint64_t KernelLookupAvx10(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+    const __m256i Index = _mm256_set1_epi32(255);
+
+    for (size_t i = 0; i < Count; i += 8)
+    {
+        __mmask8 Mask = (__mmask8)TailMask32(Count - i, 8);
+        __m256i x = _mm256_and_si256(_mm256_maskz_loadu_epi32(Mask, p + i), Index);
+
+        x = _mm256_mmask_i32gather_epi32(_mm256_setzero_si256(), Mask, x, Table, 4);
+        _mm256_mask_storeu_epi32(q + i, Mask, x);
+    }
+
+    return 0;
+}
+
+uint64_t KernelLookup512(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    const uint32_t *p = (const uint32_t *)In;
+    uint32_t *q = (uint32_t *)Out;
+    size_t Count = Bytes / 4;
+    const __m512i Index = _mm512_set1_epi32(255);
+
+    for (size_t i = 0; i < Count; i += 16)
+    {
+        __mmask16 Mask = (__mmask16)TailMask32(Count - i, 16);
+        __m512i x = _mm512_and_si512(_mm512_maskz_loadu_epi32(Mask, p + i), Index);
+
+        x = _mm512_mask_i32gather_epi32(_mm512_setzero_si512(), Mask, x, Table, 4);
+        _mm512_mask_storeu_epi32(q + i, Mask, x);
+    }
+
+    return 0;
+}
+
+#endif // HAS_X86_SIMD
+
+// ----------------------------------------------------------------------------
+// Feature checks, including OS support for the YMM, ZMM, and opmask state.
+// ----------------------------------------------------------------------------
+
+uint32_t LookUpReg(uint32_t Function, uint32_t Sub, CPUID_REGS Reg)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return (uint32_t)CpuInfo[Reg];
+}
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    return (LookUpReg(Function, Sub, Reg) >> Bit) & 1;
+}
+
+#if HAS_X86_SIMD
+
+bool HasSSE41()    { return LookUpRegBit(1, 0, CPUID_ECX, 19); }
+bool HasSSE42()    { return LookUpRegBit(1, 0, CPUID_ECX, 20); }
+bool HasOSXSAVE()  { return LookUpRegBit(1, 0, CPUID_ECX, 27); }
+bool HasAVX2()     { return LookUpRegBit(7, 0, CPUID_EBX,  5); }
+bool HasAVX512F()  { return LookUpRegBit(7, 0, CPUID_EBX, 16); }
+bool HasAVX512BW() { return LookUpRegBit(7, 0, CPUID_EBX, 30); }
+bool HasAVX512VL() { return LookUpRegBit(7, 0, CPUID_EBX, 31); }
+bool HasAVX10()    { return LookUpRegBit(7, 1, CPUID_EDX, 19); }
+
+bool HasXCR0YMM()  { return HasOSXSAVE() && ((_xgetbv(0) & 0x06) == 0x06); }
+bool HasXCR0KYMM() { return HasOSXSAVE() && ((_xgetbv(0) & 0x26) == 0x26); }
+bool HasXCR0ZMM()  { return HasOSXSAVE() && ((_xgetbv(0) & 0xE6) == 0xE6); }
+
+bool HasWidth128() { return HasSSE41() && HasSSE42(); }
+bool HasWidth256() { return HasXCR0YMM() && HasAVX2(); }
+bool HasAvx10Ymm() { return HasWidth256() && HasXCR0KYMM() && (HasAVX10() || (HasAVX512F() && HasAVX512BW() && HasAVX512VL())); }
+bool HasWidth512() { return HasWidth256() && HasXCR0ZMM() && HasAVX512F() && HasAVX512BW(); }
+
+#endif // HAS_X86_SIMD
+
+bool HasPortable() { return true; }
+
+//
+// The variants, from the narrowest to the widest.
+//
+
+typedef struct VARIANT
+{
+    const char *Name;
+    bool      (*IsPresent)(void);
+} VARIANT;
+
+const VARIANT Variants[] =
+{
+    { "C",         HasPortable  },
+#if HAS_X86_SIMD
+    { "SSE4.2",    HasWidth128  },
+    { "AVX2",      HasWidth256  },
+    { "AVX10/256", HasAvx10Ymm  },
+    { "AVX-512",   HasWidth512  },
+#endif
+};
+
+#define VARIANTS (sizeof(Variants) / sizeof(Variants[0]))
+
+typedef struct KERNEL_INFO
+{
+    const char *Name;
+    KERNEL     *Kernel[VARIANTS];
+} KERNEL_INFO;
+
+#if HAS_X86_SIMD
+#define SIMD_KERNELS(Name) , Kernel##Name##128, Kernel##Name##256, Kernel##Name##Avx10, Kernel##Name##512
+#else
+#define SIMD_KERNELS(Name)
+#endif
+
+const KERNEL_INFO Kernels[] =
+{
+    { "reduce", { KernelReduceC SIMD_KERNELS(Reduce) } },
+    { "scan",   { KernelScanC   SIMD_KERNELS(Scan)   } },
+    { "dot",    { KernelDotC    SIMD_KERNELS(Dot)    } },
+    { "prefix", { KernelPrefixC SIMD_KERNELS(Prefix) } },
+    { "lookup", { KernelLookupC SIMD_KERNELS(Lookup) } },
+};
+
+#define KERNELS (sizeof(Kernels) / sizeof(Kernels[0]))
+
+// L1, L2, last level cache, and memory sized buffers
+
+const size_t Sizes[] = { 4096, 128 * 1024, 4 * 1024 * 1024, MAX_BYTES };
+
+#define SIZES (sizeof(Sizes) / sizeof(Sizes[0]))
+
+double Results[KERNELS][VARIANTS][SIZES];
+uint32_t Winners[KERNELS][SIZES];
+
+// ----------------------------------------------------------------------------
+// Host signature.
+// ----------------------------------------------------------------------------
+
+//
+// The ISA this binary was built for, and the ISA of the machine underneath
+// as reported by IsWow64Process2(), which is not available before Windows 10.
+//
+
+const char *GetBuildArch()
+{
+#if _M_IX86
+    return "x86";
+#elif _M_ARM64EC
+    // check for ARM64EC before AMD64 because AMD64 is defined for it too
+    return "ARM64EC";
+#elif _M_AMD64
+    return "x64";
+#elif _M_ARM64
+    return "ARM64";
+#else
+    return "unknown";
+#endif
+}
+
+USHORT GetHostMachine()
+{
+    BOOL (WINAPI *pfnIsWow64Process2)(HANDLE, USHORT *, USHORT *) = NULL;
+    USHORT ProcessMachine = 0;
+    USHORT NativeMachine = 0;
+    BOOL IsWow = FALSE;
+
+    pfnIsWow64Process2 = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "IsWow64Process2");
+
+    if (pfnIsWow64Process2 && (*pfnIsWow64Process2)(GetCurrentProcess(), &ProcessMachine, &NativeMachine))
+        return NativeMachine;
+
+    if (IsWow64Process(GetCurrentProcess(), &IsWow) && IsWow)
+        return IMAGE_FILE_MACHINE_AMD64;
+
+#if _M_IX86
+    return IMAGE_FILE_MACHINE_I386;
+#elif _M_AMD64
+    return IMAGE_FILE_MACHINE_AMD64;
+#else
+    return IMAGE_FILE_MACHINE_ARM64;
+#endif
+}
+
+const char *GetHostArch(USHORT Machine)
+{
+    switch (Machine)
+        {
+    case IMAGE_FILE_MACHINE_I386:
+        return "x86";
+
+    case IMAGE_FILE_MACHINE_AMD64:
+        return "x64";
+
+    case IMAGE_FILE_MACHINE_ARM64:
+        return "ARM64";
+
+    default:
+        return "unknown";
+        }
+}
+
+//
+// Leaf 1 EBX is left out as it holds the APIC ID of whichever CPU ran the
+// CPUID, and leaf 1 ECX bit 27 (OSXSAVE) is covered by XCR0.
+//
+
+void GetSignature(char *Signature, size_t Size)
+{
+    int CpuInfo[4] = { 0 };
+    char Vendor[13];
+    uint64_t Xcr0 = 0;
+
+    __cpuidex(CpuInfo, 0, 0);
+
+    memcpy(Vendor + 0, &CpuInfo[CPUID_EBX], 4);
+    memcpy(Vendor + 4, &CpuInfo[CPUID_EDX], 4);
+    memcpy(Vendor + 8, &CpuInfo[CPUID_ECX], 4);
+    Vendor[12] = 0;
+
+#if HAS_X86_SIMD
+    if (HasOSXSAVE())
+        Xcr0 = _xgetbv(0);
+#endif
+
+    sprintf_s(Signature, Size, "%s-%08X-%08X-%08X-%08X-%08X-%08X-%08X-%llX-%s-%s",
+        Vendor,
+        LookUpReg(1, 0, CPUID_EAX),
+        LookUpReg(1, 0, CPUID_ECX),
+        LookUpReg(1, 0, CPUID_EDX),
+        LookUpReg(7, 0, CPUID_EBX),
+        LookUpReg(7, 0, CPUID_ECX),
+        LookUpReg(7, 0, CPUID_EDX),
+        LookUpReg(7, 1, CPUID_EDX),
+        Xcr0,
+        GetBuildArch(),
+        GetHostArch(GetHostMachine()));
+}
+
+// ----------------------------------------------------------------------------
+// Benchmark.
+// ----------------------------------------------------------------------------
+
+//
+// Run a variant and the C version on the same input and compare both the
+// result and the output buffer, with no zero byte and with a zero byte at
+// each vector boundary and in the tail, for the scans.
+//
+
+bool CheckKernel(KERNEL *Kernel, KERNEL *Reference, uint8_t *In, uint8_t *Out, uint8_t *RefOut)
+{
+    static const size_t Positions[] = { 0, 1, 15, 16, 31, 32, 63, 64, 1000, CHECK_BYTES - 2, CHECK_BYTES - 1, CHECK_BYTES };
+
+    for (uint32_t i = 0; i < sizeof(Positions) / sizeof(Positions[0]); i++)
+    {
+        size_t Position = Positions[i];
+        uint8_t Saved = In[Position];
+
+        // CHECK_BYTES itself is past the end, so that one runs without a zero
+
+        In[Position] = 0;
+
+        memset(RefOut, 0, CHECK_BYTES);
+        uint64_t RefResult = (*Reference)(In, RefOut, CHECK_BYTES);
+
+        memset(Out, 0, CHECK_BYTES);
+        uint64_t Result = (*Kernel)(In, Out, CHECK_BYTES);
+
+        In[Position] = Saved;
+
+        if ((Result != RefResult) || memcmp(Out, RefOut, CHECK_BYTES))
+            return false;
+    }
+
+    return true;
+}
+
+//
+// Bytes per TSC tick for one kernel at one buffer size, the fastest of
+// TRIALS trials after one warm-up call.
+//
+
+double MeasureKernel(KERNEL *Kernel, const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    size_t Reps = max(1, TARGET_BYTES / Bytes);
+    uint64_t Best = ~0ull;
+
+    (*Kernel)(In, Out, Bytes);
+
+    for (uint32_t t = 0; t < TRIALS; t++)
+    {
+        uint64_t Start = __rdtsc();
+
+        for (size_t r = 0; r < Reps; r++)
+            (*Kernel)(In, Out, Bytes);
+
+        uint64_t Ticks = __rdtsc() - Start;
+
+        Best = min(Best, Ticks);
+    }
+
+    return (double)Bytes * Reps / (double)Best;
+}
+
+void FormatBytes(char *Label, size_t Size, size_t Bytes)
+{
+    if (Bytes >= 1024 * 1024)
+        sprintf_s(Label, Size, "%uM", (uint32_t)(Bytes >> 20));
+    else if (Bytes >= 1024)
+        sprintf_s(Label, Size, "%uK", (uint32_t)(Bytes >> 10));
+    else
+        sprintf_s(Label, Size, "%u", (uint32_t)Bytes);
+}
+
+void RunBenchmarks(uint8_t *In, uint8_t *Out, uint8_t *RefOut)
+{
+    char Label[16];
+
+    if (!CsvOutput)
+    {
+        printf("\nKernel throughput in bytes per TSC tick.\n\n");
+        printf("%-8s %-10s %-8s", "kernel", "variant", "check");
+
+        for (uint32_t s = 0; s < SIZES; s++)
+        {
+            FormatBytes(Label, sizeof(Label), Sizes[s]);
+            printf(" %8s", Label);
+        }
+
+        printf("\n");
+    }
+
+    for (uint32_t k = 0; k < KERNELS; k++)
+    {
+        for (uint32_t v = 0; v < VARIANTS; v++)
+        {
+            const char *Check = "ok";
+
+            if (!(*Variants[v].IsPresent)())
+                Check = "absent";
+            else if (!CheckKernel(Kernels[k].Kernel[v], Kernels[k].Kernel[0], In, Out, RefOut))
+                Check = "MISMATCH";
+
+            if (!CsvOutput)
+                printf("%-8s %-10s %-8s", Kernels[k].Name, Variants[v].Name, Check);
+
+            for (uint32_t s = 0; s < SIZES; s++)
+            {
+                // absent and mismatching variants are never picked
+
+                Results[k][v][s] = 0.0;
+
+                if (strcmp(Check, "ok"))
+                    continue;
+
+                Results[k][v][s] = MeasureKernel(Kernels[k].Kernel[v], In, Out, Sizes[s]);
+
+                if (CsvOutput)
+                    printf("result,%s,%s,%u,%.4f,%s\n", Kernels[k].Name, Variants[v].Name, (uint32_t)Sizes[s], Results[k][v][s], Check);
+                else
+                    printf(" %8.3f", Results[k][v][s]);
+            }
+
+            if (CsvOutput && strcmp(Check, "ok"))
+                printf("result,%s,%s,0,0,%s\n", Kernels[k].Name, Variants[v].Name, Check);
+            else if (!CsvOutput)
+                printf("\n");
+        }
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\nSelected variants, and their speedup over C:\n\n");
+        printf("%-8s", "kernel");
+
+        for (uint32_t s = 0; s < SIZES; s++)
+        {
+            FormatBytes(Label, sizeof(Label), Sizes[s]);
+            printf(" %16s", Label);
+        }
+
+        printf("\n");
+    }
+
+    for (uint32_t k = 0; k < KERNELS; k++)
+    {
+        if (!CsvOutput)
+            printf("%-8s", Kernels[k].Name);
+
+        for (uint32_t s = 0; s < SIZES; s++)
+        {
+            uint32_t Winner = 0;
+
+            for (uint32_t v = 1; v < VARIANTS; v++)
+            {
+                if (Results[k][v][s] > Results[k][Winner][s] * WIN_MARGIN)
+                    Winner = v;
+            }
+
+            Winners[k][s] = Winner;
+
+            double Speedup = Results[k][Winner][s] / Results[k][0][s];
+
+            if (CsvOutput)
+                printf("winner,%s,%u,%s,%.2f\n", Kernels[k].Name, (uint32_t)Sizes[s], Variants[Winner].Name, Speedup);
+            else
+                printf(" %10s %4.1fx", Variants[Winner].Name, Speedup);
+        }
+
+        if (!CsvOutput)
+            printf("\n");
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Profile.
+// ----------------------------------------------------------------------------
+
+int SaveProfile(const char *Path)
+{
+    FILE *File = NULL;
+    char Signature[256];
+
+    if (fopen_s(&File, Path, "w") != 0)
+    {
+        printf("Unable to create %s\n", Path);
+        return 1;
+    }
+
+    GetSignature(Signature, sizeof(Signature));
+
+    fprintf(File, "# autotune kernel selection, check with autotune -load\n");
+    fprintf(File, "version %u\n", PROFILE_VERSION);
+    fprintf(File, "signature %s\n", Signature);
+
+    for (uint32_t k = 0; k < KERNELS; k++)
+    {
+        for (uint32_t s = 0; s < SIZES; s++)
+            fprintf(File, "%s %u %s\n", Kernels[k].Name, (uint32_t)Sizes[s], Variants[Winners[k][s]].Name);
+    }
+
+    fclose(File);
+
+    if (!CsvOutput)
+        printf("\nProfile written to %s\n", Path);
+
+    return 0;
+}
+
+//
+// A profile is valid when it has this version and this host's signature,
+// and every line names a known kernel and size and a variant that is
+// present here.  Any line that doesn't is reported.
+//
+
+int LoadProfile(const char *Path)
+{
+    FILE *File = NULL;
+    char Line[512];
+    char Signature[256];
+    uint32_t Version = 0;
+    bool SignatureMatches = false;
+    uint32_t Entries = 0;
+    uint32_t Errors = 0;
+
+    if (fopen_s(&File, Path, "r") != 0)
+    {
+        printf("Unable to open %s\n", Path);
+        return 1;
+    }
+
+    GetSignature(Signature, sizeof(Signature));
+
+    while (fgets(Line, sizeof(Line), File))
+    {
+        char *Context = NULL;
+        char *Token = strtok_s(Line, " \t\r\n", &Context);
+        char *Value = strtok_s(NULL, " \t\r\n", &Context);
+
+        if ((Token == NULL) || (Token[0] == '#'))
+            continue;
+
+        if (!strcmp(Token, "version"))
+        {
+            Version = Value ? strtoul(Value, NULL, 10) : 0;
+            continue;
+        }
+
+        if (!strcmp(Token, "signature"))
+        {
+            SignatureMatches = (Value != NULL) && !strcmp(Value, Signature);
+
+            if (!SignatureMatches)
+                printf("Profile signature %s\ndoes not match this host %s\n", Value ? Value : "(none)", Signature);
+
+            continue;
+        }
+
+        char *Name = strtok_s(NULL, " \t\r\n", &Context);
+        uint32_t k = 0, s = 0, v = 0;
+
+        while ((k < KERNELS) && strcmp(Token, Kernels[k].Name))
+            k++;
+
+        while ((s < SIZES) && (!Value || (strtoul(Value, NULL, 10) != Sizes[s])))
+            s++;
+
+        while ((v < VARIANTS) && (!Name || strcmp(Name, Variants[v].Name)))
+            v++;
+
+        if ((k == KERNELS) || (s == SIZES) || (v == VARIANTS))
+        {
+            printf("Unknown kernel, size, or variant: %s %s %s\n", Token, Value ? Value : "", Name ? Name : "");
+            Errors++;
+            continue;
+        }
+
+        if (!(*Variants[v].IsPresent)())
+        {
+            printf("%s is not supported on this host: %s %s %s\n", Variants[v].Name, Token, Value, Name);
+            Errors++;
+            continue;
+        }
+
+        Winners[k][s] = v;
+        Entries++;
+    }
+
+    fclose(File);
+
+    if (Version != PROFILE_VERSION)
+    {
+        printf("Profile version %u, expected %u\n", Version, PROFILE_VERSION);
+        Errors++;
+    }
+
+    if (!SignatureMatches)
+        Errors++;
+
+    if (Entries != KERNELS * SIZES)
+    {
+        printf("Profile has %u of %u selections\n", Entries, (uint32_t)(KERNELS * SIZES));
+        Errors++;
+    }
+
+    if (Errors != 0)
+    {
+        printf("Profile %s is not valid for this host, run autotune -save again.\n", Path);
+        return 1;
+    }
+
+    printf("Profile %s is valid for this host:\n\n", Path);
+    printf("%-8s", "kernel");
+
+    for (uint32_t s = 0; s < SIZES; s++)
+    {
+        char Label[16];
+
+        FormatBytes(Label, sizeof(Label), Sizes[s]);
+        printf(" %10s", Label);
+    }
+
+    printf("\n");
+
+    for (uint32_t k = 0; k < KERNELS; k++)
+    {
+        printf("%-8s", Kernels[k].Name);
+
+        for (uint32_t s = 0; s < SIZES; s++)
+            printf(" %10s", Variants[Winners[k][s]].Name);
+
+        printf("\n");
+    }
+
+    return 0;
+}
+
+int __cdecl main(int argc, char **argv)
+{
+    const char *SavePath = NULL;
+    const char *LoadPath = NULL;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-save") && (i + 1 < argc))
+            SavePath = argv[++i];
+        else if (!_stricmp(argv[i], "-load") && (i + 1 < argc))
+            LoadPath = argv[++i];
+        else
+        {
+            printf("Usage: autotune [-csv] [-save file] [-load file]\n");
+            return 1;
+        }
+    }
+
+    if (LoadPath != NULL)
+        return LoadProfile(LoadPath);
+
+    uint8_t *In = (uint8_t *)VirtualAlloc(NULL, MAX_BYTES, MEM_COMMIT, PAGE_READWRITE);
+    uint8_t *Out = (uint8_t *)VirtualAlloc(NULL, MAX_BYTES, MEM_COMMIT, PAGE_READWRITE);
+    uint8_t *RefOut = (uint8_t *)VirtualAlloc(NULL, CHECK_BYTES, MEM_COMMIT, PAGE_READWRITE);
+
+    if ((In == NULL) || (Out == NULL) || (RefOut == NULL))
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    // never zero, so that the scans run over the whole buffer
+
+    for (size_t i = 0; i < MAX_BYTES; i++)
+        In[i] = (uint8_t)(i * 131 + (i >> 8)) | 1;
+
+    for (uint32_t i = 0; i < 256; i++)
+        Table[i] = i * 2654435761u;
+
+    if (!CsvOutput)
+    {
+        char Signature[256];
+
+        GetSignature(Signature, sizeof(Signature));
+        printf("\nHost signature %s\n", Signature);
+    }
+
+    RunBenchmarks(In, Out, RefOut);
+
+    if (SavePath != NULL)
+        return SaveProfile(SavePath);
+
+    return 0;
+}
+
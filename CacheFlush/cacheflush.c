@@ -0,0 +1,602 @@
+
+//
+// CACHEFLUSH.C
+//
+// Non-temporal store and cache line flush cost probe.
+//
+// CPUIDEX checks for CLFLUSH and CLFLUSHOPT but does not say what they
+// cost, and code that persists data line by line, such as a log-structured
+// store committing to persistent memory or to a DMA buffer, pays that cost
+// on every commit.  This measures:
+//
+// - store bandwidth of regular SSE2 stores against MOVNTDQ and MOVNTI
+//   streaming stores, for buffers from 16 KB to beyond the caches,
+//
+// - the cost per line and per megabyte of CLFLUSH, CLFLUSHOPT, and CLWB on
+//   dirty and on clean lines, with the SFENCE that the weakly ordered
+//   flushes need before the data can be considered written back,
+//
+// - the latency of a commit of 1, 8, and 64 freshly written lines, i.e.
+//   the stores, the flushes, and the SFENCE,
+//
+// - the aggregate dirty line flush bandwidth with 1, 2, 4, ... threads,
+//   each flushing its own lines.
+//
+// The flushed region is sized to stay in the L2 so that the lines really
+// are in the cache, and dirty, when they are flushed.  CLFLUSHOPT and CLWB
+// are only timed when CPUID reports them.
+//
+// Usage: cacheflush [-csv] [-maxmb N]
+//
+//   -csv    print machine-readable comma-separated records only
+//   -maxmb  largest streaming store buffer in megabytes (default 256)
+//
+// The -csv records are:
+//
+//   store,buffer bytes,regular GB/s,MOVNTDQ GB/s,MOVNTI GB/s
+//   flush,instruction,dirty ns per line,clean ns per line,dirty us per MB
+//   commit,instruction,lines,ns per commit
+//   parallel,instruction,threads,GB/s
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <intrin.h>
+
+#define LINE_BYTES    (64)
+#define MIN_BUFFER    (16 * 1024)
+#define MIN_TRAFFIC   (256 * 1024 * 1024)  // bytes stored per bandwidth measurement
+#define FLUSH_BYTES   (256 * 1024)         // per thread, fits in the L2
+#define FLUSH_ROUNDS  (64)
+#define COMMITS       (10000)
+#define MAX_CPUS      (256)
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+bool CsvOutput = false;
+double TscPerNs = 0.0;
+
+typedef struct CPU_ENTRY
+{
+    WORD Group;
+    BYTE Number;
+} CPU_ENTRY;
+
+CPU_ENTRY Cpus[MAX_CPUS];
+uint32_t CpuCount = 0;
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool HasCLFLUSH()   { return LookUpRegBit(1, 0, CPUID_EDX, 19); }
+bool HasCLFLSHOP()  { return LookUpRegBit(7, 0, CPUID_EBX, 23); }
+bool HasCLWB()      { return LookUpRegBit(7, 0, CPUID_EBX, 24); }
+bool HasAlways()    { return true; }
+
+//
+// Store kernels, 64 bytes per iteration.  The streaming versions end with
+// an SFENCE, since their stores are weakly ordered and sit in the write
+// combining buffers until it.
+//
+
+void StoreRegular(uint8_t *Buffer, size_t Bytes)
+{
+    __m128i Value = _mm_set1_epi32(1);
+
+    for (size_t i = 0; i < Bytes; i += LINE_BYTES)
+    {
+        _mm_store_si128((__m128i *)(Buffer + i +  0), Value);
+        _mm_store_si128((__m128i *)(Buffer + i + 16), Value);
+        _mm_store_si128((__m128i *)(Buffer + i + 32), Value);
+        _mm_store_si128((__m128i *)(Buffer + i + 48), Value);
+    }
+}
+
+void StoreMovntdq(uint8_t *Buffer, size_t Bytes)
+{
+    __m128i Value = _mm_set1_epi32(1);
+
+    for (size_t i = 0; i < Bytes; i += LINE_BYTES)
+    {
+        _mm_stream_si128((__m128i *)(Buffer + i +  0), Value);
+        _mm_stream_si128((__m128i *)(Buffer + i + 16), Value);
+        _mm_stream_si128((__m128i *)(Buffer + i + 32), Value);
+        _mm_stream_si128((__m128i *)(Buffer + i + 48), Value);
+    }
+
+    _mm_sfence();
+}
+
+void StoreMovnti(uint8_t *Buffer, size_t Bytes)
+{
+    for (size_t i = 0; i < Bytes; i += LINE_BYTES)
+    {
+        for (size_t k = 0; k < LINE_BYTES; k += sizeof(int))
+            _mm_stream_si32((int *)(Buffer + i + k), 1);
+    }
+
+    _mm_sfence();
+}
+
+typedef void (STORE_KERNEL)(uint8_t *Buffer, size_t Bytes);
+
+//
+// Each flush instruction gets two loops, generated by a macro so that the
+// flush is inlined rather than called through a pointer:
+//
+// - Region first dirties or merely reads every line of the region, then
+//   times flushing all of them followed by the SFENCE,
+// - Commit times COMMITS commits of Lines lines, each writing the lines,
+//   flushing them, and fencing, moving through the region.
+//
+
+volatile uint64_t Sink;
+
+#define FLUSH_LOOPS(Name, Flush)                                            \
+                                                                            \
+uint64_t Name##Region(uint8_t *Region, bool Dirty)                          \
+{                                                                           \
+    unsigned int Aux;                                                       \
+    uint64_t Sum = 0;                                                       \
+                                                                            \
+    for (size_t i = 0; i < FLUSH_BYTES; i += LINE_BYTES)                    \
+    {                                                                       \
+        if (Dirty)                                                          \
+            *(volatile uint64_t *)(Region + i) = i;                         \
+        else                                                                \
+            Sum += *(volatile uint64_t *)(Region + i);                      \
+    }                                                                       \
+                                                                            \
+    Sink = Sum;                                                             \
+    uint64_t Start = __rdtscp(&Aux);                                        \
+                                                                            \
+    for (size_t i = 0; i < FLUSH_BYTES; i += LINE_BYTES)                    \
+        Flush(Region + i);                                                  \
+                                                                            \
+    _mm_sfence();                                                           \
+                                                                            \
+    return __rdtscp(&Aux) - Start;                                          \
+}                                                                           \
+                                                                            \
+uint64_t Name##Commit(uint8_t *Region, uint32_t Lines)                      \
+{                                                                           \
+    unsigned int Aux;                                                       \
+    size_t Offset = 0;                                                      \
+    uint64_t Start = __rdtscp(&Aux);                                        \
+                                                                            \
+    for (uint32_t c = 0; c < COMMITS; c++)                                  \
+    {                                                                       \
+        for (uint32_t l = 0; l < Lines; l++)                                \
+            *(volatile uint64_t *)(Region + Offset + l * LINE_BYTES) = c;   \
+                                                                            \
+        for (uint32_t l = 0; l < Lines; l++)                                \
+            Flush(Region + Offset + l * LINE_BYTES);                        \
+                                                                            \
+        _mm_sfence();                                                       \
+        Offset = (Offset + Lines * LINE_BYTES) % FLUSH_BYTES;               \
+    }                                                                       \
+                                                                            \
+    return __rdtscp(&Aux) - Start;                                          \
+}
+
+#define FLUSH_NONE(p)     (void)(p)
+
+FLUSH_LOOPS(None,       FLUSH_NONE)
+FLUSH_LOOPS(Clflush,    _mm_clflush)
+FLUSH_LOOPS(Clflushopt, _mm_clflushopt)
+FLUSH_LOOPS(Clwb,       _mm_clwb)
+
+typedef uint64_t (REGION_LOOP)(uint8_t *Region, bool Dirty);
+typedef uint64_t (COMMIT_LOOP)(uint8_t *Region, uint32_t Lines);
+
+typedef struct FLUSH
+{
+    const char  *Name;
+    bool       (*IsPresent)(void);
+    REGION_LOOP *Region;
+    COMMIT_LOOP *Commit;
+} FLUSH;
+
+const FLUSH Flushes[] =
+{
+    { "stores only", HasAlways,   NoneRegion,       NoneCommit       },
+    { "CLFLUSH",     HasCLFLUSH,  ClflushRegion,    ClflushCommit    },
+    { "CLFLUSHOPT",  HasCLFLSHOP, ClflushoptRegion, ClflushoptCommit },
+    { "CLWB",        HasCLWB,     ClwbRegion,       ClwbCommit       },
+};
+
+#define FLUSHES (sizeof(Flushes) / sizeof(Flushes[0]))
+
+const uint32_t CommitLines[] = { 1, 8, 64 };
+
+#define COMMIT_SIZES (sizeof(CommitLines) / sizeof(CommitLines[0]))
+
+double CalibrateTscPerNs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return (double)(TscStop - TscStart) / Ns;
+}
+
+bool PinToCpu(uint32_t Index)
+{
+    GROUP_AFFINITY Affinity = { 0 };
+
+    Affinity.Group = Cpus[Index].Group;
+    Affinity.Mask = (KAFFINITY)1 << Cpus[Index].Number;
+
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+        return false;
+
+    SwitchToThread();
+    return true;
+}
+
+void EnumerateCpus()
+{
+    WORD Groups = GetActiveProcessorGroupCount();
+
+    for (WORD Group = 0; Group < Groups; Group++)
+    {
+        DWORD Count = GetActiveProcessorCount(Group);
+
+        for (DWORD Number = 0; (Number < Count) && (CpuCount < MAX_CPUS); Number++)
+        {
+            Cpus[CpuCount].Group = Group;
+            Cpus[CpuCount].Number = (BYTE)Number;
+            CpuCount++;
+        }
+    }
+}
+
+double MeasureStores(STORE_KERNEL *Kernel, uint8_t *Buffer, size_t Bytes)
+{
+    uint32_t Passes = (uint32_t)max(1, MIN_TRAFFIC / Bytes);
+
+    (*Kernel)(Buffer, Bytes);
+
+    uint64_t Start = __rdtsc();
+
+    for (uint32_t p = 0; p < Passes; p++)
+        (*Kernel)(Buffer, Bytes);
+
+    uint64_t Ticks = __rdtsc() - Start;
+
+    return (double)Bytes * Passes * TscPerNs / (double)Ticks;
+}
+
+//
+// Ticks spent flushing over FLUSH_ROUNDS rounds of the region.
+//
+
+uint64_t MeasureRegion(const FLUSH *Flush, uint8_t *Region, bool Dirty)
+{
+    uint64_t Ticks = 0;
+
+    (*Flush->Region)(Region, Dirty);
+
+    for (uint32_t r = 0; r < FLUSH_ROUNDS; r++)
+        Ticks += (*Flush->Region)(Region, Dirty);
+
+    return Ticks;
+}
+
+typedef struct WORKER
+{
+    uint32_t       Cpu;
+    const FLUSH   *Flush;
+    uint8_t       *Region;
+    volatile LONG *Ready;
+    volatile LONG *Go;
+    uint64_t       Ticks;
+} WORKER;
+
+DWORD WINAPI WorkerProc(LPVOID Param)
+{
+    WORKER *Worker = (WORKER *)Param;
+
+    PinToCpu(Worker->Cpu);
+    _InterlockedIncrement(Worker->Ready);
+
+    while (*Worker->Go == 0)
+        YieldProcessor();
+
+    Worker->Ticks = MeasureRegion(Worker->Flush, Worker->Region, true);
+
+    return 0;
+}
+
+WORKER Workers[MAX_CPUS];
+HANDLE Handles[MAX_CPUS];
+
+//
+// Aggregate dirty flush bandwidth in GB/s of Threads threads, each with its
+// own region, started together once all of them are pinned.
+//
+
+double MeasureParallel(const FLUSH *Flush, uint8_t *Regions, uint32_t Threads)
+{
+    volatile LONG Ready = 0;
+    volatile LONG Go = 0;
+    uint32_t Count = 0;
+
+    for (uint32_t t = 0; t < Threads; t++)
+    {
+        WORKER *Worker = &Workers[t];
+
+        memset(Worker, 0, sizeof(*Worker));
+        Worker->Cpu = t;
+        Worker->Flush = Flush;
+        Worker->Region = Regions + (size_t)t * FLUSH_BYTES;
+        Worker->Ready = &Ready;
+        Worker->Go = &Go;
+
+        Handles[Count] = CreateThread(NULL, 0, WorkerProc, Worker, 0, NULL);
+
+        if (Handles[Count] == NULL)
+        {
+            printf("CreateThread failed with error %u\n", GetLastError());
+            break;
+        }
+
+        Count++;
+    }
+
+    while (Ready < (LONG)Count)
+        SwitchToThread();
+
+    Go = 1;
+
+    double GBs = 0.0;
+
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        WaitForSingleObject(Handles[i], INFINITE);
+        CloseHandle(Handles[i]);
+
+        GBs += (double)FLUSH_BYTES * FLUSH_ROUNDS * TscPerNs / (double)Workers[i].Ticks;
+    }
+
+    return GBs;
+}
+
+void FormatBytes(char *Label, size_t Size, size_t Bytes)
+{
+    if (Bytes >= 1024 * 1024)
+        sprintf_s(Label, Size, "%u MB", (uint32_t)(Bytes >> 20));
+    else
+        sprintf_s(Label, Size, "%u KB", (uint32_t)(Bytes >> 10));
+}
+
+#endif // _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t MaxMb = 256;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-maxmb") && (i + 1 < argc))
+        {
+            // min() and max() evaluate their arguments twice
+            MaxMb = strtoul(argv[++i], NULL, 0);
+            MaxMb = max(1, MaxMb);
+        }
+        else
+        {
+            printf("Usage: cacheflush [-csv] [-maxmb N]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+#if _M_IX86
+    // leave the 32-bit address space some room
+    MaxMb = min(512, MaxMb);
+#endif
+
+    size_t MaxBytes = (size_t)MaxMb * 1024 * 1024;
+
+    EnumerateCpus();
+
+    uint8_t *Buffer = (uint8_t *)VirtualAlloc(NULL, MaxBytes, MEM_COMMIT, PAGE_READWRITE);
+    uint8_t *Regions = (uint8_t *)VirtualAlloc(NULL, (size_t)CpuCount * FLUSH_BYTES, MEM_COMMIT, PAGE_READWRITE);
+
+    if ((Buffer == NULL) || (Regions == NULL))
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    PinToCpu(0);
+
+    TscPerNs = CalibrateTscPerNs();
+
+    if (!CsvOutput)
+    {
+        printf("\nStore bandwidth, GB/s.\n\n");
+        printf("%10s %10s %10s %10s\n", "buffer", "regular", "MOVNTDQ", "MOVNTI");
+    }
+
+    for (size_t Bytes = MIN_BUFFER; Bytes <= MaxBytes; Bytes *= 2)
+    {
+        double RegularGBs = MeasureStores(StoreRegular, Buffer, Bytes);
+        double MovntdqGBs = MeasureStores(StoreMovntdq, Buffer, Bytes);
+        double MovntiGBs  = MeasureStores(StoreMovnti,  Buffer, Bytes);
+
+        if (CsvOutput)
+        {
+            printf("store,%u,%.2f,%.2f,%.2f\n", (uint32_t)Bytes, RegularGBs, MovntdqGBs, MovntiGBs);
+        }
+        else
+        {
+            char Label[16];
+            FormatBytes(Label, sizeof(Label), Bytes);
+
+            printf("%10s %10.2f %10.2f %10.2f\n", Label, RegularGBs, MovntdqGBs, MovntiGBs);
+        }
+    }
+
+    VirtualFree(Buffer, 0, MEM_RELEASE);
+
+    if (!CsvOutput)
+    {
+        printf("\nFlushing a %u KB region, fence included.\n\n", FLUSH_BYTES / 1024);
+        printf("%-12s %12s %12s %12s\n", "instruction", "dirty ns/ln", "clean ns/ln", "dirty us/MB");
+    }
+
+    const double LinesPerRound = FLUSH_BYTES / LINE_BYTES;
+
+    for (uint32_t f = 1; f < FLUSHES; f++)
+    {
+        const FLUSH *Flush = &Flushes[f];
+
+        if (!(*Flush->IsPresent)())
+        {
+            if (!CsvOutput)
+                printf("%-12s %12s\n", Flush->Name, "absent");
+
+            continue;
+        }
+
+        double DirtyNs = MeasureRegion(Flush, Regions, true) / TscPerNs / (LinesPerRound * FLUSH_ROUNDS);
+        double CleanNs = MeasureRegion(Flush, Regions, false) / TscPerNs / (LinesPerRound * FLUSH_ROUNDS);
+        double UsPerMb = DirtyNs * (1024 * 1024 / LINE_BYTES) / 1000.0;
+
+        if (CsvOutput)
+            printf("flush,%s,%.2f,%.2f,%.1f\n", Flush->Name, DirtyNs, CleanNs, UsPerMb);
+        else
+            printf("%-12s %12.2f %12.2f %12.1f\n", Flush->Name, DirtyNs, CleanNs, UsPerMb);
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\nCommit latency, ns per commit of N freshly written lines.\n\n");
+        printf("%-12s", "instruction");
+
+        for (uint32_t s = 0; s < COMMIT_SIZES; s++)
+            printf(" %9u ln", CommitLines[s]);
+
+        printf("\n");
+    }
+
+    for (uint32_t f = 0; f < FLUSHES; f++)
+    {
+        const FLUSH *Flush = &Flushes[f];
+
+        if (!(*Flush->IsPresent)())
+            continue;
+
+        if (!CsvOutput)
+            printf("%-12s", Flush->Name);
+
+        for (uint32_t s = 0; s < COMMIT_SIZES; s++)
+        {
+            (*Flush->Commit)(Regions, CommitLines[s]);
+            double Ns = (*Flush->Commit)(Regions, CommitLines[s]) / TscPerNs / COMMITS;
+
+            if (CsvOutput)
+                printf("commit,%s,%u,%.1f\n", Flush->Name, CommitLines[s], Ns);
+            else
+                printf(" %12.1f", Ns);
+        }
+
+        if (!CsvOutput)
+            printf("\n");
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\nDirty line flush bandwidth with all threads flushing their own lines, GB/s.\n\n");
+        printf("%8s", "threads");
+
+        for (uint32_t f = 1; f < FLUSHES; f++)
+            printf(" %12s", Flushes[f].Name);
+
+        printf("\n");
+    }
+
+    for (uint32_t Threads = 1; ; Threads = min(Threads * 2, CpuCount))
+    {
+        if (!CsvOutput)
+            printf("%8u", Threads);
+
+        for (uint32_t f = 1; f < FLUSHES; f++)
+        {
+            const FLUSH *Flush = &Flushes[f];
+
+            if (!(*Flush->IsPresent)())
+            {
+                if (!CsvOutput)
+                    printf(" %12s", "absent");
+
+                continue;
+            }
+
+            double GBs = MeasureParallel(Flush, Regions, Threads);
+
+            if (CsvOutput)
+                printf("parallel,%s,%u,%.2f\n", Flush->Name, Threads, GBs);
+            else
+                printf(" %12.2f", GBs);
+        }
+
+        if (!CsvOutput)
+            printf("\n");
+
+        if (Threads == CpuCount)
+            break;
+    }
+
+    VirtualFree(Regions, 0, MEM_RELEASE);
+
+#else
+
+    printf("This probe uses x86 store and flush instructions, run the x64 build to test the emulator on ARM64.\n");
+
+#endif
+
+    return 0;
+}
+
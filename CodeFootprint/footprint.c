@@ -0,0 +1,352 @@
+
+//
+// FOOTPRINT.C
+//
+// Code footprint scaling probe.
+//
+// VA2.C allocates executable regions but only ever runs a few bytes of
+// generated code.  Large binaries instead touch megabytes of code, and the
+// cost of a call then depends on whether the target is still in the
+// instruction cache, the uop cache, the iTLB, or under emulation in the
+// translation cache.  This generates N distinct small functions, from 4 KB
+// up to hundreds of megabytes of code, and calls them in sequential, random,
+// and Zipf-distributed order.  The first sequential pass over freshly
+// generated code is timed separately as the cold cost, which under an
+// emulator includes translating each function.
+//
+// Each function is "MOV EAX,index; ADD EAX,imm8 ...; RET" padded with INT3
+// to the function size, so every function is different and lives at its own
+// address.  The cliffs show up as steps in the per-call cost as the
+// footprint doubles.
+//
+// Usage: footprint [-csv] [-maxmb N] [-funcbytes N]
+//
+//   -csv        print machine-readable comma-separated records only
+//   -maxmb      largest code footprint in megabytes (default 256)
+//   -funcbytes  size of each generated function, 16 to 4096 (default 64)
+//
+// The -csv records are:
+//
+//   footprint,bytes,functions,cold ns,sequential ns,random ns,zipf ns
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <intrin.h>
+
+#define MIN_FOOTPRINT (4 * 1024)
+#define MIN_CALLS     (1024 * 1024)    // calls per warm measurement
+#define ZIPF_S        (1.0)            // Zipf exponent, 1.0 is the classic 80/20-like skew
+
+typedef uint32_t (CODE_FUNC)(void);
+
+bool CsvOutput = false;
+double TscPerUs = 0.0;
+
+#if _M_IX86 || _M_AMD64 || _M_ARM64EC
+
+//
+// Emit Count functions of FuncBytes each.  The same encoding is valid in
+// 32-bit and 64-bit mode and no arguments are used, so there is no calling
+// convention to worry about.
+//
+
+uint8_t *EmitFunctions(uint32_t Count, uint32_t FuncBytes)
+{
+    size_t Bytes = (size_t)Count * FuncBytes;
+    uint8_t *Code = (uint8_t *)VirtualAlloc(NULL, Bytes, MEM_COMMIT, PAGE_READWRITE);
+
+    if (Code == NULL)
+        return NULL;
+
+    uint32_t Adds = (FuncBytes - 6) / 3;
+
+    for (uint32_t f = 0; f < Count; f++)
+    {
+        uint8_t *p = Code + (size_t)f * FuncBytes;
+        uint8_t *End = p + FuncBytes;
+
+        *p++ = 0xB8;                                                // MOV EAX,imm32
+        *(uint32_t *)p = f;
+        p += 4;
+
+        for (uint32_t i = 0; i < Adds; i++)
+        {
+            *p++ = 0x83; *p++ = 0xC0; *p++ = (uint8_t)(i + 1);      // ADD EAX,imm8
+        }
+
+        *p++ = 0xC3;                                                // RET
+
+        while (p < End)
+            *p++ = 0xCC;                                            // INT3
+    }
+
+    DWORD OldProtect = 0;
+    VirtualProtect(Code, Bytes, PAGE_EXECUTE_READ, &OldProtect);
+    FlushInstructionCache(GetCurrentProcess(), Code, Bytes);
+
+    return Code;
+}
+
+double CalibrateTscPerUs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Us = (double)(Stop.QuadPart - Start.QuadPart) * 1e6 / (double)Freq.QuadPart;
+
+    return (double)(TscStop - TscStart) / Us;
+}
+
+uint64_t Seed = 12345;
+
+uint32_t NextRandom()
+{
+    Seed = Seed * 6364136223846793005ull + 1442695040888963407ull;
+
+    return (uint32_t)(Seed >> 32);
+}
+
+//
+// Call through a precomputed array of targets and return the nanoseconds
+// per call.  Reading the targets sequentially keeps the data side out of
+// the measurement as much as possible.
+//
+
+volatile uint32_t Sink;
+
+double TimeCalls(CODE_FUNC **Targets, size_t Calls)
+{
+    uint32_t Sum = 0;
+    uint64_t Start = __rdtsc();
+
+    for (size_t i = 0; i < Calls; i++)
+        Sum += (*Targets[i])();
+
+    uint64_t Ticks = __rdtsc() - Start;
+
+    Sink = Sum;
+
+    return (double)Ticks / TscPerUs * 1000.0 / (double)Calls;
+}
+
+void BuildSequential(CODE_FUNC **Targets, size_t Calls, uint8_t *Code, uint32_t Count, uint32_t FuncBytes)
+{
+    for (size_t i = 0; i < Calls; i++)
+        Targets[i] = (CODE_FUNC *)(void *)(Code + (i % Count) * FuncBytes);
+}
+
+//
+// Random order visits every function once per pass of Count calls, in a
+// different shuffle each pass, so that nothing but the footprint matters.
+//
+
+void BuildRandom(CODE_FUNC **Targets, size_t Calls, uint8_t *Code, uint32_t Count, uint32_t FuncBytes, uint32_t *Perm)
+{
+    for (size_t Base = 0; Base < Calls; Base += Count)
+    {
+        for (uint32_t i = 0; i < Count; i++)
+            Perm[i] = i;
+
+        for (uint32_t i = Count - 1; i > 0; i--)
+        {
+            uint32_t j = NextRandom() % (i + 1);
+            uint32_t Temp = Perm[i];
+
+            Perm[i] = Perm[j];
+            Perm[j] = Temp;
+        }
+
+        for (uint32_t i = 0; (i < Count) && (Base + i < Calls); i++)
+            Targets[Base + i] = (CODE_FUNC *)(void *)(Code + (size_t)Perm[i] * FuncBytes);
+    }
+}
+
+//
+// Zipf order draws ranks with probability proportional to 1/rank^s.  The
+// ranks are mapped to functions through a random permutation so that the
+// hot functions are scattered over the whole region, as they are in a real
+// binary, rather than packed into its first pages.
+//
+
+void BuildZipf(CODE_FUNC **Targets, size_t Calls, uint8_t *Code, uint32_t Count, uint32_t FuncBytes, uint32_t *Perm, double *Cdf)
+{
+    double Sum = 0.0;
+
+    for (uint32_t r = 0; r < Count; r++)
+    {
+        Sum += 1.0 / pow((double)(r + 1), ZIPF_S);
+        Cdf[r] = Sum;
+    }
+
+    for (uint32_t i = 0; i < Count; i++)
+        Perm[i] = i;
+
+    for (uint32_t i = Count - 1; i > 0; i--)
+    {
+        uint32_t j = NextRandom() % (i + 1);
+        uint32_t Temp = Perm[i];
+
+        Perm[i] = Perm[j];
+        Perm[j] = Temp;
+    }
+
+    for (size_t i = 0; i < Calls; i++)
+    {
+        double u = (double)NextRandom() / 4294967296.0 * Sum;
+        uint32_t Lo = 0, Hi = Count - 1;
+
+        // first rank whose cumulative weight exceeds u
+
+        while (Lo < Hi)
+        {
+            uint32_t Mid = (Lo + Hi) / 2;
+
+            if (Cdf[Mid] <= u)
+                Lo = Mid + 1;
+            else
+                Hi = Mid;
+        }
+
+        Targets[i] = (CODE_FUNC *)(void *)(Code + (size_t)Perm[Lo] * FuncBytes);
+    }
+}
+
+void FormatBytes(char *Label, size_t Size, size_t Bytes)
+{
+    if (Bytes >= 1024 * 1024)
+        sprintf_s(Label, Size, "%u MB", (uint32_t)(Bytes >> 20));
+    else
+        sprintf_s(Label, Size, "%u KB", (uint32_t)(Bytes >> 10));
+}
+
+#endif // _M_IX86 || _M_AMD64 || _M_ARM64EC
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t MaxMb = 256;
+    uint32_t FuncBytes = 64;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-maxmb") && (i + 1 < argc))
+        {
+            // min() and max() evaluate their arguments twice
+            MaxMb = strtoul(argv[++i], NULL, 0);
+            MaxMb = max(1, MaxMb);
+        }
+        else if (!_stricmp(argv[i], "-funcbytes") && (i + 1 < argc))
+        {
+            FuncBytes = strtoul(argv[++i], NULL, 0);
+            FuncBytes = min(4096, max(16, FuncBytes));
+        }
+        else
+        {
+            printf("Usage: footprint [-csv] [-maxmb N] [-funcbytes N]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86 || _M_AMD64 || _M_ARM64EC
+
+#if _M_IX86
+    // leave the 32-bit address space some room
+    MaxMb = min(512, MaxMb);
+#endif
+
+    size_t MaxBytes = (size_t)MaxMb * 1024 * 1024;
+    uint32_t MaxCount = (uint32_t)(MaxBytes / FuncBytes);
+    size_t MaxCalls = max(MIN_CALLS, MaxCount);
+
+    CODE_FUNC **Targets = (CODE_FUNC **)VirtualAlloc(NULL, MaxCalls * sizeof(CODE_FUNC *), MEM_COMMIT, PAGE_READWRITE);
+    uint32_t *Perm = (uint32_t *)VirtualAlloc(NULL, MaxCount * sizeof(uint32_t), MEM_COMMIT, PAGE_READWRITE);
+    double *Cdf = (double *)VirtualAlloc(NULL, MaxCount * sizeof(double), MEM_COMMIT, PAGE_READWRITE);
+
+    if ((Targets == NULL) || (Perm == NULL) || (Cdf == NULL))
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    TscPerUs = CalibrateTscPerUs();
+
+    if (!CsvOutput)
+    {
+        printf("\nCode footprint scaling with %u byte functions, nanoseconds per call.\n\n", FuncBytes);
+        printf("%10s %10s %10s %10s %10s %10s\n", "footprint", "functions", "cold", "sequential", "random", "zipf");
+    }
+
+    for (size_t Bytes = max(MIN_FOOTPRINT, FuncBytes); Bytes <= MaxBytes; Bytes *= 2)
+    {
+        uint32_t Count = (uint32_t)(Bytes / FuncBytes);
+        size_t Calls = max(MIN_CALLS, Count);
+
+        // fresh code for every footprint, so the first pass is really cold
+
+        uint8_t *Code = EmitFunctions(Count, FuncBytes);
+
+        if (Code == NULL)
+        {
+            printf("VirtualAlloc of %u KB of code failed with error %u\n", (uint32_t)(Bytes >> 10), GetLastError());
+            break;
+        }
+
+        BuildSequential(Targets, Calls, Code, Count, FuncBytes);
+
+        double ColdNs = TimeCalls(Targets, Count);
+        double SeqNs = TimeCalls(Targets, Calls);
+
+        BuildRandom(Targets, Calls, Code, Count, FuncBytes, Perm);
+        TimeCalls(Targets, Calls);
+        double RandomNs = TimeCalls(Targets, Calls);
+
+        BuildZipf(Targets, Calls, Code, Count, FuncBytes, Perm, Cdf);
+        TimeCalls(Targets, Calls);
+        double ZipfNs = TimeCalls(Targets, Calls);
+
+        VirtualFree(Code, 0, MEM_RELEASE);
+
+        if (CsvOutput)
+        {
+            printf("footprint,%u,%u,%.2f,%.2f,%.2f,%.2f\n", (uint32_t)Bytes, Count, ColdNs, SeqNs, RandomNs, ZipfNs);
+        }
+        else
+        {
+            char Label[16];
+            FormatBytes(Label, sizeof(Label), Bytes);
+
+            printf("%10s %10u %10.2f %10.2f %10.2f %10.2f\n", Label, Count, ColdNs, SeqNs, RandomNs, ZipfNs);
+        }
+    }
+
+    VirtualFree(Targets, 0, MEM_RELEASE);
+    VirtualFree(Perm, 0, MEM_RELEASE);
+    VirtualFree(Cdf, 0, MEM_RELEASE);
+
+#else
+
+    printf("This probe generates x86/x64 code and requires an x86, x64, or ARM64EC build.\n");
+
+#endif
+
+    return 0;
+}
+
@@ -0,0 +1,837 @@
+
+//
+// COREMON.C
+//
+// Core type and migration monitor: CPU table, sampling, and report.
+//
+// At initialization the calling thread visits every logical CPU once to read
+// its APIC ID, its CPUID leaf 0x1A core type, and the TSC_AUX value that
+// RDTSCP and RDPID return there.  If the TSC_AUX values are small and unique
+// they identify the CPU and the hook reads them directly, otherwise it falls
+// back to GetCurrentProcessorNumberEx().  Core types are the distinct pairs
+// of Windows efficiency class and CPUID core type, as in HybridCores.
+//
+// A migration is a change of CPU between two samples in a row of one thread,
+// so the rates are lower bounds: a thread that moves away and back between
+// two samples is not seen to move.  Residency counts samples, and samples
+// are only taken while a thread runs and calls the hook.
+//
+// Everything not declared in COREMON.H is static, so that this file links
+// into any process without clashing with its names.
+//
+// 2026-10-19 darekm
+//
+
+#include "coremon.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define COREMON_AUX_LIMIT   (4096)     // largest TSC_AUX value used as a CPU number
+#define COREMON_MAX_GROUPS  (64)
+#define COST_CALLS          (10000000)
+#define COST_SAMPLES        (1000000)
+
+#if _M_IX86 || _M_AMD64
+#define HAS_CPUID     (1)
+#endif
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+#define HAS_TSC_AUX   (1)
+#endif
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+COREMON_CPU CoreMonCpus[COREMON_MAX_CPUS];
+uint32_t CoreMonCpuCount = 0;
+COREMON_TYPE CoreMonTypes[COREMON_MAX_TYPES];
+uint32_t CoreMonTypeCount = 0;
+COREMON_SOURCE CoreMonSource = COREMON_SOURCE_API;
+double CoreMonTicksPerNs = 0.0;
+COREMON_THREAD * volatile CoreMonThreads = NULL;
+__declspec(thread) COREMON_THREAD *CoreMonThread = NULL;
+
+static bool Initialized = false;
+static uint64_t IntervalTicks = 0;
+static uint32_t GroupBase[COREMON_MAX_GROUPS];
+static uint16_t AuxToCpu[COREMON_AUX_LIMIT];
+
+static double HookCostNs = 0.0;        // set by CoreMonMeasureCost()
+static double SampleCostNs = 0.0;
+
+//
+// What the report shows of a thread, kept after the thread exits and its
+// ring is freed.
+//
+
+typedef struct THREAD_TOTALS
+{
+    DWORD    ThreadId;
+    uint64_t Calls;
+    uint64_t Dropped;
+    uint64_t Samples;
+    double   Seconds;
+    uint64_t Migrations[COREMON_MIGRATIONS];
+    uint64_t TypeSamples[COREMON_MAX_TYPES];
+} THREAD_TOTALS;
+
+static DWORD FlsIndex = FLS_OUT_OF_INDEXES;
+static THREAD_TOTALS ExitedThreads[COREMON_MAX_EXITED];
+static uint32_t ExitedCount = 0;
+static THREAD_TOTALS LateExits;        // thread 0, the threads that found no slot
+static uint32_t LateExitCount = 0;
+
+// ----------------------------------------------------------------------------
+// CPU table.
+// ----------------------------------------------------------------------------
+
+static uint32_t ReadCpuid(uint32_t Function, uint32_t Sub, CPUID_REGS Reg)
+{
+#if HAS_CPUID
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return CpuInfo[Reg];
+#else
+    (void)Function; (void)Sub; (void)Reg;
+    return 0;
+#endif
+}
+
+static bool HasRDTSCP() { return (ReadCpuid(0x80000001, 0, CPUID_EDX) >> 27) & 1; }
+static bool HasRDPID()  { return (ReadCpuid(7, 0, CPUID_ECX) >> 22) & 1; }
+
+static const char * LookUpCoreType(uint32_t CoreType)
+{
+    switch (CoreType)
+        {
+    case 0x20: return "Atom (E-core)";
+    case 0x40: return "Core (P-core)";
+    default:   return NULL;
+        }
+}
+
+const char *CoreMonSourceName(COREMON_SOURCE Source)
+{
+    switch (Source)
+        {
+    case COREMON_SOURCE_RDPID:  return "RDPID";
+    case COREMON_SOURCE_RDTSCP: return "RDTSCP";
+    case COREMON_SOURCE_API:    return "GetCurrentProcessorNumberEx";
+    default:                    return "auto";
+        }
+}
+
+static bool PinToCpu(uint32_t Index)
+{
+    GROUP_AFFINITY Affinity = { 0 };
+
+    Affinity.Group = CoreMonCpus[Index].Group;
+    Affinity.Mask = (KAFFINITY)1 << CoreMonCpus[Index].Number;
+
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+        return false;
+
+    SwitchToThread();
+    return true;
+}
+
+//
+// CPUs are numbered in group and number order, so that the CPU of a
+// PROCESSOR_NUMBER is GroupBase[Group] + Number.
+//
+
+static void EnumerateCpus()
+{
+    WORD Groups = GetActiveProcessorGroupCount();
+
+    for (WORD Group = 0; (Group < Groups) && (Group < COREMON_MAX_GROUPS); Group++)
+    {
+        DWORD Count = GetActiveProcessorCount(Group);
+
+        GroupBase[Group] = CoreMonCpuCount;
+
+        for (DWORD Number = 0; (Number < Count) && (CoreMonCpuCount < COREMON_MAX_CPUS); Number++)
+        {
+            CoreMonCpus[CoreMonCpuCount].Group = Group;
+            CoreMonCpus[CoreMonCpuCount].Number = (BYTE)Number;
+            CoreMonCpuCount++;
+        }
+    }
+}
+
+static uint32_t CpuFromNumber(WORD Group, BYTE Number)
+{
+    if (Group >= COREMON_MAX_GROUPS)
+        return COREMON_NO_CPU;
+
+    uint32_t Cpu = GroupBase[Group] + Number;
+
+    if ((Cpu >= CoreMonCpuCount) || (CoreMonCpus[Cpu].Group != Group))
+        return COREMON_NO_CPU;
+
+    return Cpu;
+}
+
+static bool ReadCores()
+{
+    DWORD Length = 0;
+
+    GetLogicalProcessorInformationEx(RelationProcessorCore, NULL, &Length);
+
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *Info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)malloc(Length);
+
+    if ((Info == NULL) || !GetLogicalProcessorInformationEx(RelationProcessorCore, Info, &Length))
+    {
+        printf("GetLogicalProcessorInformationEx failed with error %u\n", GetLastError());
+        free(Info);
+        return false;
+    }
+
+    uint32_t CoreIndex = 0;
+
+    for (DWORD Offset = 0; Offset < Length; CoreIndex++)
+    {
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *Core = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)((uint8_t *)Info + Offset);
+
+        for (WORD g = 0; g < Core->Processor.GroupCount; g++)
+        {
+            for (BYTE n = 0; n < sizeof(KAFFINITY) * 8; n++)
+            {
+                if (!((Core->Processor.GroupMask[g].Mask >> n) & 1))
+                    continue;
+
+                uint32_t Cpu = CpuFromNumber(Core->Processor.GroupMask[g].Group, n);
+
+                if (Cpu == COREMON_NO_CPU)
+                    continue;
+
+                CoreMonCpus[Cpu].Core = CoreIndex;
+                CoreMonCpus[Cpu].EfficiencyClass = Core->Processor.EfficiencyClass;
+            }
+        }
+
+        Offset += Core->Size;
+    }
+
+    free(Info);
+    return true;
+}
+
+//
+// Leaf 0xB gives the full x2APIC ID, leaf 1 only the low 8 bits.
+//
+
+static void ReadCpuIds()
+{
+    GROUP_AFFINITY Original;
+    GetThreadGroupAffinity(GetCurrentThread(), &Original);
+
+    bool HasLeafB = ReadCpuid(0, 0, CPUID_EAX) >= 0xB;
+    bool HasAux = HasRDTSCP();
+
+    for (uint32_t i = 0; i < CoreMonCpuCount; i++)
+    {
+        // a CPU that cannot be visited has no TSC_AUX value, not 0
+
+        CoreMonCpus[i].TscAux = COREMON_AUX_LIMIT;
+
+        if (!PinToCpu(i))
+            continue;
+
+        CoreMonCpus[i].CoreType = ReadCpuid(0x1A, 0, CPUID_EAX) >> 24;
+        CoreMonCpus[i].ApicId = HasLeafB ? ReadCpuid(0xB, 0, CPUID_EDX) : ReadCpuid(1, 0, CPUID_EBX) >> 24;
+
+#if HAS_TSC_AUX
+        if (HasAux)
+        {
+            unsigned int Aux = 0;
+
+            __rdtscp(&Aux);
+            CoreMonCpus[i].TscAux = Aux;
+        }
+#else
+        (void)HasAux;
+#endif
+    }
+
+    SetThreadGroupAffinity(GetCurrentThread(), &Original, NULL);
+}
+
+//
+// Sorted most performant first, so that a move to a higher type index is a
+// move to a slower core.
+//
+
+static void ClassifyCpus()
+{
+    for (uint32_t i = 0; i < CoreMonCpuCount; i++)
+    {
+        uint32_t t;
+
+        CoreMonCpus[i].Type = COREMON_NO_TYPE;
+
+        for (t = 0; t < CoreMonTypeCount; t++)
+        {
+            if ((CoreMonTypes[t].EfficiencyClass == CoreMonCpus[i].EfficiencyClass) && (CoreMonTypes[t].CoreType == CoreMonCpus[i].CoreType))
+                break;
+        }
+
+        if ((t == CoreMonTypeCount) && (CoreMonTypeCount < COREMON_MAX_TYPES))
+        {
+            CoreMonTypes[t].EfficiencyClass = CoreMonCpus[i].EfficiencyClass;
+            CoreMonTypes[t].CoreType = CoreMonCpus[i].CoreType;
+            CoreMonTypeCount++;
+        }
+    }
+
+    for (uint32_t t = 1; t < CoreMonTypeCount; t++)
+    {
+        for (uint32_t u = t; (u > 0) && (CoreMonTypes[u].EfficiencyClass > CoreMonTypes[u - 1].EfficiencyClass); u--)
+        {
+            COREMON_TYPE Temp = CoreMonTypes[u];
+            CoreMonTypes[u] = CoreMonTypes[u - 1];
+            CoreMonTypes[u - 1] = Temp;
+        }
+    }
+
+    for (uint32_t t = 0; t < CoreMonTypeCount; t++)
+    {
+        const char *Name = LookUpCoreType(CoreMonTypes[t].CoreType);
+
+        if (Name)
+            sprintf_s(CoreMonTypes[t].Name, sizeof(CoreMonTypes[t].Name), "%s", Name);
+        else
+            sprintf_s(CoreMonTypes[t].Name, sizeof(CoreMonTypes[t].Name), "class %u cores", CoreMonTypes[t].EfficiencyClass);
+
+        for (uint32_t i = 0; i < CoreMonCpuCount; i++)
+        {
+            if ((CoreMonCpus[i].EfficiencyClass == CoreMonTypes[t].EfficiencyClass) && (CoreMonCpus[i].CoreType == CoreMonTypes[t].CoreType))
+            {
+                CoreMonCpus[i].Type = t;
+                CoreMonTypes[t].Cpus++;
+            }
+        }
+    }
+}
+
+//
+// The OS decides what goes into TSC_AUX, so it identifies the CPU only if
+// every CPU has a distinct value.  A CPU without a usable value is left out
+// of the map and looked up through the API when a sample lands on it.
+//
+
+static bool MapTscAux()
+{
+    uint32_t Mapped = 0;
+
+    for (uint32_t a = 0; a < COREMON_AUX_LIMIT; a++)
+        AuxToCpu[a] = COREMON_NO_CPU;
+
+    for (uint32_t i = 0; i < CoreMonCpuCount; i++)
+    {
+        uint32_t Aux = CoreMonCpus[i].TscAux;
+
+        if (Aux >= COREMON_AUX_LIMIT)
+            continue;
+
+        if (AuxToCpu[Aux] != COREMON_NO_CPU)
+            return false;
+
+        AuxToCpu[Aux] = (uint16_t)i;
+        Mapped++;
+    }
+
+    return Mapped > 0;
+}
+
+static double CalibrateTicksPerNs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TicksStart = CoreMonReadTimeStamp();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TicksStop = CoreMonReadTimeStamp();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return (double)(TicksStop - TicksStart) / Ns;
+}
+
+//
+// Called on the thread as it exits.  The next drain frees the entry, so the
+// thread lets go of it here.
+//
+
+static VOID WINAPI ThreadExit(PVOID Data)
+{
+    COREMON_THREAD *Thread = (COREMON_THREAD *)Data;
+
+    if (Thread == NULL)
+        return;
+
+    if (CoreMonThread == Thread)
+        CoreMonThread = NULL;
+
+    InterlockedExchange(&Thread->Exited, 1);
+}
+
+//
+// Takes about 100 ms to calibrate the time stamp counter, plus a visit to
+// every CPU.  The requested source is used only if it identifies the CPU,
+// otherwise the API is.
+//
+
+bool CoreMonInitialize(uint32_t IntervalUs, COREMON_SOURCE Source)
+{
+    if (Initialized)
+        return true;
+
+    EnumerateCpus();
+
+    if ((CoreMonCpuCount == 0) || !ReadCores())
+        return false;
+
+    ReadCpuIds();
+    ClassifyCpus();
+
+    bool AuxIsCpu = MapTscAux();
+
+    if (Source == COREMON_SOURCE_AUTO)
+        Source = HasRDPID() ? COREMON_SOURCE_RDPID : COREMON_SOURCE_RDTSCP;
+
+    if ((Source == COREMON_SOURCE_RDPID) && !HasRDPID())
+        Source = COREMON_SOURCE_RDTSCP;
+
+    if (!AuxIsCpu)
+        Source = COREMON_SOURCE_API;
+
+    // the callback tells the drain when a thread has exited
+
+    FlsIndex = FlsAlloc(ThreadExit);
+
+    if (FlsIndex == FLS_OUT_OF_INDEXES)
+        return false;
+
+    CoreMonSource = Source;
+    CoreMonTicksPerNs = CalibrateTicksPerNs();
+    IntervalTicks = (uint64_t)(IntervalUs * 1000.0 * CoreMonTicksPerNs);
+
+    Initialized = true;
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Sampling.
+// ----------------------------------------------------------------------------
+
+static uint32_t CurrentCpu()
+{
+    PROCESSOR_NUMBER Number;
+
+#if HAS_TSC_AUX
+    unsigned int Aux = COREMON_AUX_LIMIT;
+
+    switch (CoreMonSource)
+        {
+    case COREMON_SOURCE_RDPID:
+        Aux = _rdpid_u32();
+        break;
+
+    case COREMON_SOURCE_RDTSCP:
+        __rdtscp(&Aux);
+        break;
+
+    default:
+        break;
+        }
+
+    // a CPU added after initialization is looked up through the API
+
+    if ((Aux < COREMON_AUX_LIMIT) && (AuxToCpu[Aux] != COREMON_NO_CPU))
+        return AuxToCpu[Aux];
+#endif
+
+    GetCurrentProcessorNumberEx(&Number);
+
+    return CpuFromNumber(Number.Group, Number.Number);
+}
+
+static COREMON_THREAD *RegisterThread()
+{
+    COREMON_THREAD *Thread = (COREMON_THREAD *)VirtualAlloc(NULL, sizeof(COREMON_THREAD), MEM_COMMIT, PAGE_READWRITE);
+
+    if (Thread == NULL)
+        return NULL;
+
+    if (!FlsSetValue(FlsIndex, Thread))
+    {
+        VirtualFree(Thread, 0, MEM_RELEASE);
+        return NULL;
+    }
+
+    Thread->ThreadId = GetCurrentThreadId();
+    Thread->LastCpu = COREMON_NO_CPU;
+
+    COREMON_THREAD *Next;
+
+    do
+    {
+        Next = CoreMonThreads;
+        Thread->Next = Next;
+    } while (InterlockedCompareExchangePointer((PVOID volatile *)&CoreMonThreads, Thread, Next) != Next);
+
+    CoreMonThread = Thread;
+    return Thread;
+}
+
+//
+// The slow path of CoreMonHook().  The barrier makes sure that the reader
+// sees the whole sample once it sees the new head.
+//
+
+void CoreMonSample(uint64_t Now)
+{
+    COREMON_THREAD *Thread = CoreMonThread;
+
+    if (!Initialized)
+        return;
+
+    if ((Thread == NULL) && ((Thread = RegisterThread()) == NULL))
+        return;
+
+    Thread->Calls++;
+    Thread->NextTime = Now + IntervalTicks;
+
+    uint32_t Head = Thread->Head;
+
+    if ((uint32_t)(Head - Thread->Tail) >= COREMON_RING)
+    {
+        Thread->Dropped++;
+        return;
+    }
+
+    COREMON_SAMPLE *Sample = &Thread->Ring[Head & (COREMON_RING - 1)];
+
+    Sample->Time = Now;
+    Sample->Cpu = CurrentCpu();
+
+    MemoryBarrier();
+    Thread->Head = Head + 1;
+}
+
+static COREMON_MIGRATION ClassifyMigration(uint32_t From, uint32_t To)
+{
+    if (CoreMonCpus[From].Core == CoreMonCpus[To].Core)
+        return COREMON_SIBLING;
+
+    if (CoreMonCpus[From].Type == CoreMonCpus[To].Type)
+        return COREMON_SAME_TYPE;
+
+    return (CoreMonCpus[To].Type < CoreMonCpus[From].Type) ? COREMON_FASTER_TYPE : COREMON_SLOWER_TYPE;
+}
+
+static void AddTotals(THREAD_TOTALS *Totals, const COREMON_THREAD *Thread)
+{
+    Totals->Calls += Thread->Calls;
+    Totals->Dropped += Thread->Dropped;
+    Totals->Samples += Thread->Samples;
+
+    if (Thread->Samples)
+        Totals->Seconds += (Thread->LastTime - Thread->FirstTime) / CoreMonTicksPerNs / 1e9;
+
+    for (uint32_t m = 0; m < COREMON_MIGRATIONS; m++)
+        Totals->Migrations[m] += Thread->Migrations[m];
+
+    for (uint32_t t = 0; t < COREMON_MAX_TYPES; t++)
+        Totals->TypeSamples[t] += Thread->TypeSamples[t];
+}
+
+//
+// Keeps the totals of an exited thread, in a slot of its own while there are
+// any left and added to those of thread 0 after that.
+//
+
+static void RetireThread(COREMON_THREAD *Thread)
+{
+    THREAD_TOTALS *Totals = &LateExits;
+
+    if (ExitedCount < COREMON_MAX_EXITED)
+    {
+        Totals = &ExitedThreads[ExitedCount++];
+        Totals->ThreadId = Thread->ThreadId;
+    }
+    else
+    {
+        LateExitCount++;
+    }
+
+    AddTotals(Totals, Thread);
+}
+
+//
+// Other threads only ever push onto the head of the list, so an entry past
+// the head is unlinked through its predecessor, and the head with a compare
+// and exchange that fails only if threads were pushed in front of it.
+//
+
+static void UnlinkThread(COREMON_THREAD *Prev, COREMON_THREAD *Thread)
+{
+    if (Prev == NULL)
+    {
+        if (InterlockedCompareExchangePointer((PVOID volatile *)&CoreMonThreads, Thread->Next, Thread) == Thread)
+            return;
+
+        for (Prev = CoreMonThreads; Prev->Next != Thread; Prev = Prev->Next)
+            ;
+    }
+
+    Prev->Next = Thread->Next;
+}
+
+void CoreMonDrain(void)
+{
+    COREMON_THREAD *Prev = NULL;
+    COREMON_THREAD *Thread = CoreMonThreads;
+
+    while (Thread != NULL)
+    {
+        // the thread stores its last head before it is marked as exited
+
+        bool Exited = (Thread->Exited != 0);
+
+        MemoryBarrier();
+
+        uint32_t Head = Thread->Head;
+
+        MemoryBarrier();
+
+        for (uint32_t Tail = Thread->Tail; Tail != Head; Tail++)
+        {
+            const COREMON_SAMPLE *Sample = &Thread->Ring[Tail & (COREMON_RING - 1)];
+            uint32_t Cpu = Sample->Cpu;
+
+            // nothing is known about a CPU whose type did not fit in the table
+
+            if ((Cpu >= CoreMonCpuCount) || (CoreMonCpus[Cpu].Type == COREMON_NO_TYPE))
+                continue;
+
+            if (Thread->Samples == 0)
+                Thread->FirstTime = Sample->Time;
+            else if (Cpu != Thread->LastCpu)
+                Thread->Migrations[ClassifyMigration(Thread->LastCpu, Cpu)]++;
+
+            Thread->LastCpu = Cpu;
+            Thread->LastTime = Sample->Time;
+            Thread->Samples++;
+            Thread->TypeSamples[CoreMonCpus[Cpu].Type]++;
+            CoreMonCpus[Cpu].Samples++;
+        }
+
+        // done reading the samples before the thread may overwrite them
+
+        MemoryBarrier();
+        Thread->Tail = Head;
+
+        COREMON_THREAD *Next = Thread->Next;
+
+        if (Exited)
+        {
+            RetireThread(Thread);
+            UnlinkThread(Prev, Thread);
+            VirtualFree(Thread, 0, MEM_RELEASE);
+        }
+        else
+        {
+            Prev = Thread;
+        }
+
+        Thread = Next;
+    }
+}
+
+//
+// The cost of a hook call that returns right away, and of one that takes a
+// sample, measured on a private ring that is not reported.
+//
+
+void CoreMonMeasureCost(double *HookNs, double *SampleNs)
+{
+    COREMON_THREAD *Saved = CoreMonThread;
+    COREMON_THREAD *Scratch = (COREMON_THREAD *)VirtualAlloc(NULL, sizeof(COREMON_THREAD), MEM_COMMIT, PAGE_READWRITE);
+
+    *HookNs = 0.0;
+    *SampleNs = 0.0;
+
+    if (!Initialized || (Scratch == NULL))
+        return;
+
+    CoreMonThread = Scratch;
+    Scratch->NextTime = ~0ull;
+
+    uint64_t Start = CoreMonReadTimeStamp();
+
+    for (uint32_t i = 0; i < COST_CALLS; i++)
+        CoreMonHook();
+
+    uint64_t Ticks = CoreMonReadTimeStamp() - Start;
+
+    *HookNs = Ticks / CoreMonTicksPerNs / COST_CALLS;
+
+    Start = CoreMonReadTimeStamp();
+
+    for (uint32_t i = 0; i < COST_SAMPLES; i++)
+    {
+        Scratch->NextTime = 0;
+        Scratch->Tail = Scratch->Head;
+        CoreMonHook();
+    }
+
+    Ticks = CoreMonReadTimeStamp() - Start;
+
+    *SampleNs = Ticks / CoreMonTicksPerNs / COST_SAMPLES;
+
+    CoreMonThread = Saved;
+    VirtualFree(Scratch, 0, MEM_RELEASE);
+
+    HookCostNs = *HookNs;
+    SampleCostNs = *SampleNs;
+}
+
+// ----------------------------------------------------------------------------
+// Report.
+// ----------------------------------------------------------------------------
+
+//
+// The overhead is the estimated time spent in the hook relative to the time
+// the thread was observed, which includes the time it was blocked.
+//
+
+static void ReportThread(const THREAD_TOTALS *Thread, bool CsvOutput)
+{
+    double Seconds = Thread->Seconds;
+    uint64_t Migrations = 0;
+
+    for (uint32_t m = 0; m < COREMON_MIGRATIONS; m++)
+        Migrations += Thread->Migrations[m];
+
+    double Rate = (Seconds > 0.0) ? Migrations / Seconds : 0.0;
+    double HookNs = Thread->Calls * HookCostNs + (Thread->Samples + Thread->Dropped) * (SampleCostNs - HookCostNs);
+    double Overhead = (Seconds > 0.0) ? HookNs / (Seconds * 1e9) * 100.0 : 0.0;
+
+    if (CsvOutput)
+    {
+        printf("thread,%u,%llu,%llu,%.3f,%.2f,%llu,%llu,%llu,%llu,%.4f\n",
+            Thread->ThreadId, Thread->Samples, Thread->Dropped, Seconds, Rate,
+            Thread->Migrations[COREMON_SIBLING], Thread->Migrations[COREMON_SAME_TYPE],
+            Thread->Migrations[COREMON_FASTER_TYPE], Thread->Migrations[COREMON_SLOWER_TYPE], Overhead);
+
+        for (uint32_t t = 0; t < CoreMonTypeCount; t++)
+            printf("residency,%u,%s,%.2f\n", Thread->ThreadId, CoreMonTypes[t].Name, Thread->Samples ? 100.0 * Thread->TypeSamples[t] / Thread->Samples : 0.0);
+
+        return;
+    }
+
+    printf("%8u %8llu %7llu %7.2f %10.2f %7llu %7llu %7llu %7llu %8.4f%%",
+        Thread->ThreadId, Thread->Samples, Thread->Dropped, Seconds, Rate,
+        Thread->Migrations[COREMON_SIBLING], Thread->Migrations[COREMON_SAME_TYPE],
+        Thread->Migrations[COREMON_FASTER_TYPE], Thread->Migrations[COREMON_SLOWER_TYPE], Overhead);
+
+    for (uint32_t t = 0; t < CoreMonTypeCount; t++)
+        printf(" %6.1f%%", Thread->Samples ? 100.0 * Thread->TypeSamples[t] / Thread->Samples : 0.0);
+
+    printf("\n");
+}
+
+void CoreMonReport(bool CsvOutput)
+{
+    uint64_t Total = 0;
+
+    CoreMonDrain();
+
+    for (uint32_t i = 0; i < CoreMonCpuCount; i++)
+        Total += CoreMonCpus[i].Samples;
+
+    if (!CsvOutput)
+    {
+        printf("\nCPU number read with %s.\n", CoreMonSourceName(CoreMonSource));
+        printf("\n%u logical CPUs, %u core type%s:\n\n", CoreMonCpuCount, CoreMonTypeCount, (CoreMonTypeCount == 1) ? "" : "s");
+
+        for (uint32_t t = 0; t < CoreMonTypeCount; t++)
+        {
+            printf("  type %u: %-20s efficiency class %u, leaf 1A type %02X, %3u CPUs\n",
+                t, CoreMonTypes[t].Name, CoreMonTypes[t].EfficiencyClass, CoreMonTypes[t].CoreType, CoreMonTypes[t].Cpus);
+        }
+
+        printf("\nResidency of all threads by CPU:\n\n");
+        printf("%5s %7s %8s %5s %5s %9s\n", "CPU", "g:n", "APIC ID", "core", "type", "residency");
+    }
+
+    uint32_t Untyped = 0;
+
+    for (uint32_t i = 0; i < CoreMonCpuCount; i++)
+    {
+        const COREMON_CPU *Cpu = &CoreMonCpus[i];
+        double Residency = Total ? 100.0 * Cpu->Samples / Total : 0.0;
+
+        if (Cpu->Type == COREMON_NO_TYPE)
+        {
+            Untyped++;
+            continue;
+        }
+
+        if (CsvOutput)
+            printf("cpu,%u,%u,%u,%u,%u,%s,%.2f\n", i, Cpu->Group, Cpu->Number, Cpu->ApicId, Cpu->Core, CoreMonTypes[Cpu->Type].Name, Residency);
+        else
+            printf("%5u %5u:%-2u %8u %5u %5u %8.1f%%\n", i, Cpu->Group, Cpu->Number, Cpu->ApicId, Cpu->Core, Cpu->Type, Residency);
+    }
+
+    if (!CsvOutput && Untyped)
+        printf("\n%u CPUs of more than %u core types are not monitored.\n", Untyped, COREMON_MAX_TYPES);
+
+    if (!CsvOutput)
+    {
+        printf("\nPer thread, migrations between samples to an SMT sibling, to the same core\n");
+        printf("type, to a faster core type, and to a slower one, the estimated hook\n");
+        printf("overhead, and the residency by core type:\n\n");
+        printf("%8s %8s %7s %7s %10s %7s %7s %7s %7s %9s", "thread", "samples", "dropped", "seconds", "migr/s", "sibling", "same", "faster", "slower", "overhead");
+
+        for (uint32_t t = 0; t < CoreMonTypeCount; t++)
+            printf("  type %u", t);
+
+        printf("\n");
+    }
+
+    for (COREMON_THREAD *Thread = CoreMonThreads; Thread != NULL; Thread = Thread->Next)
+    {
+        THREAD_TOTALS Totals = { Thread->ThreadId };
+
+        AddTotals(&Totals, Thread);
+        ReportThread(&Totals, CsvOutput);
+    }
+
+    for (uint32_t i = 0; i < ExitedCount; i++)
+        ReportThread(&ExitedThreads[i], CsvOutput);
+
+    if (LateExitCount)
+        ReportThread(&LateExits, CsvOutput);
+}
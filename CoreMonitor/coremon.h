@@ -0,0 +1,163 @@
+
+//
+// COREMON.H
+//
+// Core type and migration monitor, the part a process links in.
+//
+// Call CoreMonHook() from any thread as often as convenient, for example once
+// per request or per loop iteration.  It reads the time stamp counter and
+// returns unless the thread's next sample is due, so that the rate of the
+// calls does not matter and the sampling rate is the one given to
+// CoreMonInitialize().  A sample records the time and the logical CPU, read
+// with RDPID or RDTSCP when the OS keeps a unique CPU number in TSC_AUX and
+// with GetCurrentProcessorNumberEx() otherwise, into a ring owned by the
+// thread.  The core, core type, and APIC ID of each CPU are looked up once
+// at initialization, so the hook never executes CPUID, which traps to the
+// hypervisor in a virtual machine.
+//
+// Each ring has one writer, its thread, and one reader, whoever calls
+// CoreMonDrain() or CoreMonReport(), so neither side takes a lock.  A ring
+// holds COREMON_RING samples, and samples that arrive when it is full are
+// dropped and counted, so drain more often than every COREMON_RING sample
+// intervals.  Only one thread at a time may drain.
+//
+// The ring of a thread that exits is freed by the next drain, and the
+// thread's totals are kept for the report.  Threads that exit after the
+// first COREMON_MAX_EXITED are reported together as thread 0.
+//
+// 2026-10-19 darekm
+//
+
+#pragma once
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <intrin.h>
+
+#define COREMON_MAX_CPUS    (256)
+#define COREMON_MAX_TYPES   (8)
+#define COREMON_RING        (4096)     // samples per thread, a power of 2
+#define COREMON_NO_CPU      (0xFFFF)
+#define COREMON_NO_TYPE     (COREMON_MAX_TYPES)
+#define COREMON_MAX_EXITED  (256)
+
+typedef enum COREMON_SOURCE
+{
+    COREMON_SOURCE_AUTO = 0,
+    COREMON_SOURCE_RDPID,
+    COREMON_SOURCE_RDTSCP,
+    COREMON_SOURCE_API,
+} COREMON_SOURCE;
+
+//
+// The logical CPUs in group and number order, and the distinct core types,
+// most performant first.
+//
+
+typedef struct COREMON_CPU
+{
+    WORD     Group;
+    BYTE     Number;
+    BYTE     EfficiencyClass;
+    uint32_t Core;                     // CPUs with the same Core are SMT siblings
+    uint32_t CoreType;                 // CPUID leaf 0x1A EAX[31:24], 0 if not reported
+    uint32_t ApicId;                   // x2APIC ID, or the initial APIC ID
+    uint32_t TscAux;
+    uint32_t Type;                     // index into CoreMonTypes[], COREMON_NO_TYPE if it did not fit
+    uint64_t Samples;                  // by all threads
+} COREMON_CPU;
+
+typedef struct COREMON_TYPE
+{
+    BYTE     EfficiencyClass;
+    uint32_t CoreType;
+    uint32_t Cpus;
+    char     Name[48];
+} COREMON_TYPE;
+
+typedef struct COREMON_SAMPLE
+{
+    uint64_t Time;
+    uint32_t Cpu;
+    uint32_t Reserved;
+} COREMON_SAMPLE;
+
+typedef enum COREMON_MIGRATION
+{
+    COREMON_SIBLING = 0,               // to the other SMT thread of the same core
+    COREMON_SAME_TYPE,                 // to another core of the same type
+    COREMON_FASTER_TYPE,               // to a more performant core type
+    COREMON_SLOWER_TYPE,               // to a less performant core type, P-core to E-core
+    COREMON_MIGRATIONS
+} COREMON_MIGRATION;
+
+//
+// The first cache line is written by the thread on every call, the second
+// by the reader, and the ring after them by the thread on every sample.
+//
+
+typedef struct COREMON_THREAD
+{
+    __declspec(align(64))
+    uint64_t NextTime;
+    uint64_t Calls;
+    volatile uint32_t Head;            // 32 bits so that 32-bit code reads it in one go
+    volatile uint64_t Dropped;
+    DWORD    ThreadId;
+    volatile LONG Exited;              // set when the thread exits, after its last sample
+    struct COREMON_THREAD *Next;
+
+    __declspec(align(64))
+    volatile uint32_t Tail;
+    uint64_t Samples;
+    uint64_t FirstTime;
+    uint64_t LastTime;
+    uint32_t LastCpu;
+    uint64_t Migrations[COREMON_MIGRATIONS];
+    uint64_t TypeSamples[COREMON_MAX_TYPES];
+
+    __declspec(align(64))
+    COREMON_SAMPLE Ring[COREMON_RING];
+} COREMON_THREAD;
+
+extern COREMON_CPU CoreMonCpus[COREMON_MAX_CPUS];
+extern uint32_t CoreMonCpuCount;
+extern COREMON_TYPE CoreMonTypes[COREMON_MAX_TYPES];
+extern uint32_t CoreMonTypeCount;
+extern COREMON_SOURCE CoreMonSource;
+extern double CoreMonTicksPerNs;
+extern COREMON_THREAD * volatile CoreMonThreads;
+extern __declspec(thread) COREMON_THREAD *CoreMonThread;
+
+bool CoreMonInitialize(uint32_t IntervalUs, COREMON_SOURCE Source);
+void CoreMonSample(uint64_t Now);
+void CoreMonDrain(void);
+void CoreMonMeasureCost(double *HookNs, double *SampleNs);
+void CoreMonReport(bool CsvOutput);
+const char *CoreMonSourceName(COREMON_SOURCE Source);
+
+static __forceinline uint64_t CoreMonReadTimeStamp(void)
+{
+#if _M_IX86 || _M_AMD64
+    return __rdtsc();
+#else
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter(&Now);
+    return Now.QuadPart;
+#endif
+}
+
+static __forceinline void CoreMonHook(void)
+{
+    COREMON_THREAD *Thread = CoreMonThread;
+    uint64_t Now = CoreMonReadTimeStamp();
+
+    if ((Thread != NULL) && (Now < Thread->NextTime))
+    {
+        Thread->Calls++;
+        return;
+    }
+
+    CoreMonSample(Now);
+}
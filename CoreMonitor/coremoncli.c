@@ -0,0 +1,174 @@
+
+//
+// COREMONCLI.C
+//
+// Core type and migration monitor, command line front end.
+//
+// Runs worker threads that call CoreMonHook() between short units of work,
+// the way a service would call it once per request, and drains their rings
+// while they run.  By default each worker sleeps for a millisecond after
+// every thousand units, which gives the scheduler the chance to move it, as
+// blocking on I/O or a lock would.  At the end it reports the residency of
+// the workers by CPU and by core type, their migration rates, and the hook
+// overhead estimated from the cost of the hook measured up front.
+//
+// To monitor a real process, link coremon.c into it, call
+// CoreMonInitialize() at startup, CoreMonHook() from the threads of
+// interest, and CoreMonDrain() and CoreMonReport() from one other thread.
+//
+// Usage: coremon [-csv] [-threads N] [-seconds N] [-us N] [-source auto|rdpid|rdtscp|api] [-busy]
+//
+//   -csv      print machine-readable comma-separated records only
+//   -threads  number of worker threads (default one per logical CPU)
+//   -seconds  how long to run (default 10)
+//   -us       sampling interval in microseconds (default 1000)
+//   -source   how to read the CPU number (default RDPID, then RDTSCP, then the API)
+//   -busy     never sleep
+//
+// The -csv records are:
+//
+//   cost,source,hook ns,sample ns
+//   cpu,index,group,number,APIC ID,core,core type,residency %
+//   thread,id,samples,dropped,seconds,migrations per s,sibling,same type,faster type,slower type,overhead %
+//   residency,thread id,core type,residency %
+//
+// 2026-10-19 darekm
+//
+
+#include "coremon.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MAX_THREADS   (COREMON_MAX_CPUS)
+#define WORK_ITERS    (1000)           // about a microsecond of work per hook call
+#define SLEEP_UNITS   (1000)
+#define DRAIN_MS      (100)
+
+bool CsvOutput = false;
+bool Busy = false;
+volatile LONG Stop = 0;
+volatile uint64_t Sink = 0;
+
+DWORD WINAPI WorkerProc(LPVOID Param)
+{
+    uint64_t x = 0x9E3779B97F4A7C15ull + (uintptr_t)Param;
+
+    for (uint32_t Units = 1; !Stop; Units++)
+    {
+        for (uint32_t i = 0; i < WORK_ITERS; i++)
+        {
+            x ^= x << 13;
+            x ^= x >> 7;
+            x ^= x << 17;
+        }
+
+        CoreMonHook();
+
+        if (!Busy && ((Units % SLEEP_UNITS) == 0))
+            Sleep(1);
+    }
+
+    Sink += x;
+    return 0;
+}
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t Threads = 0;
+    uint32_t Seconds = 10;
+    uint32_t IntervalUs = 1000;
+    COREMON_SOURCE Source = COREMON_SOURCE_AUTO;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-threads") && (i + 1 < argc))
+            Threads = strtoul(argv[++i], NULL, 0);
+        else if (!_stricmp(argv[i], "-seconds") && (i + 1 < argc))
+            Seconds = strtoul(argv[++i], NULL, 0);
+        else if (!_stricmp(argv[i], "-us") && (i + 1 < argc))
+            IntervalUs = strtoul(argv[++i], NULL, 0);
+        else if (!_stricmp(argv[i], "-source") && (i + 1 < argc))
+        {
+            i++;
+
+            if (!_stricmp(argv[i], "rdpid"))
+                Source = COREMON_SOURCE_RDPID;
+            else if (!_stricmp(argv[i], "rdtscp"))
+                Source = COREMON_SOURCE_RDTSCP;
+            else if (!_stricmp(argv[i], "api"))
+                Source = COREMON_SOURCE_API;
+            else if (_stricmp(argv[i], "auto"))
+            {
+                printf("Usage: coremon [-csv] [-threads N] [-seconds N] [-us N] [-source auto|rdpid|rdtscp|api] [-busy]\n");
+                return 1;
+            }
+        }
+        else if (!_stricmp(argv[i], "-busy"))
+            Busy = true;
+        else
+        {
+            printf("Usage: coremon [-csv] [-threads N] [-seconds N] [-us N] [-source auto|rdpid|rdtscp|api] [-busy]\n");
+            return 1;
+        }
+    }
+
+    if (!CoreMonInitialize(IntervalUs, Source))
+    {
+        printf("Unable to initialize the monitor\n");
+        return 1;
+    }
+
+    if (Threads == 0)
+        Threads = CoreMonCpuCount;
+
+    Threads = min(Threads, MAX_THREADS);
+
+    double HookNs, SampleNs;
+
+    CoreMonMeasureCost(&HookNs, &SampleNs);
+
+    if (CsvOutput)
+    {
+        printf("cost,%s,%.2f,%.2f\n", CoreMonSourceName(CoreMonSource), HookNs, SampleNs);
+    }
+    else
+    {
+        printf("\nHook cost %.1f ns, %.1f ns when it takes a sample with %s.\n", HookNs, SampleNs, CoreMonSourceName(CoreMonSource));
+        printf("Sampling %u threads every %u us for %u seconds.\n", Threads, IntervalUs, Seconds);
+    }
+
+    HANDLE Handles[MAX_THREADS];
+    uint32_t Started = 0;
+
+    for (uint32_t t = 0; t < Threads; t++)
+    {
+        Handles[Started] = CreateThread(NULL, 0, WorkerProc, (LPVOID)(uintptr_t)t, 0, NULL);
+
+        if (Handles[Started] == NULL)
+            printf("CreateThread failed with error %u\n", GetLastError());
+        else
+            Started++;
+    }
+
+    ULONGLONG End = GetTickCount64() + Seconds * 1000ull;
+
+    while (GetTickCount64() < End)
+    {
+        Sleep(DRAIN_MS);
+        CoreMonDrain();
+    }
+
+    InterlockedExchange(&Stop, 1);
+
+    for (uint32_t t = 0; t < Started; t++)
+    {
+        WaitForSingleObject(Handles[t], INFINITE);
+        CloseHandle(Handles[t]);
+    }
+
+    CoreMonReport(CsvOutput);
+
+    return 0;
+}
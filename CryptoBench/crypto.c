@@ -0,0 +1,1309 @@
+
+//
+// CRYPTO.C
+//
+// Crypto acceleration throughput probe: AES-NI, VAES, PCLMUL/VPCLMUL, SHA-NI, GFNI.
+//
+// CPUIDEX.C shows which of these extensions are present.  TLS stacks pick
+// their cipher implementations from those same bits, yet under emulation or
+// on small cores the "accelerated" path can be slower than portable code.
+// This runs streaming AES-128-CTR, GHASH, AES-128-GCM, SHA-1, SHA-256, and
+// GF(2^8) multiply kernels at 128-, 256-, and 512-bit width next to portable
+// table-driven C versions of the same algorithms, over buffer sizes from 64
+// bytes to 64 MB, and reports bytes per TSC tick.  Every accelerated kernel
+// is first checked against the portable one so that a broken emulation of an
+// instruction shows up as a mismatch rather than as a suspiciously fast
+// result.
+//
+// The TSC runs at the nominal frequency, so bytes per tick equals bytes per
+// clock only when the core runs at its base frequency.
+//
+// Usage: crypto [-csv]
+//
+// The -csv records are:
+//
+//   kernel,width,bytes,bytes per tick,MB/s
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <intrin.h>
+
+#define MIN_BYTES     (64)
+#define MAX_BYTES     (64 * 1024 * 1024)
+#define TARGET_BYTES  (32 * 1024 * 1024)     // bytes processed per measurement
+#define CHECK_BYTES   (4096 + 77)            // odd size so that the tails are checked too
+#define GCM_CHUNK     (4096)
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+#define HAS_X86_CRYPTO  (1)
+#endif
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+bool CsvOutput = false;
+
+//
+// Key material shared by all the implementations.  The CTR counter block is
+// a 64-bit little-endian block counter followed by a 64-bit nonce, which
+// keeps the SIMD counter increment a single 64-bit add.
+//
+
+uint8_t  RoundKeys[11][16];
+uint8_t  HashKey[16];                  // GHASH key H = AES(K, 0)
+uint64_t Nonce = 0x0123456789ABCDEFull;
+uint8_t  Digest[32];                   // tag or digest of the last hash kernel
+
+typedef void (KERNEL)(const uint8_t *In, uint8_t *Out, size_t Bytes);
+
+// ----------------------------------------------------------------------------
+// Portable AES-128 with 32-bit T-tables, the classic software implementation.
+// ----------------------------------------------------------------------------
+
+uint8_t  Sbox[256];
+uint32_t Te0[256], Te1[256], Te2[256], Te3[256];
+
+uint8_t Rotl8(uint8_t x, int n)
+{
+    return (uint8_t)((x << n) | (x >> (8 - n)));
+}
+
+uint8_t XTime(uint8_t x)
+{
+    return (uint8_t)((x << 1) ^ ((x & 0x80) ? 0x1B : 0));
+}
+
+uint32_t Rotl32(uint32_t x, int n)
+{
+    return (x << n) | (x >> (32 - n));
+}
+
+void BuildAesTables()
+{
+    uint8_t p = 1, q = 1;
+
+    // walk the multiplicative group with generator 3, q is always the inverse of p
+
+    do
+    {
+        p = (uint8_t)(p ^ XTime(p));
+
+        q = (uint8_t)(q ^ (q << 1));
+        q = (uint8_t)(q ^ (q << 2));
+        q = (uint8_t)(q ^ (q << 4));
+
+        if (q & 0x80)
+            q ^= 0x09;
+
+        Sbox[p] = (uint8_t)(q ^ Rotl8(q, 1) ^ Rotl8(q, 2) ^ Rotl8(q, 3) ^ Rotl8(q, 4) ^ 0x63);
+    } while (p != 1);
+
+    Sbox[0] = 0x63;
+
+    // a column word holds row 0 in the low byte
+
+    for (int x = 0; x < 256; x++)
+    {
+        uint32_t s = Sbox[x];
+        uint32_t s2 = XTime((uint8_t)s);
+        uint32_t s3 = s2 ^ s;
+
+        Te0[x] = s2 | (s << 8) | (s << 16) | (s3 << 24);
+        Te1[x] = Rotl32(Te0[x], 8);
+        Te2[x] = Rotl32(Te0[x], 16);
+        Te3[x] = Rotl32(Te0[x], 24);
+    }
+}
+
+uint32_t Load32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+void Store32(uint8_t *p, uint32_t v)
+{
+    p[0] = (uint8_t)v; p[1] = (uint8_t)(v >> 8); p[2] = (uint8_t)(v >> 16); p[3] = (uint8_t)(v >> 24);
+}
+
+void ExpandAesKey(const uint8_t Key[16])
+{
+    static const uint8_t Rcon[10] = { 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80, 0x1B, 0x36 };
+    uint32_t w[44];
+
+    for (int i = 0; i < 4; i++)
+        w[i] = Load32(&Key[4 * i]);
+
+    for (int i = 4; i < 44; i++)
+    {
+        uint32_t t = w[i - 1];
+
+        if ((i % 4) == 0)
+        {
+            t = (t >> 8) | (t << 24);
+            t = Sbox[t & 0xFF] | (Sbox[(t >> 8) & 0xFF] << 8) | (Sbox[(t >> 16) & 0xFF] << 16) | ((uint32_t)Sbox[t >> 24] << 24);
+            t ^= Rcon[i / 4 - 1];
+        }
+
+        w[i] = w[i - 4] ^ t;
+    }
+
+    for (int i = 0; i < 44; i++)
+        Store32(&RoundKeys[i / 4][4 * (i % 4)], w[i]);
+}
+
+void AesEncryptBlockTable(const uint8_t In[16], uint8_t Out[16])
+{
+    uint32_t s[4], t[4];
+
+    for (int c = 0; c < 4; c++)
+        s[c] = Load32(&In[4 * c]) ^ Load32(&RoundKeys[0][4 * c]);
+
+    for (int Round = 1; Round < 10; Round++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            t[c] = Te0[s[c] & 0xFF] ^ Te1[(s[(c + 1) & 3] >> 8) & 0xFF] ^
+                   Te2[(s[(c + 2) & 3] >> 16) & 0xFF] ^ Te3[s[(c + 3) & 3] >> 24] ^
+                   Load32(&RoundKeys[Round][4 * c]);
+        }
+
+        memcpy(s, t, sizeof(s));
+    }
+
+    for (int c = 0; c < 4; c++)
+    {
+        uint32_t v = Sbox[s[c] & 0xFF] | (Sbox[(s[(c + 1) & 3] >> 8) & 0xFF] << 8) |
+                     (Sbox[(s[(c + 2) & 3] >> 16) & 0xFF] << 16) | ((uint32_t)Sbox[s[(c + 3) & 3] >> 24] << 24);
+
+        Store32(&Out[4 * c], v ^ Load32(&RoundKeys[10][4 * c]));
+    }
+}
+
+void AesCtrTable(uint64_t Counter, const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    uint8_t Block[16], Stream[16];
+
+    for (size_t i = 0; i < Bytes; i += 16, Counter++)
+    {
+        memcpy(&Block[0], &Counter, 8);
+        memcpy(&Block[8], &Nonce, 8);
+
+        AesEncryptBlockTable(Block, Stream);
+
+        size_t n = min(16, Bytes - i);
+
+        for (size_t j = 0; j < n; j++)
+            Out[i + j] = In[i + j] ^ Stream[j];
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Portable GHASH with Shoup's 4-bit tables.
+// ----------------------------------------------------------------------------
+
+uint64_t GhashHL[16], GhashHH[16];
+
+const uint64_t GhashLast4[16] =
+{
+    0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+    0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0,
+};
+
+uint64_t LoadBE64(const uint8_t *p)
+{
+    uint64_t v = 0;
+
+    for (int i = 0; i < 8; i++)
+        v = (v << 8) | p[i];
+
+    return v;
+}
+
+void StoreBE64(uint8_t *p, uint64_t v)
+{
+    for (int i = 7; i >= 0; i--, v >>= 8)
+        p[i] = (uint8_t)v;
+}
+
+void BuildGhashTables()
+{
+    uint64_t vh = LoadBE64(&HashKey[0]);
+    uint64_t vl = LoadBE64(&HashKey[8]);
+
+    GhashHL[8] = vl;
+    GhashHH[8] = vh;
+    GhashHL[0] = GhashHH[0] = 0;
+
+    for (int i = 4; i > 0; i >>= 1)
+    {
+        uint64_t T = (vl & 1) * 0xE1000000ull;
+
+        vl = (vh << 63) | (vl >> 1);
+        vh = (vh >> 1) ^ (T << 32);
+
+        GhashHL[i] = vl;
+        GhashHH[i] = vh;
+    }
+
+    for (int i = 2; i <= 8; i *= 2)
+    {
+        for (int j = 1; j < i; j++)
+        {
+            GhashHH[i + j] = GhashHH[i] ^ GhashHH[j];
+            GhashHL[i + j] = GhashHL[i] ^ GhashHL[j];
+        }
+    }
+}
+
+void GhashMultiplyTable(uint8_t X[16])
+{
+    uint64_t zh = GhashHH[X[15] & 0xF];
+    uint64_t zl = GhashHL[X[15] & 0xF];
+
+    for (int i = 15; i >= 0; i--)
+    {
+        int lo = X[i] & 0xF;
+        int hi = X[i] >> 4;
+        int rem;
+
+        if (i != 15)
+        {
+            rem = zl & 0xF;
+            zl = (zh << 60) | (zl >> 4);
+            zh = (zh >> 4) ^ (GhashLast4[rem] << 48);
+            zh ^= GhashHH[lo];
+            zl ^= GhashHL[lo];
+        }
+
+        rem = zl & 0xF;
+        zl = (zh << 60) | (zl >> 4);
+        zh = (zh >> 4) ^ (GhashLast4[rem] << 48);
+        zh ^= GhashHH[hi];
+        zl ^= GhashHL[hi];
+    }
+
+    StoreBE64(&X[0], zh);
+    StoreBE64(&X[8], zl);
+}
+
+void GhashTable(uint8_t State[16], const uint8_t *In, size_t Bytes)
+{
+    for (size_t i = 0; i < Bytes; i += 16)
+    {
+        size_t n = min(16, Bytes - i);
+
+        for (size_t j = 0; j < n; j++)
+            State[j] ^= In[i + j];
+
+        GhashMultiplyTable(State);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Portable SHA-1 and SHA-256.
+// ----------------------------------------------------------------------------
+
+typedef void (COMPRESS)(uint32_t *State, const uint8_t *Blocks, size_t Count);
+
+const uint32_t Sha256K[64] =
+{
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2,
+};
+
+uint32_t LoadBE32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+}
+
+uint32_t Rotr32(uint32_t x, int n)
+{
+    return (x >> n) | (x << (32 - n));
+}
+
+void Sha256CompressC(uint32_t *State, const uint8_t *Blocks, size_t Count)
+{
+    for (size_t b = 0; b < Count; b++, Blocks += 64)
+    {
+        uint32_t w[64];
+
+        for (int i = 0; i < 16; i++)
+            w[i] = LoadBE32(&Blocks[4 * i]);
+
+        for (int i = 16; i < 64; i++)
+        {
+            uint32_t s0 = Rotr32(w[i - 15], 7) ^ Rotr32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            uint32_t s1 = Rotr32(w[i - 2], 17) ^ Rotr32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        uint32_t a = State[0], b1 = State[1], c = State[2], d = State[3];
+        uint32_t e = State[4], f = State[5], g = State[6], h = State[7];
+
+        for (int i = 0; i < 64; i++)
+        {
+            uint32_t S1 = Rotr32(e, 6) ^ Rotr32(e, 11) ^ Rotr32(e, 25);
+            uint32_t Ch = (e & f) ^ (~e & g);
+            uint32_t T1 = h + S1 + Ch + Sha256K[i] + w[i];
+            uint32_t S0 = Rotr32(a, 2) ^ Rotr32(a, 13) ^ Rotr32(a, 22);
+            uint32_t Maj = (a & b1) ^ (a & c) ^ (b1 & c);
+            uint32_t T2 = S0 + Maj;
+
+            h = g; g = f; f = e; e = d + T1;
+            d = c; c = b1; b1 = a; a = T1 + T2;
+        }
+
+        State[0] += a; State[1] += b1; State[2] += c; State[3] += d;
+        State[4] += e; State[5] += f;  State[6] += g; State[7] += h;
+    }
+}
+
+void Sha1CompressC(uint32_t *State, const uint8_t *Blocks, size_t Count)
+{
+    for (size_t b = 0; b < Count; b++, Blocks += 64)
+    {
+        uint32_t w[80];
+
+        for (int i = 0; i < 16; i++)
+            w[i] = LoadBE32(&Blocks[4 * i]);
+
+        for (int i = 16; i < 80; i++)
+            w[i] = Rotl32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+
+        uint32_t a = State[0], b1 = State[1], c = State[2], d = State[3], e = State[4];
+
+        for (int i = 0; i < 80; i++)
+        {
+            uint32_t f, k;
+
+            if (i < 20)      { f = (b1 & c) | (~b1 & d);           k = 0x5A827999; }
+            else if (i < 40) { f = b1 ^ c ^ d;                     k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b1 & c) | (b1 & d) | (c & d);  k = 0x8F1BBCDC; }
+            else             { f = b1 ^ c ^ d;                     k = 0xCA62C1D6; }
+
+            uint32_t t = Rotl32(a, 5) + f + e + k + w[i];
+
+            e = d; d = c; c = Rotl32(b1, 30); b1 = a; a = t;
+        }
+
+        State[0] += a; State[1] += b1; State[2] += c; State[3] += d; State[4] += e;
+    }
+}
+
+//
+// Hash a whole message with the standard padding, using the given
+// compression function for the bulk of it.
+//
+
+void ShaHash(COMPRESS *Compress, const uint32_t *Initial, int Words, const uint8_t *In, size_t Bytes)
+{
+    uint32_t State[8];
+    uint8_t Tail[128] = { 0 };
+
+    memcpy(State, Initial, Words * sizeof(uint32_t));
+
+    size_t Whole = Bytes / 64;
+    (*Compress)(State, In, Whole);
+
+    size_t Left = Bytes - Whole * 64;
+    memcpy(Tail, In + Whole * 64, Left);
+    Tail[Left] = 0x80;
+
+    size_t TailBytes = (Left < 56) ? 64 : 128;
+    StoreBE64(&Tail[TailBytes - 8], (uint64_t)Bytes * 8);
+
+    (*Compress)(State, Tail, TailBytes / 64);
+
+    for (int i = 0; i < Words; i++)
+    {
+        Digest[4 * i + 0] = (uint8_t)(State[i] >> 24);
+        Digest[4 * i + 1] = (uint8_t)(State[i] >> 16);
+        Digest[4 * i + 2] = (uint8_t)(State[i] >> 8);
+        Digest[4 * i + 3] = (uint8_t)(State[i]);
+    }
+}
+
+const uint32_t Sha1Initial[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+
+const uint32_t Sha256Initial[8] =
+{
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19,
+};
+
+// ----------------------------------------------------------------------------
+// Portable GF(2^8) multiply by a constant, one table lookup per byte.
+// ----------------------------------------------------------------------------
+
+#define GF_CONSTANT   (0x57)
+
+uint8_t GfTable[256];
+
+uint8_t GfMultiply(uint8_t a, uint8_t b)
+{
+    uint8_t p = 0;
+
+    for (int i = 0; i < 8; i++, b >>= 1)
+    {
+        if (b & 1)
+            p ^= a;
+
+        a = XTime(a);
+    }
+
+    return p;
+}
+
+void BuildGfTable()
+{
+    for (int x = 0; x < 256; x++)
+        GfTable[x] = GfMultiply((uint8_t)x, GF_CONSTANT);
+}
+
+// ----------------------------------------------------------------------------
+// The portable kernels.
+// ----------------------------------------------------------------------------
+
+void KernelAesCtrC(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    AesCtrTable(0, In, Out, Bytes);
+}
+
+void KernelGhashC(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    (void)Out;
+    memset(Digest, 0, 16);
+    GhashTable(Digest, In, Bytes);
+}
+
+void KernelGcmC(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    memset(Digest, 0, 16);
+
+    for (size_t i = 0; i < Bytes; i += GCM_CHUNK)
+    {
+        size_t n = min(GCM_CHUNK, Bytes - i);
+
+        AesCtrTable(i / 16, In + i, Out + i, n);
+        GhashTable(Digest, Out + i, n);
+    }
+}
+
+void KernelSha1C(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    (void)Out;
+    ShaHash(Sha1CompressC, Sha1Initial, 5, In, Bytes);
+}
+
+void KernelSha256C(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    (void)Out;
+    ShaHash(Sha256CompressC, Sha256Initial, 8, In, Bytes);
+}
+
+void KernelGfC(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    for (size_t i = 0; i < Bytes; i++)
+        Out[i] = GfTable[In[i]];
+}
+
+#if HAS_X86_CRYPTO
+
+// ----------------------------------------------------------------------------
+// AES-CTR with AES-NI, one and four blocks at a time, and with VAES.
+// ----------------------------------------------------------------------------
+
+void AesNiCtr(uint64_t Counter, const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    __m128i Rk[11];
+
+    for (int r = 0; r < 11; r++)
+        Rk[r] = _mm_loadu_si128((const __m128i *)RoundKeys[r]);
+
+    __m128i Ctr = _mm_set_epi64x((int64_t)Nonce, (int64_t)Counter);
+    __m128i One = _mm_set_epi64x(0, 1);
+    __m128i Four = _mm_set_epi64x(0, 4);
+
+    size_t i = 0;
+
+    // four independent blocks keep the AES unit busy
+
+    for (; i + 64 <= Bytes; i += 64)
+    {
+        __m128i b0 = _mm_xor_si128(Ctr, Rk[0]);
+        __m128i b1 = _mm_xor_si128(_mm_add_epi64(Ctr, One), Rk[0]);
+        __m128i b2 = _mm_xor_si128(_mm_add_epi64(Ctr, _mm_add_epi64(One, One)), Rk[0]);
+        __m128i b3 = _mm_xor_si128(_mm_sub_epi64(_mm_add_epi64(Ctr, Four), One), Rk[0]);
+
+        for (int r = 1; r < 10; r++)
+        {
+            b0 = _mm_aesenc_si128(b0, Rk[r]);
+            b1 = _mm_aesenc_si128(b1, Rk[r]);
+            b2 = _mm_aesenc_si128(b2, Rk[r]);
+            b3 = _mm_aesenc_si128(b3, Rk[r]);
+        }
+
+        b0 = _mm_aesenclast_si128(b0, Rk[10]);
+        b1 = _mm_aesenclast_si128(b1, Rk[10]);
+        b2 = _mm_aesenclast_si128(b2, Rk[10]);
+        b3 = _mm_aesenclast_si128(b3, Rk[10]);
+
+        _mm_storeu_si128((__m128i *)&Out[i +  0], _mm_xor_si128(b0, _mm_loadu_si128((const __m128i *)&In[i +  0])));
+        _mm_storeu_si128((__m128i *)&Out[i + 16], _mm_xor_si128(b1, _mm_loadu_si128((const __m128i *)&In[i + 16])));
+        _mm_storeu_si128((__m128i *)&Out[i + 32], _mm_xor_si128(b2, _mm_loadu_si128((const __m128i *)&In[i + 32])));
+        _mm_storeu_si128((__m128i *)&Out[i + 48], _mm_xor_si128(b3, _mm_loadu_si128((const __m128i *)&In[i + 48])));
+
+        Ctr = _mm_add_epi64(Ctr, Four);
+    }
+
+    for (; i < Bytes; i += 16)
+    {
+        __m128i b = _mm_xor_si128(Ctr, Rk[0]);
+
+        for (int r = 1; r < 10; r++)
+            b = _mm_aesenc_si128(b, Rk[r]);
+
+        b = _mm_aesenclast_si128(b, Rk[10]);
+        Ctr = _mm_add_epi64(Ctr, One);
+
+        if (i + 16 <= Bytes)
+        {
+            _mm_storeu_si128((__m128i *)&Out[i], _mm_xor_si128(b, _mm_loadu_si128((const __m128i *)&In[i])));
+        }
+        else
+        {
+            uint8_t Stream[16];
+            _mm_storeu_si128((__m128i *)Stream, b);
+
+            for (size_t j = 0; i + j < Bytes; j++)
+                Out[i + j] = In[i + j] ^ Stream[j];
+        }
+    }
+}
+
+void VaesCtr256(uint64_t Counter, const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    __m256i Rk[11];
+
+    for (int r = 0; r < 11; r++)
+        Rk[r] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)RoundKeys[r]));
+
+    __m256i Ctr = _mm256_set_epi64x((int64_t)Nonce, (int64_t)Counter + 1, (int64_t)Nonce, (int64_t)Counter);
+    __m256i Two = _mm256_set_epi64x(0, 2, 0, 2);
+    __m256i Four = _mm256_set_epi64x(0, 4, 0, 4);
+
+    size_t i = 0;
+
+    for (; i + 64 <= Bytes; i += 64)
+    {
+        __m256i b0 = _mm256_xor_si256(Ctr, Rk[0]);
+        __m256i b1 = _mm256_xor_si256(_mm256_add_epi64(Ctr, Two), Rk[0]);
+
+        for (int r = 1; r < 10; r++)
+        {
+            b0 = _mm256_aesenc_epi128(b0, Rk[r]);
+            b1 = _mm256_aesenc_epi128(b1, Rk[r]);
+        }
+
+        b0 = _mm256_aesenclast_epi128(b0, Rk[10]);
+        b1 = _mm256_aesenclast_epi128(b1, Rk[10]);
+
+        _mm256_storeu_si256((__m256i *)&Out[i +  0], _mm256_xor_si256(b0, _mm256_loadu_si256((const __m256i *)&In[i +  0])));
+        _mm256_storeu_si256((__m256i *)&Out[i + 32], _mm256_xor_si256(b1, _mm256_loadu_si256((const __m256i *)&In[i + 32])));
+
+        Ctr = _mm256_add_epi64(Ctr, Four);
+    }
+
+    AesNiCtr(Counter + i / 16, In + i, Out + i, Bytes - i);
+}
+
+void VaesCtr512(uint64_t Counter, const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    __m512i Rk[11];
+
+    for (int r = 0; r < 11; r++)
+        Rk[r] = _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)RoundKeys[r]));
+
+    __m512i Ctr = _mm512_set_epi64((int64_t)Nonce, (int64_t)Counter + 3, (int64_t)Nonce, (int64_t)Counter + 2,
+                                   (int64_t)Nonce, (int64_t)Counter + 1, (int64_t)Nonce, (int64_t)Counter);
+    __m512i Four = _mm512_set_epi64(0, 4, 0, 4, 0, 4, 0, 4);
+    __m512i Eight = _mm512_set_epi64(0, 8, 0, 8, 0, 8, 0, 8);
+
+    size_t i = 0;
+
+    for (; i + 128 <= Bytes; i += 128)
+    {
+        __m512i b0 = _mm512_xor_si512(Ctr, Rk[0]);
+        __m512i b1 = _mm512_xor_si512(_mm512_add_epi64(Ctr, Four), Rk[0]);
+
+        for (int r = 1; r < 10; r++)
+        {
+            b0 = _mm512_aesenc_epi128(b0, Rk[r]);
+            b1 = _mm512_aesenc_epi128(b1, Rk[r]);
+        }
+
+        b0 = _mm512_aesenclast_epi128(b0, Rk[10]);
+        b1 = _mm512_aesenclast_epi128(b1, Rk[10]);
+
+        _mm512_storeu_si512((__m512i *)&Out[i +  0], _mm512_xor_si512(b0, _mm512_loadu_si512((const __m512i *)&In[i +  0])));
+        _mm512_storeu_si512((__m512i *)&Out[i + 64], _mm512_xor_si512(b1, _mm512_loadu_si512((const __m512i *)&In[i + 64])));
+
+        Ctr = _mm512_add_epi64(Ctr, Eight);
+    }
+
+    AesNiCtr(Counter + i / 16, In + i, Out + i, Bytes - i);
+}
+
+// ----------------------------------------------------------------------------
+// GHASH with carry-less multiply.  Blocks are byte-reversed so that the
+// polynomial bits line up with PCLMULQDQ, and the product is reduced with
+// the shift-and-fold method from the Intel GCM white paper.  The wide
+// versions multiply N blocks by H^N..H^1 at once and reduce only once,
+// which works because the reduction is linear.
+// ----------------------------------------------------------------------------
+
+__m128i ByteSwapMask;
+__m128i HashPowers[4];                 // H^4, H^3, H^2, H^1 in byte-reversed form
+
+void ClmulProduct(__m128i a, __m128i b, __m128i *Lo, __m128i *Hi)
+{
+    __m128i t0 = _mm_clmulepi64_si128(a, b, 0x00);
+    __m128i t1 = _mm_xor_si128(_mm_clmulepi64_si128(a, b, 0x10), _mm_clmulepi64_si128(a, b, 0x01));
+    __m128i t2 = _mm_clmulepi64_si128(a, b, 0x11);
+
+    *Lo = _mm_xor_si128(t0, _mm_slli_si128(t1, 8));
+    *Hi = _mm_xor_si128(t2, _mm_srli_si128(t1, 8));
+}
+
+__m128i ClmulReduce(__m128i Lo, __m128i Hi)
+{
+    // shift the 256-bit product left by one bit for the reflected bit order
+
+    __m128i t7 = _mm_srli_epi32(Lo, 31);
+    __m128i t8 = _mm_srli_epi32(Hi, 31);
+
+    Lo = _mm_slli_epi32(Lo, 1);
+    Hi = _mm_slli_epi32(Hi, 1);
+
+    __m128i t9 = _mm_srli_si128(t7, 12);
+
+    t8 = _mm_slli_si128(t8, 4);
+    t7 = _mm_slli_si128(t7, 4);
+    Lo = _mm_or_si128(Lo, t7);
+    Hi = _mm_or_si128(_mm_or_si128(Hi, t8), t9);
+
+    // reduce modulo x^128 + x^7 + x^2 + x + 1
+
+    t7 = _mm_xor_si128(_mm_xor_si128(_mm_slli_epi32(Lo, 31), _mm_slli_epi32(Lo, 30)), _mm_slli_epi32(Lo, 25));
+    t8 = _mm_srli_si128(t7, 4);
+    t7 = _mm_slli_si128(t7, 12);
+    Lo = _mm_xor_si128(Lo, t7);
+
+    __m128i t2 = _mm_xor_si128(_mm_xor_si128(_mm_srli_epi32(Lo, 1), _mm_srli_epi32(Lo, 2)), _mm_srli_epi32(Lo, 7));
+    t2 = _mm_xor_si128(t2, t8);
+    Lo = _mm_xor_si128(Lo, t2);
+
+    return _mm_xor_si128(Hi, Lo);
+}
+
+__m128i ClmulMultiply(__m128i a, __m128i b)
+{
+    __m128i Lo, Hi;
+
+    ClmulProduct(a, b, &Lo, &Hi);
+    return ClmulReduce(Lo, Hi);
+}
+
+void BuildHashPowers()
+{
+    ByteSwapMask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    __m128i H = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)HashKey), ByteSwapMask);
+
+    HashPowers[3] = H;
+    HashPowers[2] = ClmulMultiply(HashPowers[3], H);
+    HashPowers[1] = ClmulMultiply(HashPowers[2], H);
+    HashPowers[0] = ClmulMultiply(HashPowers[1], H);
+}
+
+__m128i LoadBlockSwapped(const uint8_t *In, size_t Bytes)
+{
+    uint8_t Block[16] = { 0 };
+
+    // a partial final block is padded with zeros
+
+    memcpy(Block, In, min(16, Bytes));
+    return _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)Block), ByteSwapMask);
+}
+
+void GhashClmul(uint8_t State[16], const uint8_t *In, size_t Bytes)
+{
+    __m128i X = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)State), ByteSwapMask);
+    __m128i H = HashPowers[3];
+
+    size_t i = 0;
+
+    for (; i + 16 <= Bytes; i += 16)
+    {
+        __m128i Block = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&In[i]), ByteSwapMask);
+        X = ClmulMultiply(_mm_xor_si128(X, Block), H);
+    }
+
+    if (i < Bytes)
+        X = ClmulMultiply(_mm_xor_si128(X, LoadBlockSwapped(&In[i], Bytes - i)), H);
+
+    _mm_storeu_si128((__m128i *)State, _mm_shuffle_epi8(X, ByteSwapMask));
+}
+
+void GhashVpclmul256(uint8_t State[16], const uint8_t *In, size_t Bytes)
+{
+    __m256i Mask = _mm256_broadcastsi128_si256(ByteSwapMask);
+    __m256i Powers = _mm256_loadu2_m128i(&HashPowers[3], &HashPowers[2]);
+    __m128i X = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)State), ByteSwapMask);
+
+    size_t i = 0;
+
+    for (; i + 32 <= Bytes; i += 32)
+    {
+        __m256i Blocks = _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i *)&In[i]), Mask);
+
+        // the running hash joins the first block, which gets the highest power of H
+
+        Blocks = _mm256_xor_si256(Blocks, _mm256_zextsi128_si256(X));
+
+        __m256i t0 = _mm256_clmulepi64_epi128(Blocks, Powers, 0x00);
+        __m256i t1 = _mm256_xor_si256(_mm256_clmulepi64_epi128(Blocks, Powers, 0x10), _mm256_clmulepi64_epi128(Blocks, Powers, 0x01));
+        __m256i t2 = _mm256_clmulepi64_epi128(Blocks, Powers, 0x11);
+
+        __m256i Lo = _mm256_xor_si256(t0, _mm256_bslli_epi128(t1, 8));
+        __m256i Hi = _mm256_xor_si256(t2, _mm256_bsrli_epi128(t1, 8));
+
+        X = ClmulReduce(_mm_xor_si128(_mm256_castsi256_si128(Lo), _mm256_extracti128_si256(Lo, 1)),
+                        _mm_xor_si128(_mm256_castsi256_si128(Hi), _mm256_extracti128_si256(Hi, 1)));
+    }
+
+    _mm_storeu_si128((__m128i *)State, _mm_shuffle_epi8(X, ByteSwapMask));
+
+    GhashClmul(State, In + i, Bytes - i);
+}
+
+void GhashVpclmul512(uint8_t State[16], const uint8_t *In, size_t Bytes)
+{
+    __m512i Mask = _mm512_broadcast_i32x4(ByteSwapMask);
+    __m512i Powers = _mm512_loadu_si512((const __m512i *)HashPowers);
+    __m128i X = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)State), ByteSwapMask);
+
+    size_t i = 0;
+
+    for (; i + 64 <= Bytes; i += 64)
+    {
+        __m512i Blocks = _mm512_shuffle_epi8(_mm512_loadu_si512((const __m512i *)&In[i]), Mask);
+
+        Blocks = _mm512_xor_si512(Blocks, _mm512_zextsi128_si512(X));
+
+        __m512i t0 = _mm512_clmulepi64_epi128(Blocks, Powers, 0x00);
+        __m512i t1 = _mm512_xor_si512(_mm512_clmulepi64_epi128(Blocks, Powers, 0x10), _mm512_clmulepi64_epi128(Blocks, Powers, 0x01));
+        __m512i t2 = _mm512_clmulepi64_epi128(Blocks, Powers, 0x11);
+
+        __m512i Lo = _mm512_xor_si512(t0, _mm512_bslli_epi128(t1, 8));
+        __m512i Hi = _mm512_xor_si512(t2, _mm512_bsrli_epi128(t1, 8));
+
+        // fold the four lanes together before the single reduction
+
+        __m256i Lo2 = _mm256_xor_si256(_mm512_castsi512_si256(Lo), _mm512_extracti64x4_epi64(Lo, 1));
+        __m256i Hi2 = _mm256_xor_si256(_mm512_castsi512_si256(Hi), _mm512_extracti64x4_epi64(Hi, 1));
+
+        X = ClmulReduce(_mm_xor_si128(_mm256_castsi256_si128(Lo2), _mm256_extracti128_si256(Lo2, 1)),
+                        _mm_xor_si128(_mm256_castsi256_si128(Hi2), _mm256_extracti128_si256(Hi2, 1)));
+    }
+
+    _mm_storeu_si128((__m128i *)State, _mm_shuffle_epi8(X, ByteSwapMask));
+
+    GhashClmul(State, In + i, Bytes - i);
+}
+
+// ----------------------------------------------------------------------------
+// SHA-1 and SHA-256 with the SHA extensions.
+// ----------------------------------------------------------------------------
+
+void Sha256CompressNi(uint32_t *State, const uint8_t *Blocks, size_t Count)
+{
+    const __m128i Mask = _mm_set_epi64x(0x0C0D0E0F08090A0Bull, 0x0405060700010203ull);
+
+    // the rounds instruction wants the state as ABEF and CDGH
+
+    __m128i Tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&State[0]), 0xB1);
+    __m128i State1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&State[4]), 0x1B);
+    __m128i State0 = _mm_alignr_epi8(Tmp, State1, 8);
+
+    State1 = _mm_blend_epi16(State1, Tmp, 0xF0);
+
+    for (size_t b = 0; b < Count; b++, Blocks += 64)
+    {
+        __m128i Save0 = State0;
+        __m128i Save1 = State1;
+        __m128i Msg[4];
+
+        for (int i = 0; i < 16; i++)
+        {
+            if (i < 4)
+                Msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&Blocks[16 * i]), Mask);
+
+            __m128i Wk = _mm_add_epi32(Msg[i & 3], _mm_loadu_si128((const __m128i *)&Sha256K[4 * i]));
+
+            State1 = _mm_sha256rnds2_epu32(State1, State0, Wk);
+
+            // schedule the message four rounds ahead
+
+            if ((i >= 3) && (i < 15))
+            {
+                __m128i Next = _mm_add_epi32(Msg[(i + 1) & 3], _mm_alignr_epi8(Msg[i & 3], Msg[(i - 1) & 3], 4));
+                Msg[(i + 1) & 3] = _mm_sha256msg2_epu32(Next, Msg[i & 3]);
+            }
+
+            State0 = _mm_sha256rnds2_epu32(State0, State1, _mm_shuffle_epi32(Wk, 0x0E));
+
+            if ((i >= 1) && (i < 13))
+                Msg[(i - 1) & 3] = _mm_sha256msg1_epu32(Msg[(i - 1) & 3], Msg[i & 3]);
+        }
+
+        State0 = _mm_add_epi32(State0, Save0);
+        State1 = _mm_add_epi32(State1, Save1);
+    }
+
+    Tmp = _mm_shuffle_epi32(State0, 0x1B);
+    State1 = _mm_shuffle_epi32(State1, 0xB1);
+
+    _mm_storeu_si128((__m128i *)&State[0], _mm_blend_epi16(Tmp, State1, 0xF0));
+    _mm_storeu_si128((__m128i *)&State[4], _mm_alignr_epi8(State1, Tmp, 8));
+}
+
+void Sha1CompressNi(uint32_t *State, const uint8_t *Blocks, size_t Count)
+{
+    const __m128i Mask = _mm_set_epi64x(0x0001020304050607ull, 0x08090A0B0C0D0E0Full);
+
+    __m128i Abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)State), 0x1B);
+    __m128i E0 = _mm_set_epi32((int)State[4], 0, 0, 0);
+
+    for (size_t b = 0; b < Count; b++, Blocks += 64)
+    {
+        __m128i SaveAbcd = Abcd;
+        __m128i SaveE = E0;
+        __m128i Prev = Abcd;
+        __m128i E = E0;
+        __m128i Msg[4];
+
+        for (int i = 0; i < 20; i++)
+        {
+            if (i < 4)
+                Msg[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)&Blocks[16 * i]), Mask);
+
+            E = (i == 0) ? _mm_add_epi32(E0, Msg[0]) : _mm_sha1nexte_epu32(Prev, Msg[i & 3]);
+
+            if ((i >= 3) && (i <= 18))
+                Msg[(i + 1) & 3] = _mm_sha1msg2_epu32(Msg[(i + 1) & 3], Msg[i & 3]);
+
+            Prev = Abcd;
+
+            // the round function selector must be an immediate
+
+            switch (i / 5)
+                {
+            case 0:  Abcd = _mm_sha1rnds4_epu32(Abcd, E, 0); break;
+            case 1:  Abcd = _mm_sha1rnds4_epu32(Abcd, E, 1); break;
+            case 2:  Abcd = _mm_sha1rnds4_epu32(Abcd, E, 2); break;
+            default: Abcd = _mm_sha1rnds4_epu32(Abcd, E, 3); break;
+                }
+
+            if ((i >= 1) && (i <= 16))
+                Msg[(i - 1) & 3] = _mm_sha1msg1_epu32(Msg[(i - 1) & 3], Msg[i & 3]);
+
+            if ((i >= 2) && (i <= 17))
+                Msg[(i - 2) & 3] = _mm_xor_si128(Msg[(i - 2) & 3], Msg[i & 3]);
+        }
+
+        E0 = _mm_sha1nexte_epu32(Prev, SaveE);
+        Abcd = _mm_add_epi32(Abcd, SaveAbcd);
+    }
+
+    _mm_storeu_si128((__m128i *)State, _mm_shuffle_epi32(Abcd, 0x1B));
+    State[4] = _mm_extract_epi32(E0, 3);
+}
+
+// ----------------------------------------------------------------------------
+// The accelerated kernels.
+// ----------------------------------------------------------------------------
+
+void KernelAesCtr128(const uint8_t *In, uint8_t *Out, size_t Bytes) { AesNiCtr(0, In, Out, Bytes); }
+void KernelAesCtr256(const uint8_t *In, uint8_t *Out, size_t Bytes) { VaesCtr256(0, In, Out, Bytes); }
+void KernelAesCtr512(const uint8_t *In, uint8_t *Out, size_t Bytes) { VaesCtr512(0, In, Out, Bytes); }
+
+void KernelGhash128(const uint8_t *In, uint8_t *Out, size_t Bytes) { (void)Out; memset(Digest, 0, 16); GhashClmul(Digest, In, Bytes); }
+void KernelGhash256(const uint8_t *In, uint8_t *Out, size_t Bytes) { (void)Out; memset(Digest, 0, 16); GhashVpclmul256(Digest, In, Bytes); }
+void KernelGhash512(const uint8_t *In, uint8_t *Out, size_t Bytes) { (void)Out; memset(Digest, 0, 16); GhashVpclmul512(Digest, In, Bytes); }
+
+//
+// GCM encrypts and authenticates in chunks that stay in the L1, as real
+// implementations do, rather than making two passes over the whole buffer.
+//
+
+typedef void (CTR_FUNC)(uint64_t Counter, const uint8_t *In, uint8_t *Out, size_t Bytes);
+typedef void (GHASH_FUNC)(uint8_t State[16], const uint8_t *In, size_t Bytes);
+
+void Gcm(CTR_FUNC *Ctr, GHASH_FUNC *Ghash, const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    memset(Digest, 0, 16);
+
+    for (size_t i = 0; i < Bytes; i += GCM_CHUNK)
+    {
+        size_t n = min(GCM_CHUNK, Bytes - i);
+
+        (*Ctr)(i / 16, In + i, Out + i, n);
+        (*Ghash)(Digest, Out + i, n);
+    }
+}
+
+void KernelGcm128(const uint8_t *In, uint8_t *Out, size_t Bytes) { Gcm(AesNiCtr,   GhashClmul,      In, Out, Bytes); }
+void KernelGcm256(const uint8_t *In, uint8_t *Out, size_t Bytes) { Gcm(VaesCtr256, GhashVpclmul256, In, Out, Bytes); }
+void KernelGcm512(const uint8_t *In, uint8_t *Out, size_t Bytes) { Gcm(VaesCtr512, GhashVpclmul512, In, Out, Bytes); }
+
+void KernelSha1Ni(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    (void)Out;
+    ShaHash(Sha1CompressNi, Sha1Initial, 5, In, Bytes);
+}
+
+void KernelSha256Ni(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    (void)Out;
+    ShaHash(Sha256CompressNi, Sha256Initial, 8, In, Bytes);
+}
+
+void KernelGf128(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    __m128i k = _mm_set1_epi8(GF_CONSTANT);
+    size_t i = 0;
+
+    for (; i + 16 <= Bytes; i += 16)
+        _mm_storeu_si128((__m128i *)&Out[i], _mm_gf2p8mul_epi8(_mm_loadu_si128((const __m128i *)&In[i]), k));
+
+    KernelGfC(In + i, Out + i, Bytes - i);
+}
+
+void KernelGf256(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    __m256i k = _mm256_set1_epi8(GF_CONSTANT);
+    size_t i = 0;
+
+    for (; i + 32 <= Bytes; i += 32)
+        _mm256_storeu_si256((__m256i *)&Out[i], _mm256_gf2p8mul_epi8(_mm256_loadu_si256((const __m256i *)&In[i]), k));
+
+    KernelGfC(In + i, Out + i, Bytes - i);
+}
+
+void KernelGf512(const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    __m512i k = _mm512_set1_epi8(GF_CONSTANT);
+    size_t i = 0;
+
+    for (; i + 64 <= Bytes; i += 64)
+        _mm512_storeu_si512((__m512i *)&Out[i], _mm512_gf2p8mul_epi8(_mm512_loadu_si512((const __m512i *)&In[i]), k));
+
+    KernelGfC(In + i, Out + i, Bytes - i);
+}
+
+// ----------------------------------------------------------------------------
+// Feature checks, including OS support for the YMM and ZMM state.
+// ----------------------------------------------------------------------------
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool HasPCLMUL()   { return LookUpRegBit(1, 0, CPUID_ECX,  1); }
+bool HasSSE41()    { return LookUpRegBit(1, 0, CPUID_ECX, 19); }
+bool HasAES()      { return LookUpRegBit(1, 0, CPUID_ECX, 25); }
+bool HasOSXSAVE()  { return LookUpRegBit(1, 0, CPUID_ECX, 27); }
+bool HasAVX2()     { return LookUpRegBit(7, 0, CPUID_EBX,  5); }
+bool HasAVX512F()  { return LookUpRegBit(7, 0, CPUID_EBX, 16); }
+bool HasAVX512BW() { return LookUpRegBit(7, 0, CPUID_EBX, 30); }
+bool HasSHANI()    { return LookUpRegBit(7, 0, CPUID_EBX, 29); }
+bool HasGFNI()     { return LookUpRegBit(7, 0, CPUID_ECX,  8); }
+bool HasVAES()     { return LookUpRegBit(7, 0, CPUID_ECX,  9); }
+bool HasVPCLMUL()  { return LookUpRegBit(7, 0, CPUID_ECX, 10); }
+
+bool HasXCR0YMM()  { return HasOSXSAVE() && ((_xgetbv(0) & 0x06) == 0x06); }
+bool HasXCR0ZMM()  { return HasOSXSAVE() && ((_xgetbv(0) & 0xE6) == 0xE6); }
+
+bool HasYMM()      { return HasXCR0YMM() && HasAVX2(); }
+bool HasZMM()      { return HasXCR0ZMM() && HasAVX512F() && HasAVX512BW(); }
+
+bool HasAes128()   { return HasAES() && HasSSE41(); }
+bool HasAes256()   { return HasAes128() && HasVAES() && HasYMM(); }
+bool HasAes512()   { return HasAes128() && HasVAES() && HasZMM(); }
+bool HasGhash128() { return HasPCLMUL() && HasSSE41(); }
+bool HasGhash256() { return HasGhash128() && HasVPCLMUL() && HasYMM(); }
+bool HasGhash512() { return HasGhash128() && HasVPCLMUL() && HasZMM(); }
+bool HasGcm128()   { return HasAes128() && HasGhash128(); }
+bool HasGcm256()   { return HasAes256() && HasGhash256(); }
+bool HasGcm512()   { return HasAes512() && HasGhash512(); }
+bool HasShaNi()    { return HasSHANI() && HasSSE41(); }
+bool HasGf128()    { return HasGFNI() && HasSSE41(); }
+bool HasGf256()    { return HasGFNI() && HasYMM(); }
+bool HasGf512()    { return HasGFNI() && HasZMM(); }
+
+#endif // HAS_X86_CRYPTO
+
+bool HasPortable() { return true; }
+
+typedef struct KERNEL_INFO
+{
+    const char *Name;
+    const char *Width;
+    const char *Extension;
+    KERNEL     *Kernel;
+    KERNEL     *Reference;
+    bool      (*IsPresent)(void);
+} KERNEL_INFO;
+
+const KERNEL_INFO Kernels[] =
+{
+    { "AES-128-CTR", "C",   "T-tables",      KernelAesCtrC,   KernelAesCtrC,  HasPortable },
+#if HAS_X86_CRYPTO
+    { "AES-128-CTR", "128", "AES-NI",        KernelAesCtr128, KernelAesCtrC,  HasAes128   },
+    { "AES-128-CTR", "256", "VAES",          KernelAesCtr256, KernelAesCtrC,  HasAes256   },
+    { "AES-128-CTR", "512", "VAES",          KernelAesCtr512, KernelAesCtrC,  HasAes512   },
+#endif
+    { "GHASH",       "C",   "4-bit tables",  KernelGhashC,    KernelGhashC,   HasPortable },
+#if HAS_X86_CRYPTO
+    { "GHASH",       "128", "PCLMUL",        KernelGhash128,  KernelGhashC,   HasGhash128 },
+    { "GHASH",       "256", "VPCLMUL",       KernelGhash256,  KernelGhashC,   HasGhash256 },
+    { "GHASH",       "512", "VPCLMUL",       KernelGhash512,  KernelGhashC,   HasGhash512 },
+#endif
+    { "AES-128-GCM", "C",   "tables",        KernelGcmC,      KernelGcmC,     HasPortable },
+#if HAS_X86_CRYPTO
+    { "AES-128-GCM", "128", "AES-NI+PCLMUL", KernelGcm128,    KernelGcmC,     HasGcm128   },
+    { "AES-128-GCM", "256", "VAES+VPCLMUL",  KernelGcm256,    KernelGcmC,     HasGcm256   },
+    { "AES-128-GCM", "512", "VAES+VPCLMUL",  KernelGcm512,    KernelGcmC,     HasGcm512   },
+#endif
+    { "SHA-1",       "C",   "portable",      KernelSha1C,     KernelSha1C,    HasPortable },
+#if HAS_X86_CRYPTO
+    { "SHA-1",       "128", "SHA-NI",        KernelSha1Ni,    KernelSha1C,    HasShaNi    },
+#endif
+    { "SHA-256",     "C",   "portable",      KernelSha256C,   KernelSha256C,  HasPortable },
+#if HAS_X86_CRYPTO
+    { "SHA-256",     "128", "SHA-NI",        KernelSha256Ni,  KernelSha256C,  HasShaNi    },
+#endif
+    { "GF(2^8) mul", "C",   "table",         KernelGfC,       KernelGfC,      HasPortable },
+#if HAS_X86_CRYPTO
+    { "GF(2^8) mul", "128", "GFNI",          KernelGf128,     KernelGfC,      HasGf128    },
+    { "GF(2^8) mul", "256", "GFNI+AVX",      KernelGf256,     KernelGfC,      HasGf256    },
+    { "GF(2^8) mul", "512", "GFNI+AVX512",   KernelGf512,     KernelGfC,      HasGf512    },
+#endif
+};
+
+#define KERNELS (sizeof(Kernels) / sizeof(Kernels[0]))
+
+//
+// Run a kernel and its portable reference on the same input and compare
+// both the output buffer and the digest.
+//
+
+bool CheckKernel(const KERNEL_INFO *Info, const uint8_t *In, uint8_t *Out, uint8_t *RefOut)
+{
+    uint8_t RefDigest[32];
+
+    memset(RefOut, 0, CHECK_BYTES);
+    memset(Digest, 0, sizeof(Digest));
+    (*Info->Reference)(In, RefOut, CHECK_BYTES);
+    memcpy(RefDigest, Digest, sizeof(Digest));
+
+    memset(Out, 0, CHECK_BYTES);
+    memset(Digest, 0, sizeof(Digest));
+    (*Info->Kernel)(In, Out, CHECK_BYTES);
+
+    return !memcmp(Out, RefOut, CHECK_BYTES) && !memcmp(Digest, RefDigest, sizeof(Digest));
+}
+
+double TscTicksPerUs = 0.0;
+
+double CalibrateTscPerUs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Us = (double)(Stop.QuadPart - Start.QuadPart) * 1e6 / (double)Freq.QuadPart;
+
+    return (double)(TscStop - TscStart) / Us;
+}
+
+//
+// Bytes per TSC tick for one kernel at one buffer size, after one warm-up call.
+//
+
+double MeasureKernel(KERNEL *Kernel, const uint8_t *In, uint8_t *Out, size_t Bytes)
+{
+    size_t Reps = max(1, TARGET_BYTES / Bytes);
+
+    (*Kernel)(In, Out, Bytes);
+
+    uint64_t Start = __rdtsc();
+
+    for (size_t r = 0; r < Reps; r++)
+        (*Kernel)(In, Out, Bytes);
+
+    uint64_t Ticks = __rdtsc() - Start;
+
+    return (double)Bytes * Reps / (double)Ticks;
+}
+
+int __cdecl main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else
+        {
+            printf("Usage: crypto [-csv]\n");
+            return 1;
+        }
+    }
+
+    uint8_t *In = (uint8_t *)VirtualAlloc(NULL, MAX_BYTES, MEM_COMMIT, PAGE_READWRITE);
+    uint8_t *Out = (uint8_t *)VirtualAlloc(NULL, MAX_BYTES, MEM_COMMIT, PAGE_READWRITE);
+    uint8_t *RefOut = (uint8_t *)VirtualAlloc(NULL, CHECK_BYTES, MEM_COMMIT, PAGE_READWRITE);
+
+    if ((In == NULL) || (Out == NULL) || (RefOut == NULL))
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    for (size_t i = 0; i < MAX_BYTES; i++)
+        In[i] = (uint8_t)(i * 131 + (i >> 8));
+
+    // the FIPS-197 example key
+
+    static const uint8_t Key[16] = { 0x2B, 0x7E, 0x15, 0x16, 0x28, 0xAE, 0xD2, 0xA6, 0xAB, 0xF7, 0x15, 0x88, 0x09, 0xCF, 0x4F, 0x3C };
+    static const uint8_t Zero[16] = { 0 };
+
+    BuildAesTables();
+    ExpandAesKey(Key);
+    AesEncryptBlockTable(Zero, HashKey);
+    BuildGhashTables();
+    BuildGfTable();
+
+#if HAS_X86_CRYPTO
+    if (HasGhash128())
+        BuildHashPowers();
+#endif
+
+    TscTicksPerUs = CalibrateTscPerUs();
+
+    if (!CsvOutput)
+    {
+        printf("\nCrypto kernel throughput in bytes per TSC tick (TSC at %.0f MHz).\n\n", TscTicksPerUs);
+        printf("%-12s %-5s %-14s %-8s", "kernel", "width", "extension", "check");
+
+        for (size_t Bytes = MIN_BYTES; Bytes <= MAX_BYTES; Bytes *= 4)
+        {
+            char Label[16];
+
+            if (Bytes >= 1024 * 1024)
+                sprintf_s(Label, sizeof(Label), "%uM", (uint32_t)(Bytes >> 20));
+            else if (Bytes >= 1024)
+                sprintf_s(Label, sizeof(Label), "%uK", (uint32_t)(Bytes >> 10));
+            else
+                sprintf_s(Label, sizeof(Label), "%u", (uint32_t)Bytes);
+
+            printf(" %7s", Label);
+        }
+
+        printf("\n");
+    }
+
+    uint32_t Mismatches = 0;
+
+    for (uint32_t k = 0; k < KERNELS; k++)
+    {
+        const KERNEL_INFO *Info = &Kernels[k];
+
+        if (!(*Info->IsPresent)())
+        {
+            if (!CsvOutput)
+                printf("%-12s %-5s %-14s %-8s\n", Info->Name, Info->Width, Info->Extension, "absent");
+
+            continue;
+        }
+
+        bool Matches = CheckKernel(Info, In, Out, RefOut);
+
+        if (!Matches)
+            Mismatches++;
+
+        if (!CsvOutput)
+            printf("%-12s %-5s %-14s %-8s", Info->Name, Info->Width, Info->Extension, Matches ? "ok" : "MISMATCH");
+
+        for (size_t Bytes = MIN_BYTES; Bytes <= MAX_BYTES; Bytes *= 4)
+        {
+            double BytesPerTick = MeasureKernel(Info->Kernel, In, Out, Bytes);
+
+            if (CsvOutput)
+                printf("%s,%s,%u,%.4f,%.1f\n", Info->Name, Info->Width, (uint32_t)Bytes, BytesPerTick, BytesPerTick * TscTicksPerUs);
+            else
+                printf(" %7.3f", BytesPerTick);
+        }
+
+        if (!CsvOutput)
+            printf("\n");
+    }
+
+    if (Mismatches && !CsvOutput)
+        printf("\nWarning: %u accelerated kernels do not match the portable result\n", Mismatches);
+
+    VirtualFree(In, 0, MEM_RELEASE);
+    VirtualFree(Out, 0, MEM_RELEASE);
+    VirtualFree(RefOut, 0, MEM_RELEASE);
+
+    return Mismatches;
+}
+
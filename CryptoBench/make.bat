@@ -0,0 +1,29 @@
+echo on
+
+@rem Builds 32-bit and 64-bit versions of the crypto acceleration probe for x86 and x64.
+@rem Run the Visual Studio vcvars32.bat _or_ vcvars64.bat / vcvarsamd64_arm64.bat scripts ahead of time.
+
+@if "%VSCMD_ARG_TGT_ARCH%" == "" (
+    echo Visual Studio build environment not initialized.
+    echo Make sure to run vcvars32.bat vcvars64.bat or vcvarsamd64_arm64.bat
+    goto end
+    )
+
+@if "%VSCMD_ARG_TGT_ARCH%" == "x64" (
+    cl -Zi -W4 -FAsc -O2 -Oi -Ob2          crypto.c -link -release -debug -incremental:no -out:crypto_x64.exe      -nodefaultlib ucrt.lib vcruntime.lib libcmt.lib mincore.lib
+    move /y crypto.cod crypto_x64.cod
+    goto end
+    )
+
+@if "%VSCMD_ARG_TGT_ARCH%" == "x86" (
+    cl -Zi -W4 -FAsc -O2 -Oi -Ob2          crypto.c -link -release -debug -incremental:no -out:crypto_x86.exe      -nodefaultlib ucrt.lib vcruntime.lib libcmt.lib mincore.lib msvcrt.lib
+    move /y crypto.cod crypto_x86.cod
+    goto end
+    )
+
+@rem the kernels use x86 intrinsics, run the x64 build to test the emulator on ARM64
+
+@echo Only x86 and x64 builds are supported.
+
+:end
+
@@ -0,0 +1,439 @@
+
+//
+// FAULTPROBE.C
+//
+// Fault-based feature probing with measured trap latency.
+//
+// CPUID only says what the CPU (or the hypervisor, or the emulator) claims.
+// This executes each candidate instruction for real under a vectored
+// exception handler and records whether it ran or faulted, which exception
+// was raised, and how long the fault round trip took.  The handler is
+// installed once for the whole batch of probes and skips over a faulting
+// candidate instruction so that execution resumes inside the probe.
+//
+// The verdict column compares the result with the CPUID bit:
+//
+//   ok            advertised and executes
+//   absent        not advertised and faults
+//   HIDDEN        advertised but faults (masked by OS, microcode, or broken emulation)
+//   UNADVERTISED  executes even though the CPUID bit is clear (masked leaf)
+//
+// Note that some encodings never fault on older CPUs: LZCNT executes as BSR
+// and PREFETCHW as a NOP, so UNADVERTISED is expected for those two there.
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define SLOT_BYTES    (64)
+#define MAX_PROBES    (64)
+#define REPEATS       (201)
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+//
+// Minimal CPUID bit lookups, with the same range check as CPUIDEX.C so that
+// leaves beyond the maximum do not return another leaf's data.
+//
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool HasTSC()      { return LookUpRegBit(1, 0, CPUID_EDX,  4); }
+bool HasCLFLUSH()  { return LookUpRegBit(1, 0, CPUID_EDX, 19); }
+bool HasPCLMUL()   { return LookUpRegBit(1, 0, CPUID_ECX,  1); }
+bool HasSSSE3()    { return LookUpRegBit(1, 0, CPUID_ECX,  9); }
+bool HasFMA()      { return LookUpRegBit(1, 0, CPUID_ECX, 12); }
+bool HasSSE41()    { return LookUpRegBit(1, 0, CPUID_ECX, 19); }
+bool HasSSE42()    { return LookUpRegBit(1, 0, CPUID_ECX, 20); }
+bool HasMOVBE()    { return LookUpRegBit(1, 0, CPUID_ECX, 22); }
+bool HasPOPCNT()   { return LookUpRegBit(1, 0, CPUID_ECX, 23); }
+bool HasAES()      { return LookUpRegBit(1, 0, CPUID_ECX, 25); }
+bool HasOSXSAVE()  { return LookUpRegBit(1, 0, CPUID_ECX, 27); }
+bool HasAVX()      { return LookUpRegBit(1, 0, CPUID_ECX, 28); }
+bool HasF16C()     { return LookUpRegBit(1, 0, CPUID_ECX, 29); }
+bool HasRDRAND()   { return LookUpRegBit(1, 0, CPUID_ECX, 30); }
+
+bool HasLAHF64()   { return LookUpRegBit(0x80000001, 0, CPUID_ECX,  0); }
+bool HasABM()      { return LookUpRegBit(0x80000001, 0, CPUID_ECX,  5); }
+bool Has3DPREF()   { return LookUpRegBit(0x80000001, 0, CPUID_ECX,  8); }
+bool HasRDTSCP()   { return LookUpRegBit(0x80000001, 0, CPUID_EDX, 27); }
+bool Has3DNOW()    { return LookUpRegBit(0x80000001, 0, CPUID_EDX, 31); }
+
+bool HasFSGSBASE() { return LookUpRegBit(7, 0, CPUID_EBX,  0); }
+bool HasBMI1()     { return LookUpRegBit(7, 0, CPUID_EBX,  3); }
+bool HasHLE()      { return LookUpRegBit(7, 0, CPUID_EBX,  4); }
+bool HasAVX2()     { return LookUpRegBit(7, 0, CPUID_EBX,  5); }
+bool HasBMI2()     { return LookUpRegBit(7, 0, CPUID_EBX,  8); }
+bool HasRTM()      { return LookUpRegBit(7, 0, CPUID_EBX, 11); }
+bool HasAVX512F()  { return LookUpRegBit(7, 0, CPUID_EBX, 16); }
+bool HasRDSEED()   { return LookUpRegBit(7, 0, CPUID_EBX, 18); }
+bool HasADX()      { return LookUpRegBit(7, 0, CPUID_EBX, 19); }
+bool HasRDPID()    { return LookUpRegBit(7, 0, CPUID_ECX, 22); }
+bool HasCLFLSHOP() { return LookUpRegBit(7, 0, CPUID_EBX, 23); }
+bool HasCLWB()     { return LookUpRegBit(7, 0, CPUID_EBX, 24); }
+bool HasSHANI()    { return LookUpRegBit(7, 0, CPUID_EBX, 29); }
+
+bool HasWAITPKG()  { return LookUpRegBit(7, 0, CPUID_ECX,  5); }
+bool HasGFNI()     { return LookUpRegBit(7, 0, CPUID_ECX,  8); }
+bool HasSERIALIZE(){ return LookUpRegBit(7, 0, CPUID_EDX, 14); }
+bool HasAVXVNNI()  { return LookUpRegBit(7, 1, CPUID_EAX,  4); }
+
+bool HasTSX()      { return HasRTM() || HasHLE(); }
+
+//
+// Each probe is Prefix + Insn + Suffix + RET.  Only Insn is expected to fault.
+// Prefix and Suffix set up operands and restore non-volatile registers, and
+// may only touch registers that are volatile in both the x86 and x64 ABIs.
+//
+
+#define BYTES(S)  (const uint8_t *)(S), (sizeof(S) - 1)
+
+typedef struct PROBE
+{
+    const char    *Name;
+    bool         (*Has)();          // CPUID claim, or NULL if there is no bit
+    const uint8_t *Prefix;
+    uint32_t       PrefixLength;
+    const uint8_t *Insn;
+    uint32_t       InsnLength;
+    const uint8_t *Suffix;
+    uint32_t       SuffixLength;
+    bool           X64Only;
+} PROBE;
+
+#define VZEROUPPER "\xC5\xF8\x77"
+
+const PROBE Probes[] =
+{
+    // calibration: a probe that never faults, and one that always does
+
+    { "NOP",         NULL,        BYTES(""),                 BYTES("\x90"),                     BYTES(""),         false },
+    { "UD2",         NULL,        BYTES(""),                 BYTES("\x0F\x0B"),                 BYTES(""),         false },
+    { "INT3",        NULL,        BYTES(""),                 BYTES("\xCC"),                     BYTES(""),         false },
+
+    // privileged or OS controlled
+
+    { "HLT",         NULL,        BYTES(""),                 BYTES("\xF4"),                     BYTES(""),         false },
+    { "RDMSR",       NULL,        BYTES("\x31\xC9"),         BYTES("\x0F\x32"),                 BYTES(""),         false },
+    { "RDPMC",       NULL,        BYTES("\x31\xC9"),         BYTES("\x0F\x33"),                 BYTES(""),         false },
+    { "SMSW (UMIP)", NULL,        BYTES(""),                 BYTES("\x0F\x01\xE0"),             BYTES(""),         false },
+    { "CPUID",       NULL,        BYTES("\x53\x31\xC0\x31\xC9"), BYTES("\x0F\xA2"),             BYTES("\x5B"),     false },
+    { "RDTSC",       HasTSC,      BYTES(""),                 BYTES("\x0F\x31"),                 BYTES(""),         false },
+    { "RDTSCP",      HasRDTSCP,   BYTES(""),                 BYTES("\x0F\x01\xF9"),             BYTES(""),         false },
+    { "RDPID",       HasRDPID,    BYTES(""),                 BYTES("\xF3\x0F\xC7\xF8"),         BYTES(""),         false },
+    { "RDFSBASE",    HasFSGSBASE, BYTES(""),                 BYTES("\xF3\x0F\xAE\xC0"),         BYTES(""),         true  },
+    { "XGETBV",      HasOSXSAVE,  BYTES("\x31\xC9"),         BYTES("\x0F\x01\xD0"),             BYTES(""),         false },
+    { "XTEST",       HasTSX,      BYTES(""),                 BYTES("\x0F\x01\xD6"),             BYTES(""),         false },
+    { "SERIALIZE",   HasSERIALIZE,BYTES(""),                 BYTES("\x0F\x01\xE8"),             BYTES(""),         false },
+    { "TPAUSE",      HasWAITPKG,  BYTES("\x31\xC0\x31\xD2\x31\xC9"), BYTES("\x66\x0F\xAE\xF1"), BYTES(""),         false },
+
+    // integer and bit manipulation
+
+    { "LAHF",        HasLAHF64,   BYTES(""),                 BYTES("\x9F"),                     BYTES(""),         true  },
+    { "POPCNT",      HasPOPCNT,   BYTES(""),                 BYTES("\xF3\x0F\xB8\xC1"),         BYTES(""),         false },
+    { "LZCNT",       HasABM,      BYTES(""),                 BYTES("\xF3\x0F\xBD\xC1"),         BYTES(""),         false },
+    { "MOVBE",       HasMOVBE,    BYTES(""),                 BYTES("\x0F\x38\xF0\x04\x24"),     BYTES(""),         false },
+    { "CRC32",       HasSSE42,    BYTES(""),                 BYTES("\xF2\x0F\x38\xF1\xC1"),     BYTES(""),         false },
+    { "ANDN",        HasBMI1,     BYTES(""),                 BYTES("\xC4\xE2\x70\xF2\xC2"),     BYTES(""),         false },
+    { "SHLX",        HasBMI2,     BYTES(""),                 BYTES("\xC4\xE2\x69\xF7\xC1"),     BYTES(""),         false },
+    { "ADCX",        HasADX,      BYTES(""),                 BYTES("\x66\x0F\x38\xF6\xC1"),     BYTES(""),         false },
+    { "RDRAND",      HasRDRAND,   BYTES(""),                 BYTES("\x0F\xC7\xF0"),             BYTES(""),         false },
+    { "RDSEED",      HasRDSEED,   BYTES(""),                 BYTES("\x0F\xC7\xF8"),             BYTES(""),         false },
+
+    // cache control, all operating on the stack line which they do not modify
+
+    { "CLFLUSH",     HasCLFLUSH,  BYTES(""),                 BYTES("\x0F\xAE\x3C\x24"),         BYTES(""),         false },
+    { "CLFLUSHOPT",  HasCLFLSHOP, BYTES(""),                 BYTES("\x66\x0F\xAE\x3C\x24"),     BYTES(""),         false },
+    { "CLWB",        HasCLWB,     BYTES(""),                 BYTES("\x66\x0F\xAE\x34\x24"),     BYTES(""),         false },
+    { "PREFETCHW",   Has3DPREF,   BYTES(""),                 BYTES("\x0F\x0D\x0C\x24"),         BYTES(""),         false },
+    { "FEMMS",       Has3DNOW,    BYTES(""),                 BYTES("\x0F\x0E"),                 BYTES(""),         false },
+
+    // SIMD and crypto
+
+    { "PSHUFB",      HasSSSE3,    BYTES(""),                 BYTES("\x66\x0F\x38\x00\xC1"),     BYTES(""),         false },
+    { "PTEST",       HasSSE41,    BYTES(""),                 BYTES("\x66\x0F\x38\x17\xC0"),     BYTES(""),         false },
+    { "AESENC",      HasAES,      BYTES(""),                 BYTES("\x66\x0F\x38\xDC\xC1"),     BYTES(""),         false },
+    { "PCLMULQDQ",   HasPCLMUL,   BYTES(""),                 BYTES("\x66\x0F\x3A\x44\xC1\x00"), BYTES(""),         false },
+    { "SHA1NEXTE",   HasSHANI,    BYTES(""),                 BYTES("\x0F\x38\xC8\xC1"),         BYTES(""),         false },
+    { "GF2P8MULB",   HasGFNI,     BYTES(""),                 BYTES("\x66\x0F\x38\xCF\xC1"),     BYTES(""),         false },
+    { "VZEROUPPER",  HasAVX,      BYTES(""),                 BYTES(VZEROUPPER),                 BYTES(""),         false },
+    { "VCVTPH2PS",   HasF16C,     BYTES(""),                 BYTES("\xC4\xE2\x79\x13\xC1"),     BYTES(""),         false },
+    { "VFMADD231PS", HasFMA,      BYTES(""),                 BYTES("\xC4\xE2\x71\xB8\xC2"),     BYTES(""),         false },
+    { "VPADDD ymm",  HasAVX2,     BYTES(""),                 BYTES("\xC5\xFD\xFE\xC0"),         BYTES(VZEROUPPER), false },
+    { "VPDPBUSD ymm",HasAVXVNNI,  BYTES(""),                 BYTES("\xC4\xE2\x7D\x50\xC0"),     BYTES(VZEROUPPER), false },
+    { "VPADDD zmm",  HasAVX512F,  BYTES(""),                 BYTES("\x62\xF1\x7D\x48\xFE\xC0"), BYTES(VZEROUPPER), false },
+};
+
+#define PROBE_COUNT (sizeof(Probes) / sizeof(Probes[0]))
+
+typedef void (PROBEFN)(void);
+
+//
+// State shared with the vectored exception handler.
+//
+
+uint8_t *ProbeCode = NULL;
+
+volatile uint8_t *CurrentInsn = NULL;
+volatile uint32_t CurrentInsnLength = 0;
+volatile uint8_t *CurrentRet = NULL;
+volatile DWORD CurrentException = 0;
+
+LONG WINAPI ProbeHandler(EXCEPTION_POINTERS *Info)
+{
+    uint8_t *Address = (uint8_t *)Info->ExceptionRecord->ExceptionAddress;
+
+    if ((Address < ProbeCode) || (Address >= ProbeCode + MAX_PROBES * SLOT_BYTES))
+        return EXCEPTION_CONTINUE_SEARCH;
+
+    if (CurrentException == 0)
+        CurrentException = Info->ExceptionRecord->ExceptionCode;
+
+    // skip the candidate instruction, or abandon the rest of the probe
+    // if something else faulted (such as a VZEROUPPER in the suffix)
+
+    volatile uint8_t *Resume = (Address == CurrentInsn) ? CurrentInsn + CurrentInsnLength : CurrentRet;
+
+#if _M_IX86
+    Info->ContextRecord->Eip = (DWORD)(ULONG_PTR)Resume;
+#else
+    Info->ContextRecord->Rip = (DWORD64)(ULONG_PTR)Resume;
+#endif
+
+    return EXCEPTION_CONTINUE_EXECUTION;
+}
+
+uint8_t *EmitProbe(uint8_t *Slot, const PROBE *Probe)
+{
+    uint8_t *Code = Slot;
+
+    memcpy(Code, Probe->Prefix, Probe->PrefixLength);
+    Code += Probe->PrefixLength;
+
+    memcpy(Code, Probe->Insn, Probe->InsnLength);
+    Code += Probe->InsnLength;
+
+    memcpy(Code, Probe->Suffix, Probe->SuffixLength);
+    Code += Probe->SuffixLength;
+
+    *Code = 0xC3;                                           // RET
+
+    return Slot + Probe->PrefixLength;
+}
+
+const char *ExceptionName(DWORD Code)
+{
+    switch (Code)
+        {
+    case 0:                             return "-";
+    case STATUS_ILLEGAL_INSTRUCTION:    return "#UD";
+    case STATUS_PRIVILEGED_INSTRUCTION: return "#GP priv";
+    case STATUS_ACCESS_VIOLATION:       return "#GP/#PF";
+    case STATUS_BREAKPOINT:             return "#BP";
+    default:                            return "other";
+        }
+}
+
+int CompareU64(const void *A, const void *B)
+{
+    uint64_t X = *(const uint64_t *)A;
+    uint64_t Y = *(const uint64_t *)B;
+
+    return (X > Y) - (X < Y);
+}
+
+double CalibrateTscPerUs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+
+    QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 20));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Us = (double)(Stop.QuadPart - Start.QuadPart) * 1e6 / (double)Freq.QuadPart;
+    return (double)(TscStop - TscStart) / Us;
+}
+
+int __cdecl main()
+{
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+    double TscPerUs = CalibrateTscPerUs();
+
+    ProbeCode = (uint8_t *)VirtualAlloc(NULL, MAX_PROBES * SLOT_BYTES, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+
+    if (ProbeCode == NULL)
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    uint8_t *InsnAddress[MAX_PROBES];
+
+    for (uint32_t i = 0; i < PROBE_COUNT; i++)
+        InsnAddress[i] = EmitProbe(ProbeCode + i * SLOT_BYTES, &Probes[i]);
+
+    FlushInstructionCache(GetCurrentProcess(), ProbeCode, MAX_PROBES * SLOT_BYTES);
+
+    // cost of installing and removing the handler, for comparison with per-probe installation
+
+    uint64_t InstallStart = __rdtsc();
+
+    for (uint32_t i = 0; i < 1000; i++)
+        RemoveVectoredExceptionHandler(AddVectoredExceptionHandler(1, ProbeHandler));
+
+    uint64_t InstallTicks = (__rdtsc() - InstallStart) / 1000;
+
+    // one handler installation for the whole batch
+
+    PVOID Handler = AddVectoredExceptionHandler(1, ProbeHandler);
+
+    if (Handler == NULL)
+    {
+        printf("AddVectoredExceptionHandler failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    static uint64_t Ticks[MAX_PROBES][REPEATS];
+    DWORD Exceptions[MAX_PROBES] = { 0 };
+    uint64_t Median[MAX_PROBES] = { 0 };
+
+    uint64_t BatchStart = __rdtsc();
+
+    for (uint32_t i = 0; i < PROBE_COUNT; i++)
+    {
+#if _M_IX86
+        if (Probes[i].X64Only)
+            continue;
+#endif
+
+        PROBEFN *pfn = (PROBEFN *)(void *)(ProbeCode + i * SLOT_BYTES);
+
+        CurrentInsn = InsnAddress[i];
+        CurrentInsnLength = Probes[i].InsnLength;
+        CurrentRet = InsnAddress[i] + Probes[i].InsnLength + Probes[i].SuffixLength;
+
+        for (uint32_t r = 0; r < REPEATS; r++)
+        {
+            CurrentException = 0;
+
+            uint64_t Start = __rdtsc();
+            (*pfn)();
+            Ticks[i][r] = __rdtsc() - Start;
+
+            if (r == 0)
+                Exceptions[i] = CurrentException;
+        }
+
+        qsort(Ticks[i], REPEATS, sizeof(uint64_t), CompareU64);
+        Median[i] = Ticks[i][REPEATS / 2];
+    }
+
+    uint64_t BatchTicks = __rdtsc() - BatchStart;
+
+    RemoveVectoredExceptionHandler(Handler);
+
+    // the NOP probe is the baseline cost of the call itself
+
+    uint64_t Baseline = Median[0];
+
+    printf("\n%-14s %-6s %-10s %10s %10s %10s  %s\n",
+        "instruction", "cpuid", "exception", "median", "trap", "trap us", "verdict");
+
+    uint32_t Mismatches = 0;
+
+    for (uint32_t i = 0; i < PROBE_COUNT; i++)
+    {
+        const PROBE *Probe = &Probes[i];
+
+#if _M_IX86
+        if (Probe->X64Only)
+            continue;
+#endif
+
+        bool Claimed = Probe->Has ? Probe->Has() : false;
+        bool Faulted = Exceptions[i] != 0;
+        const char *Verdict;
+
+        if (Probe->Has == NULL)
+            Verdict = Faulted ? "faults" : "executes";
+        else if (Claimed && !Faulted)
+            Verdict = "ok";
+        else if (!Claimed && Faulted)
+            Verdict = "absent";
+        else if (Claimed)
+            Verdict = "HIDDEN";
+        else
+            Verdict = "UNADVERTISED";
+
+        if (Probe->Has && (Claimed == Faulted))
+            Mismatches++;
+
+        uint64_t Trap = (Faulted && (Median[i] > Baseline)) ? Median[i] - Baseline : 0;
+
+        printf("%-14s %-6s %-10s %10llu %10llu %10.2f  %s\n",
+            Probe->Name,
+            Probe->Has ? (Claimed ? "yes" : "no") : "n/a",
+            ExceptionName(Exceptions[i]),
+            Median[i],
+            Trap,
+            Trap / TscPerUs,
+            Verdict);
+    }
+
+    printf("\nTimes are median TSC ticks of %u runs, trap = median minus the NOP probe.\n", REPEATS);
+    printf("TSC ticks per microsecond    = %10.1f\n", TscPerUs);
+    printf("Handler install + remove     = %10llu ticks\n", InstallTicks);
+    printf("Whole batch, one installation= %10llu ticks for %u probes x %u runs\n",
+        BatchTicks, (uint32_t)PROBE_COUNT, REPEATS);
+
+    if (Mismatches == 0)
+        printf("\nAll CPUID claims match actual behaviour.\n");
+    else
+        printf("\n%u CPUID claims do not match actual behaviour!\n", Mismatches);
+
+    VirtualFree(ProbeCode, 0, MEM_RELEASE);
+
+    return Mismatches;
+
+#else
+
+    printf("This probe executes x86/x64 instructions and requires a native x86 or x64 build.\n");
+    return 0;
+
+#endif
+
+}
+
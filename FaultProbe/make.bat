@@ -0,0 +1,29 @@
+echo on
+
+@rem Builds 32-bit and 64-bit versions of the fault-based feature probe for x86 and x64.
+@rem Run the Visual Studio vcvars32.bat _or_ vcvars64.bat / vcvarsamd64_arm64.bat scripts ahead of time.
+
+@if "%VSCMD_ARG_TGT_ARCH%" == "" (
+    echo Visual Studio build environment not initialized.
+    echo Make sure to run vcvars32.bat vcvars64.bat or vcvarsamd64_arm64.bat
+    goto end
+    )
+
+@if "%VSCMD_ARG_TGT_ARCH%" == "x64" (
+    cl -Zi -W4 -FAsc -O2 -Oi -Ob2          faultprobe.c -link -release -debug -incremental:no -out:faultprobe_x64.exe  -nodefaultlib ucrt.lib vcruntime.lib libcmt.lib mincore.lib
+    move /y faultprobe.cod faultprobe_x64.cod
+    goto end
+    )
+
+@if "%VSCMD_ARG_TGT_ARCH%" == "x86" (
+    cl -Zi -W4 -FAsc -O2 -Oi -Ob2          faultprobe.c -link -release -debug -incremental:no -out:faultprobe_x86.exe  -nodefaultlib ucrt.lib vcruntime.lib libcmt.lib mincore.lib msvcrt.lib
+    move /y faultprobe.cod faultprobe_x86.cod
+    goto end
+    )
+
+@rem the exception handler rewrites x86/x64 register context, so there is no ARM64 build
+
+@echo Only x86 and x64 builds are supported.
+
+:end
+
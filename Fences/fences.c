@@ -0,0 +1,394 @@
+
+//
+// FENCES.C
+//
+// Memory barrier cost probe: MFENCE, LFENCE, SFENCE, LOCK OR, SERIALIZE, CPUID.
+//
+// Lock-free code has a choice of barrier idioms for the same ordering
+// guarantee, e.g. MFENCE or a locked no-op on the stack for a full fence,
+// and their costs differ a lot between microarchitectures.  Under x86-to-
+// ARM64 emulation they differ even more, since the emulator has to map each
+// of them, and the plain stores around them, onto ARM64 barriers to keep
+// x86 TSO ordering.  This times each barrier three ways:
+//
+// - alone, back to back, which is mostly the pipeline drain,
+// - after a burst of stores to L1-resident lines, which adds the store
+//   buffer drain that a real fence has to wait for,
+// - after a store to a cache line that another thread keeps writing, where
+//   LOCK OR also targets that contended line instead of the stack.
+//
+// CPUID is included because it is the classic serializing instruction and
+// because it traps to the hypervisor in a VM.  SERIALIZE is only timed when
+// CPUID reports it.
+//
+// Usage: fences [-csv] [-contender N]
+//
+//   -csv        print machine-readable comma-separated records only
+//   -contender  logical CPU of the thread that contends for the line
+//               (default the last CPU, the measuring thread runs on CPU 0)
+//
+// The -csv records are:
+//
+//   barrier,name,alone ns,store loop ns,contended ns
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define ITERATIONS    (10000)          // barriers per round
+#define ROUNDS        (10)             // the fastest round is reported
+#define STORES        (8)              // stores ahead of each barrier in the store loop
+#define STORE_LINES   (64)             // 4 KB of private lines, stays in the L1
+#define MAX_CPUS      (256)
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+bool CsvOutput = false;
+double TscPerNs = 0.0;
+
+typedef struct CPU_ENTRY
+{
+    WORD Group;
+    BYTE Number;
+} CPU_ENTRY;
+
+CPU_ENTRY Cpus[MAX_CPUS];
+uint32_t CpuCount = 0;
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool HasSERIALIZE() { return LookUpRegBit(7, 0, CPUID_EDX, 14); }
+bool HasAlways()    { return true; }
+
+//
+// Each barrier gets three loops, generated by a macro so that the barrier
+// is inlined rather than called through a pointer.  Target is what LOCK OR
+// operates on: a stack local in the first two loops, the contended line in
+// the third.  The other barriers ignore it.
+//
+
+__declspec(align(64)) volatile uint64_t StoreLines[STORE_LINES][8];
+__declspec(align(64)) volatile LONG SharedLine[16];
+
+#define BARRIER_LOOPS(Name, Barrier)                                        \
+                                                                            \
+uint64_t Name##Alone()                                                      \
+{                                                                           \
+    volatile LONG Local = 0;                                                \
+    volatile LONG *Target = &Local;                                         \
+    int CpuInfo[4];                                                         \
+    unsigned int Aux;                                                       \
+                                                                            \
+    (void)Target; (void)CpuInfo;                                            \
+    uint64_t Start = __rdtscp(&Aux);                                        \
+                                                                            \
+    for (uint32_t i = 0; i < ITERATIONS; i++)                               \
+    {                                                                       \
+        Barrier;                                                            \
+    }                                                                       \
+                                                                            \
+    return __rdtscp(&Aux) - Start;                                          \
+}                                                                           \
+                                                                            \
+uint64_t Name##Stores()                                                     \
+{                                                                           \
+    volatile LONG Local = 0;                                                \
+    volatile LONG *Target = &Local;                                         \
+    int CpuInfo[4];                                                         \
+    unsigned int Aux;                                                       \
+                                                                            \
+    (void)Target; (void)CpuInfo;                                            \
+    uint64_t Start = __rdtscp(&Aux);                                        \
+                                                                            \
+    for (uint32_t i = 0; i < ITERATIONS; i++)                               \
+    {                                                                       \
+        for (uint32_t k = 0; k < STORES; k++)                               \
+            StoreLines[(i * STORES + k) % STORE_LINES][0] = i;              \
+                                                                            \
+        Barrier;                                                            \
+    }                                                                       \
+                                                                            \
+    return __rdtscp(&Aux) - Start;                                          \
+}                                                                           \
+                                                                            \
+uint64_t Name##Contended()                                                  \
+{                                                                           \
+    volatile LONG *Target = &SharedLine[0];                                 \
+    int CpuInfo[4];                                                         \
+    unsigned int Aux;                                                       \
+                                                                            \
+    (void)Target; (void)CpuInfo;                                            \
+    uint64_t Start = __rdtscp(&Aux);                                        \
+                                                                            \
+    for (uint32_t i = 0; i < ITERATIONS; i++)                               \
+    {                                                                       \
+        SharedLine[1] = (LONG)i;                                            \
+        Barrier;                                                            \
+    }                                                                       \
+                                                                            \
+    return __rdtscp(&Aux) - Start;                                          \
+}
+
+BARRIER_LOOPS(None,      (void)0)
+BARRIER_LOOPS(Mfence,    _mm_mfence())
+BARRIER_LOOPS(Lfence,    _mm_lfence())
+BARRIER_LOOPS(Sfence,    _mm_sfence())
+BARRIER_LOOPS(LockOr,    _InterlockedOr(Target, 0))
+BARRIER_LOOPS(Serialize, _serialize())
+BARRIER_LOOPS(Cpuid,     __cpuidex(CpuInfo, 0, 0))
+
+typedef uint64_t (LOOP)(void);
+
+typedef struct BARRIER
+{
+    const char *Name;
+    bool      (*IsPresent)(void);
+    LOOP       *Alone;
+    LOOP       *Stores;
+    LOOP       *Contended;
+} BARRIER;
+
+const BARRIER Barriers[] =
+{
+    { "none",      HasAlways,    NoneAlone,      NoneStores,      NoneContended      },
+    { "MFENCE",    HasAlways,    MfenceAlone,    MfenceStores,    MfenceContended    },
+    { "LFENCE",    HasAlways,    LfenceAlone,    LfenceStores,    LfenceContended    },
+    { "SFENCE",    HasAlways,    SfenceAlone,    SfenceStores,    SfenceContended    },
+    { "LOCK OR",   HasAlways,    LockOrAlone,    LockOrStores,    LockOrContended    },
+    { "SERIALIZE", HasSERIALIZE, SerializeAlone, SerializeStores, SerializeContended },
+    { "CPUID",     HasAlways,    CpuidAlone,     CpuidStores,     CpuidContended     },
+};
+
+#define BARRIERS (sizeof(Barriers) / sizeof(Barriers[0]))
+
+double CalibrateTscPerNs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return (double)(TscStop - TscStart) / Ns;
+}
+
+bool PinToCpu(uint32_t Index)
+{
+    GROUP_AFFINITY Affinity = { 0 };
+
+    Affinity.Group = Cpus[Index].Group;
+    Affinity.Mask = (KAFFINITY)1 << Cpus[Index].Number;
+
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+        return false;
+
+    SwitchToThread();
+    return true;
+}
+
+void EnumerateCpus()
+{
+    WORD Groups = GetActiveProcessorGroupCount();
+
+    for (WORD Group = 0; Group < Groups; Group++)
+    {
+        DWORD Count = GetActiveProcessorCount(Group);
+
+        for (DWORD Number = 0; (Number < Count) && (CpuCount < MAX_CPUS); Number++)
+        {
+            Cpus[CpuCount].Group = Group;
+            Cpus[CpuCount].Number = (BYTE)Number;
+            CpuCount++;
+        }
+    }
+}
+
+//
+// Best of ROUNDS rounds in nanoseconds per barrier, so that an interrupt
+// in one round does not count.
+//
+
+double MeasureLoop(LOOP *Loop)
+{
+    uint64_t Best = ~0ull;
+
+    (*Loop)();
+
+    for (uint32_t r = 0; r < ROUNDS; r++)
+    {
+        uint64_t Ticks = (*Loop)();
+        Best = min(Best, Ticks);
+    }
+
+    return (double)Best / TscPerNs / ITERATIONS;
+}
+
+//
+// The contending thread keeps writing the line that the measuring thread
+// stores to, so every store and every locked access has to win the line back.
+//
+
+typedef struct CONTENDER
+{
+    uint32_t       Index;
+    volatile LONG *Stop;
+    volatile LONG *Running;
+} CONTENDER;
+
+DWORD WINAPI ContenderProc(LPVOID Param)
+{
+    CONTENDER *Contender = (CONTENDER *)Param;
+
+    PinToCpu(Contender->Index);
+    *Contender->Running = 1;
+
+    for (LONG i = 0; !*Contender->Stop; i++)
+        SharedLine[2] = i;
+
+    return 0;
+}
+
+#endif // _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t ContenderCpu = ~0u;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-contender") && (i + 1 < argc))
+            ContenderCpu = strtoul(argv[++i], NULL, 0);
+        else
+        {
+            printf("Usage: fences [-csv] [-contender N]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+    EnumerateCpus();
+
+    if (ContenderCpu >= CpuCount)
+        ContenderCpu = CpuCount - 1;
+
+    PinToCpu(0);
+
+    TscPerNs = CalibrateTscPerNs();
+
+    double AloneNs[BARRIERS], StoresNs[BARRIERS], ContendedNs[BARRIERS];
+
+    for (uint32_t b = 0; b < BARRIERS; b++)
+    {
+        if (!Barriers[b].IsPresent())
+            continue;
+
+        AloneNs[b] = MeasureLoop(Barriers[b].Alone);
+        StoresNs[b] = MeasureLoop(Barriers[b].Stores);
+        ContendedNs[b] = 0.0;
+    }
+
+    // start the contender only now, and only when there is a second CPU for it
+
+    volatile LONG Stop = 0;
+    volatile LONG Running = 0;
+    CONTENDER Contender = { ContenderCpu, &Stop, &Running };
+    HANDLE Thread = NULL;
+
+    if (ContenderCpu != 0)
+        Thread = CreateThread(NULL, 0, ContenderProc, &Contender, 0, NULL);
+
+    if (Thread != NULL)
+    {
+        while (!Running)
+            YieldProcessor();
+
+        for (uint32_t b = 0; b < BARRIERS; b++)
+        {
+            if (Barriers[b].IsPresent())
+                ContendedNs[b] = MeasureLoop(Barriers[b].Contended);
+        }
+
+        Stop = 1;
+        WaitForSingleObject(Thread, INFINITE);
+        CloseHandle(Thread);
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\nBarrier cost in ns, best of %u rounds of %u, TSC at %.0f MHz.\n", ROUNDS, ITERATIONS, TscPerNs * 1000.0);
+        printf("The store loop does %u stores to L1 lines before each barrier.\n", STORES);
+
+        if (Thread != NULL)
+            printf("The contended line is written by a thread on CPU %u.\n", ContenderCpu);
+        else
+            printf("There is no second CPU, so the contended column is not measured.\n");
+
+        printf("\n%-10s %10s %12s %12s\n", "barrier", "alone", "store loop", "contended");
+    }
+
+    for (uint32_t b = 0; b < BARRIERS; b++)
+    {
+        if (!Barriers[b].IsPresent())
+        {
+            if (!CsvOutput)
+                printf("%-10s %10s %12s %12s\n", Barriers[b].Name, "absent", "", "");
+
+            continue;
+        }
+
+        if (CsvOutput)
+            printf("barrier,%s,%.2f,%.2f,%.2f\n", Barriers[b].Name, AloneNs[b], StoresNs[b], ContendedNs[b]);
+        else if (Thread != NULL)
+            printf("%-10s %10.2f %12.2f %12.2f\n", Barriers[b].Name, AloneNs[b], StoresNs[b], ContendedNs[b]);
+        else
+            printf("%-10s %10.2f %12.2f %12s\n", Barriers[b].Name, AloneNs[b], StoresNs[b], "-");
+    }
+
+#else
+
+    (void)ContenderCpu;
+    printf("This probe uses x86 barrier intrinsics, run the x64 build to test the emulator on ARM64.\n");
+
+#endif
+
+    return 0;
+}
+
@@ -0,0 +1,528 @@
+
+//
+// FREQ.C
+//
+// Effective core frequency probe.
+//
+// The brand string and CPUID leaf 0x16 give the nominal base and maximum
+// frequency, but not the frequency a core actually runs at.  This times a
+// generated loop of dependent ADD instructions, which retire at one per
+// clock on every x86 core of the last 20 years, against the TSC.  The TSC
+// rate itself is calibrated against QueryPerformanceCounter() and compared
+// with CPUID leaf 0x15.
+//
+// APERF and MPERF are MSRs and cannot be read from user mode on Windows, so
+// the frequency the kernel reports through CallNtPowerInformation() is shown
+// alongside the measured one instead.
+//
+// Usage: freq [-csv] [-seconds N]
+//
+//   -csv      print machine-readable comma-separated records only
+//   -seconds  duration of the all-core sustained measurement (default 2)
+//
+// The -csv records are:
+//
+//   nominal,brand,leaf 16h base,max,bus MHz,leaf 15h TSC MHz,measured TSC MHz
+//   cpu,index,group,number,single-core MHz,OS reported MHz
+//   ramp,index,first sample MHz,plateau MHz,microseconds to 95% of plateau
+//   allcore,index,sustained MHz
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <powerbase.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define MAX_CPUS      (256)
+#define ADDS_PER_LOOP (256)
+#define SLICE_US      (100)            // length of one frequency sample
+#define RAMP_SLICES   (3000)           // 300 ms of samples after an idle period
+#define IDLE_MS       (500)
+
+typedef uint32_t (ADD_LOOP)(uint32_t Loops);
+
+// not declared in any SDK header, see the CallNtPowerInformation documentation
+
+typedef struct PROCESSOR_POWER_INFORMATION
+{
+    ULONG Number;
+    ULONG MaxMhz;
+    ULONG CurrentMhz;
+    ULONG MhzLimit;
+    ULONG MaxIdleState;
+    ULONG CurrentIdleState;
+} PROCESSOR_POWER_INFORMATION;
+
+bool CsvOutput = false;
+double TscPerUs = 0.0;
+ADD_LOOP *AddLoop = NULL;
+
+typedef struct CPU_ENTRY
+{
+    WORD Group;
+    BYTE Number;
+} CPU_ENTRY;
+
+CPU_ENTRY Cpus[MAX_CPUS];
+uint32_t CpuCount = 0;
+
+#if _M_IX86 || _M_AMD64 || _M_ARM64EC
+
+//
+// Generate "loop: ADD EAX,ECX x 256; DEC EDX; JNZ loop; RET" so that the
+// compiler cannot shorten or vectorize the dependency chain.
+//
+
+ADD_LOOP *EmitAddLoop()
+{
+    uint8_t *Code = (uint8_t *)VirtualAlloc(NULL, 4096, MEM_COMMIT, PAGE_READWRITE);
+
+    if (Code == NULL)
+        return NULL;
+
+    uint8_t *p = Code;
+
+#if _M_IX86
+    *p++ = 0x8B; *p++ = 0x54; *p++ = 0x24; *p++ = 0x04;             // MOV EDX,[ESP+4]
+#else
+    *p++ = 0x8B; *p++ = 0xD1;                                       // MOV EDX,ECX
+#endif
+    *p++ = 0x31; *p++ = 0xC0;                                       // XOR EAX,EAX
+
+    uint8_t *Loop = p;
+
+    for (int i = 0; i < ADDS_PER_LOOP; i++)
+    {
+        *p++ = 0x01; *p++ = 0xC8;                                   // ADD EAX,ECX
+    }
+
+    *p++ = 0xFF; *p++ = 0xCA;                                       // DEC EDX
+    *p++ = 0x0F; *p++ = 0x85;                                       // JNZ rel32
+    *(int32_t *)p = (int32_t)(Loop - (p + 4));
+    p += 4;
+    *p++ = 0xC3;                                                    // RET
+
+    DWORD OldProtect = 0;
+    VirtualProtect(Code, 4096, PAGE_EXECUTE_READ, &OldProtect);
+    FlushInstructionCache(GetCurrentProcess(), Code, 4096);
+
+    return (ADD_LOOP *)(void *)Code;
+}
+
+uint32_t LookUpReg(uint32_t Function, int Reg)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[0] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, 0);
+
+    return CpuInfo[Reg];
+}
+
+const char * LookUpModelString()
+{
+    static int CpuInfo[4][4];
+
+    if (LookUpReg(0x80000000, 0) < 0x80000004)
+        return "(no brand string)";
+
+    __cpuidex(&CpuInfo[0][0], 0x80000002, 0);
+    __cpuidex(&CpuInfo[1][0], 0x80000003, 0);
+    __cpuidex(&CpuInfo[2][0], 0x80000004, 0);
+
+    return (char *)&CpuInfo[0];
+}
+
+//
+// Calibrate the TSC against QPC over about 100 milliseconds.
+//
+
+double CalibrateTscPerUs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Us = (double)(Stop.QuadPart - Start.QuadPart) * 1e6 / (double)Freq.QuadPart;
+
+    return (double)(TscStop - TscStart) / Us;
+}
+
+//
+// Run the add loop for about one slice and return the effective MHz,
+// which is simply adds per microsecond.
+//
+
+uint32_t LoopsPerSlice = 100;
+
+double MeasureSliceMhz()
+{
+    uint64_t Start = __rdtsc();
+    (*AddLoop)(LoopsPerSlice);
+    uint64_t Stop = __rdtsc();
+
+    double Us = (double)(Stop - Start) / TscPerUs;
+
+    return (double)LoopsPerSlice * ADDS_PER_LOOP / Us;
+}
+
+void SizeSlice()
+{
+    // aim for SLICE_US at whatever frequency the core is currently at
+
+    for (int i = 0; i < 10; i++)
+    {
+        double Mhz = MeasureSliceMhz();
+        LoopsPerSlice = max(1, (uint32_t)(Mhz * SLICE_US / ADDS_PER_LOOP));
+    }
+}
+
+double MeasureBestMhz(uint32_t WarmMs, uint32_t Slices)
+{
+    uint64_t WarmUntil = __rdtsc() + (uint64_t)(WarmMs * 1000.0 * TscPerUs);
+
+    while (__rdtsc() < WarmUntil)
+        (*AddLoop)(LoopsPerSlice);
+
+    double Best = 0.0;
+
+    for (uint32_t i = 0; i < Slices; i++)
+    {
+        double Mhz = MeasureSliceMhz();
+        Best = max(Best, Mhz);
+    }
+
+    return Best;
+}
+
+uint32_t GetOsMhz(uint32_t Index)
+{
+    static PROCESSOR_POWER_INFORMATION Info[MAX_CPUS];
+
+    if (CallNtPowerInformation(ProcessorInformation, NULL, 0, Info, sizeof(Info)) != 0)
+        return 0;
+
+    // the power information is indexed by processor number across all groups
+
+    return (Index < MAX_CPUS) ? Info[Index].CurrentMhz : 0;
+}
+
+bool PinToCpu(uint32_t Index)
+{
+    GROUP_AFFINITY Affinity = { 0 };
+
+    Affinity.Group = Cpus[Index].Group;
+    Affinity.Mask = (KAFFINITY)1 << Cpus[Index].Number;
+
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+        return false;
+
+    SwitchToThread();
+    return true;
+}
+
+void EnumerateCpus()
+{
+    WORD Groups = GetActiveProcessorGroupCount();
+
+    for (WORD Group = 0; Group < Groups; Group++)
+    {
+        DWORD Count = GetActiveProcessorCount(Group);
+
+        for (DWORD Number = 0; (Number < Count) && (CpuCount < MAX_CPUS); Number++)
+        {
+            Cpus[CpuCount].Group = Group;
+            Cpus[CpuCount].Number = (BYTE)Number;
+            CpuCount++;
+        }
+    }
+}
+
+//
+// Idle the core, then sample it continuously and report how long it takes
+// to reach 95% of the frequency it settles at.
+//
+
+void MeasureRamp(uint32_t Index)
+{
+    static double Samples[RAMP_SLICES];
+    static double SampleUs[RAMP_SLICES];
+
+    PinToCpu(Index);
+    Sleep(IDLE_MS);
+
+    uint64_t Start = __rdtsc();
+
+    for (uint32_t i = 0; i < RAMP_SLICES; i++)
+    {
+        Samples[i] = MeasureSliceMhz();
+        SampleUs[i] = (double)(__rdtsc() - Start) / TscPerUs;
+    }
+
+    // the plateau is the average of the last quarter of the samples
+
+    double Plateau = 0.0;
+    uint32_t Tail = RAMP_SLICES / 4;
+
+    for (uint32_t i = RAMP_SLICES - Tail; i < RAMP_SLICES; i++)
+        Plateau += Samples[i];
+
+    Plateau /= Tail;
+
+    uint32_t Reached = RAMP_SLICES - 1;
+
+    for (uint32_t i = 0; i < RAMP_SLICES; i++)
+    {
+        if (Samples[i] >= 0.95 * Plateau)
+        {
+            Reached = i;
+            break;
+        }
+    }
+
+    if (CsvOutput)
+    {
+        printf("ramp,%u,%.0f,%.0f,%.0f\n", Index, Samples[0], Plateau, SampleUs[Reached]);
+        return;
+    }
+
+    printf("\nIdle-to-turbo ramp on cpu %u after %u ms idle:\n\n", Index, IDLE_MS);
+
+    for (uint32_t i = 0; i < RAMP_SLICES; i = (i < 20) ? (i + 1) : (i * 3 / 2))
+        printf("  %10.0f us %8.0f MHz\n", SampleUs[i], Samples[i]);
+
+    printf("\n  first sample %.0f MHz, plateau %.0f MHz, 95%% of plateau reached after %.0f us\n",
+        Samples[0], Plateau, SampleUs[Reached]);
+}
+
+//
+// All-core sustained frequency: one thread per logical CPU runs the add
+// loop for the requested number of seconds and reports its average MHz.
+//
+
+typedef struct WORKER
+{
+    uint32_t      Index;
+    uint64_t      Duration;            // in TSC ticks
+    volatile LONG *Go;
+    double        Mhz;
+} WORKER;
+
+DWORD WINAPI WorkerProc(LPVOID Param)
+{
+    WORKER *Worker = (WORKER *)Param;
+
+    PinToCpu(Worker->Index);
+
+    while (!*Worker->Go)
+        YieldProcessor();
+
+    uint64_t Start = __rdtsc();
+    uint64_t Loops = 0;
+
+    while ((__rdtsc() - Start) < Worker->Duration)
+    {
+        (*AddLoop)(LoopsPerSlice);
+        Loops += LoopsPerSlice;
+    }
+
+    double Us = (double)(__rdtsc() - Start) / TscPerUs;
+
+    Worker->Mhz = (double)Loops * ADDS_PER_LOOP / Us;
+
+    return 0;
+}
+
+void MeasureAllCore(uint32_t Seconds)
+{
+    static WORKER Workers[MAX_CPUS];
+    static HANDLE Threads[MAX_CPUS];
+    volatile LONG Go = 0;
+    uint32_t Count = 0;
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        Workers[i].Index = i;
+        Workers[i].Duration = (uint64_t)(Seconds * 1e6 * TscPerUs);
+        Workers[i].Go = &Go;
+        Workers[i].Mhz = 0.0;
+
+        Threads[Count] = CreateThread(NULL, 0, WorkerProc, &Workers[i], 0, NULL);
+
+        if (Threads[Count] == NULL)
+        {
+            printf("CreateThread failed with error %u\n", GetLastError());
+            break;
+        }
+
+        Count++;
+    }
+
+    Sleep(100);
+    Go = 1;
+
+    double MinMhz = 1e9, MaxMhz = 0.0, SumMhz = 0.0;
+
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        WaitForSingleObject(Threads[i], INFINITE);
+        CloseHandle(Threads[i]);
+
+        MinMhz = min(MinMhz, Workers[i].Mhz);
+        MaxMhz = max(MaxMhz, Workers[i].Mhz);
+        SumMhz += Workers[i].Mhz;
+    }
+
+    if (Count == 0)
+        return;
+
+    if (CsvOutput)
+    {
+        for (uint32_t i = 0; i < Count; i++)
+            printf("allcore,%u,%.0f\n", i, Workers[i].Mhz);
+
+        return;
+    }
+
+    printf("\nAll-core sustained frequency over %u seconds on %u CPUs:\n\n", Seconds, Count);
+
+    for (uint32_t i = 0; i < Count; i++)
+        printf("  cpu %3u %8.0f MHz\n", i, Workers[i].Mhz);
+
+    printf("\n  min %.0f MHz, average %.0f MHz, max %.0f MHz\n", MinMhz, SumMhz / Count, MaxMhz);
+}
+
+#endif // _M_IX86 || _M_AMD64 || _M_ARM64EC
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t Seconds = 2;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-seconds") && (i + 1 < argc))
+        {
+            // min() and max() evaluate their arguments twice
+            Seconds = strtoul(argv[++i], NULL, 0);
+            Seconds = max(1, Seconds);
+        }
+        else
+        {
+            printf("Usage: freq [-csv] [-seconds N]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86 || _M_AMD64 || _M_ARM64EC
+
+    AddLoop = EmitAddLoop();
+
+    if (AddLoop == NULL)
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    EnumerateCpus();
+
+    GROUP_AFFINITY Original;
+    GetThreadGroupAffinity(GetCurrentThread(), &Original);
+
+    // nominal frequencies as reported by CPUID, 0 when the leaf is not present
+
+    uint32_t BaseMhz  = LookUpReg(0x16, 0);
+    uint32_t MaxMhz   = LookUpReg(0x16, 1);
+    uint32_t BusMhz   = LookUpReg(0x16, 2);
+    uint32_t TscDenom = LookUpReg(0x15, 0);
+    uint32_t TscNumer = LookUpReg(0x15, 1);
+    uint32_t CrystalHz = LookUpReg(0x15, 2);
+
+    double CpuidTscMhz = (TscDenom && CrystalHz) ? ((double)CrystalHz * TscNumer / TscDenom / 1e6) : 0.0;
+
+    TscPerUs = CalibrateTscPerUs();
+
+    if (CsvOutput)
+    {
+        printf("nominal,\"%s\",%u,%u,%u,%.0f,%.0f\n", LookUpModelString(), BaseMhz, MaxMhz, BusMhz, CpuidTscMhz, TscPerUs);
+    }
+    else
+    {
+        printf("\nEffective frequency probe, %u logical CPUs.\n\n", CpuCount);
+        printf("Brand string         = %s\n", LookUpModelString());
+        printf("Leaf 16h base        = %u MHz\n", BaseMhz);
+        printf("Leaf 16h max         = %u MHz\n", MaxMhz);
+        printf("Leaf 16h bus         = %u MHz\n", BusMhz);
+        printf("Leaf 15h TSC         = %.0f MHz\n", CpuidTscMhz);
+        printf("Measured TSC         = %.0f MHz\n", TscPerUs);
+    }
+
+    // single-core turbo: each CPU in turn with everything else idle
+
+    if (!CsvOutput)
+        printf("\nSingle-core frequency per CPU (best %u us slice after 50 ms of load):\n\n", SLICE_US);
+
+    double BestSingle = 0.0;
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        if (!PinToCpu(i))
+            continue;
+
+        SizeSlice();
+
+        double Mhz = MeasureBestMhz(50, 100);
+        uint32_t OsMhz = GetOsMhz(i);
+
+        BestSingle = max(BestSingle, Mhz);
+
+        if (CsvOutput)
+            printf("cpu,%u,%u,%u,%.0f,%u\n", i, Cpus[i].Group, Cpus[i].Number, Mhz, OsMhz);
+        else
+            printf("  cpu %3u (%u:%-2u) %8.0f MHz measured, %6u MHz reported by the OS\n", i, Cpus[i].Group, Cpus[i].Number, Mhz, OsMhz);
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\n  single-core turbo %.0f MHz", BestSingle);
+
+        if (MaxMhz)
+            printf(", %.0f%% of the leaf 16h maximum", BestSingle * 100.0 / MaxMhz);
+
+        printf("\n");
+    }
+
+    MeasureRamp(0);
+
+    SetThreadGroupAffinity(GetCurrentThread(), &Original, NULL);
+
+    MeasureAllCore(Seconds);
+
+#else
+
+    printf("This probe generates x86/x64 code and requires an x86, x64, or ARM64EC build.\n");
+
+#endif
+
+    return 0;
+}
+
@@ -0,0 +1,35 @@
+echo on
+
+@rem Builds 32-bit and 64-bit versions of the effective frequency probe for x86, x64, and ARM64EC.
+@rem Run the Visual Studio vcvars32.bat _or_ vcvars64.bat / vcvarsamd64_arm64.bat scripts ahead of time.
+
+@if "%VSCMD_ARG_TGT_ARCH%" == "" (
+    echo Visual Studio build environment not initialized.
+    echo Make sure to run vcvars32.bat vcvars64.bat or vcvarsamd64_arm64.bat
+    goto end
+    )
+
+@if "%VSCMD_ARG_TGT_ARCH%" == "x64" (
+    cl -Zi -W4 -FAsc -O2 -Oi -Ob2          freq.c -link -release -debug -incremental:no -out:freq_x64.exe  -nodefaultlib ucrt.lib vcruntime.lib libcmt.lib mincore.lib
+    move /y freq.cod freq_x64.cod
+    goto end
+    )
+
+@if "%VSCMD_ARG_TGT_ARCH%" == "x86" (
+    cl -Zi -W4 -FAsc -O2 -Oi -Ob2          freq.c -link -release -debug -incremental:no -out:freq_x86.exe  -nodefaultlib ucrt.lib vcruntime.lib libcmt.lib mincore.lib msvcrt.lib
+    move /y freq.cod freq_x86.cod
+    goto end
+    )
+
+@if not "%VSCMD_ARG_TGT_ARCH%" == "arm64" (
+    @echo Unknown target ISA!
+    goto end
+    )
+
+@rem the generated code is x64 so only the ARM64EC build is meaningful on ARM64
+
+cl -Zi -W4 -FAsc -O2 -Oi -Ob2 -arm64EC freq.c -link -release -debug -incremental:no -out:freq_ec.exe   -nodefaultlib ucrt.lib vcruntime.lib libcmt.lib mincore.lib
+move /y freq.cod freq_ec.cod
+
+:end
+
@@ -0,0 +1,803 @@
+
+//
+// HYBRID.C
+//
+// Hybrid P-core / E-core characterization.
+//
+// Groups the logical CPUs by core type, using the Windows efficiency class of
+// each core and, on x86 and x64, the CPUID leaf 0x1A core type read on that
+// CPU.  It then compares the ISA each core type reports and runs the same
+// integer, floating-point, vector, and memory kernels on each type, first on
+// one CPU and then on every CPU of that type at once.  The ratios are relative
+// to the most performant core type (the highest efficiency class) and are the
+// weights a scheduler should use when splitting work between core types.
+//
+// On a homogeneous CPU there is only one core type and every ratio is 1.00.
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <intrin.h>
+
+#define MAX_CPUS      (256)
+#define MAX_TYPES     (8)
+#define NO_TYPE       (MAX_TYPES)      // the CPU's type did not fit in CoreTypes[]
+
+#define INT_ITERS     (50000000)
+#define FP_ITERS      (50000000)
+#define VEC_FLOATS    (1024)           // 4 KB per array, stays in the L1
+#define VEC_PASSES    (50000)
+#define MEM_BYTES     (64 * 1024 * 1024)
+#define MEM_PASSES    (4)
+#define CHASE_LOADS   (4000000)
+
+#if _M_IX86 || _M_AMD64
+#define HAS_CPUID     (1)
+#endif
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+//
+// The CPUID feature registers compared between core types.
+//
+
+typedef struct ISA_REG
+{
+    uint32_t   Function;
+    uint32_t   Sub;
+    CPUID_REGS Reg;
+} ISA_REG;
+
+const ISA_REG IsaRegs[] =
+{
+    { 0x00000001, 0, CPUID_ECX },
+    { 0x00000001, 0, CPUID_EDX },
+    { 0x00000007, 0, CPUID_EBX },
+    { 0x00000007, 0, CPUID_ECX },
+    { 0x00000007, 0, CPUID_EDX },
+    { 0x00000007, 1, CPUID_EAX },
+    { 0x00000007, 1, CPUID_EDX },
+    { 0x0000000D, 1, CPUID_EAX },
+    { 0x80000001, 0, CPUID_ECX },
+    { 0x80000001, 0, CPUID_EDX },
+};
+
+#define ISA_REGS (sizeof(IsaRegs) / sizeof(IsaRegs[0]))
+
+const char *RegNames[] = { "EAX", "EBX", "ECX", "EDX" };
+
+// names for the bits most likely to differ between core types
+
+typedef struct ISA_BIT
+{
+    uint32_t    Function;
+    uint32_t    Sub;
+    CPUID_REGS  Reg;
+    int         Bit;
+    const char *Name;
+} ISA_BIT;
+
+const ISA_BIT IsaBits[] =
+{
+    { 0x00000001, 0, CPUID_ECX, 28, "AVX"            },
+    { 0x00000007, 0, CPUID_EBX,  4, "HLE"            },
+    { 0x00000007, 0, CPUID_EBX,  5, "AVX2"           },
+    { 0x00000007, 0, CPUID_EBX, 11, "RTM"            },
+    { 0x00000007, 0, CPUID_EBX, 16, "AVX512F"        },
+    { 0x00000007, 0, CPUID_EBX, 17, "AVX512DQ"       },
+    { 0x00000007, 0, CPUID_EBX, 21, "AVX512_IFMA"    },
+    { 0x00000007, 0, CPUID_EBX, 28, "AVX512CD"       },
+    { 0x00000007, 0, CPUID_EBX, 30, "AVX512BW"       },
+    { 0x00000007, 0, CPUID_EBX, 31, "AVX512VL"       },
+    { 0x00000007, 0, CPUID_ECX,  1, "AVX512_VBMI"    },
+    { 0x00000007, 0, CPUID_ECX,  5, "WAITPKG"        },
+    { 0x00000007, 0, CPUID_ECX,  6, "AVX512_VBMI2"   },
+    { 0x00000007, 0, CPUID_ECX, 11, "AVX512_VNNI"    },
+    { 0x00000007, 0, CPUID_ECX, 14, "AVX512_POPCNTDQ"},
+    { 0x00000007, 0, CPUID_EDX, 14, "SERIALIZE"      },
+    { 0x00000007, 0, CPUID_EDX, 15, "HYBRID"         },
+    { 0x00000007, 0, CPUID_EDX, 16, "TSXLDTRK"       },
+    { 0x00000007, 0, CPUID_EDX, 22, "AMX_BF16"       },
+    { 0x00000007, 0, CPUID_EDX, 24, "AMX_TILE"       },
+    { 0x00000007, 0, CPUID_EDX, 25, "AMX_INT8"       },
+    { 0x00000007, 1, CPUID_EAX,  4, "AVX-VNNI"       },
+    { 0x00000007, 1, CPUID_EAX,  5, "AVX512_BF16"    },
+    { 0x00000007, 1, CPUID_EDX, 19, "AVX10"          },
+};
+
+#define ISA_BITS (sizeof(IsaBits) / sizeof(IsaBits[0]))
+
+//
+// One entry per logical CPU and one per distinct core type.
+//
+
+typedef struct CPU_ENTRY
+{
+    WORD     Group;
+    BYTE     Number;
+    BYTE     EfficiencyClass;
+    uint32_t CoreType;                 // CPUID leaf 0x1A EAX[31:24], 0 if not reported
+    uint32_t Isa[ISA_REGS];
+    uint32_t Type;                     // index into CoreTypes[], or NO_TYPE
+} CPU_ENTRY;
+
+typedef struct CORE_TYPE
+{
+    BYTE     EfficiencyClass;
+    uint32_t CoreType;
+    uint32_t Cpus;
+    uint32_t FirstCpu;
+    char     Name[48];
+} CORE_TYPE;
+
+CPU_ENTRY Cpus[MAX_CPUS];
+uint32_t CpuCount = 0;
+
+CORE_TYPE CoreTypes[MAX_TYPES];
+uint32_t TypeCount = 0;
+
+bool PinToCpu(uint32_t Index)
+{
+    GROUP_AFFINITY Affinity = { 0 };
+
+    Affinity.Group = Cpus[Index].Group;
+    Affinity.Mask = (KAFFINITY)1 << Cpus[Index].Number;
+
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+        return false;
+
+    // make sure the thread has moved before doing anything on that CPU
+
+    SwitchToThread();
+    return true;
+}
+
+//
+// Read CPUID registers on the current CPU, honouring the maximum leaf.
+//
+
+uint32_t ReadCpuid(uint32_t Function, uint32_t Sub, CPUID_REGS Reg)
+{
+#if HAS_CPUID
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return CpuInfo[Reg];
+#else
+    (void)Function; (void)Sub; (void)Reg;
+    return 0;
+#endif
+}
+
+const char * LookUpCoreType(uint32_t CoreType)
+{
+    switch (CoreType)
+        {
+    case 0x20: return "Atom (E-core)";
+    case 0x40: return "Core (P-core)";
+    default:   return NULL;
+        }
+}
+
+//
+// Enumerate the cores with their efficiency class, then visit every logical
+// CPU to read its core type and feature registers.
+//
+
+bool EnumerateCpus()
+{
+    DWORD Length = 0;
+
+    GetLogicalProcessorInformationEx(RelationProcessorCore, NULL, &Length);
+
+    SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *Info = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)malloc(Length);
+
+    if ((Info == NULL) || !GetLogicalProcessorInformationEx(RelationProcessorCore, Info, &Length))
+    {
+        printf("GetLogicalProcessorInformationEx failed with error %u\n", GetLastError());
+        free(Info);
+        return false;
+    }
+
+    for (DWORD Offset = 0; Offset < Length; )
+    {
+        SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *Core = (SYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX *)((uint8_t *)Info + Offset);
+
+        for (WORD g = 0; g < Core->Processor.GroupCount; g++)
+        {
+            for (BYTE n = 0; n < sizeof(KAFFINITY) * 8; n++)
+            {
+                if (!((Core->Processor.GroupMask[g].Mask >> n) & 1) || (CpuCount == MAX_CPUS))
+                    continue;
+
+                Cpus[CpuCount].Group = Core->Processor.GroupMask[g].Group;
+                Cpus[CpuCount].Number = n;
+                Cpus[CpuCount].EfficiencyClass = Core->Processor.EfficiencyClass;
+                CpuCount++;
+            }
+        }
+
+        Offset += Core->Size;
+    }
+
+    free(Info);
+
+    GROUP_AFFINITY Original;
+    GetThreadGroupAffinity(GetCurrentThread(), &Original);
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        if (!PinToCpu(i))
+            continue;
+
+        Cpus[i].CoreType = ReadCpuid(0x1A, 0, CPUID_EAX) >> 24;
+
+        for (uint32_t r = 0; r < ISA_REGS; r++)
+            Cpus[i].Isa[r] = ReadCpuid(IsaRegs[r].Function, IsaRegs[r].Sub, IsaRegs[r].Reg);
+    }
+
+    SetThreadGroupAffinity(GetCurrentThread(), &Original, NULL);
+
+    return CpuCount != 0;
+}
+
+//
+// A core type is a distinct (efficiency class, CPUID core type) pair.  Types
+// are sorted most performant first so that ratios are relative to the P-cores.
+//
+
+void ClassifyCpus()
+{
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        uint32_t t;
+
+        Cpus[i].Type = NO_TYPE;
+
+        for (t = 0; t < TypeCount; t++)
+        {
+            if ((CoreTypes[t].EfficiencyClass == Cpus[i].EfficiencyClass) && (CoreTypes[t].CoreType == Cpus[i].CoreType))
+                break;
+        }
+
+        if ((t == TypeCount) && (TypeCount < MAX_TYPES))
+        {
+            CoreTypes[t].EfficiencyClass = Cpus[i].EfficiencyClass;
+            CoreTypes[t].CoreType = Cpus[i].CoreType;
+            CoreTypes[t].FirstCpu = i;
+            TypeCount++;
+        }
+
+        // a CPU of a type beyond MAX_TYPES is not counted, listed, or measured
+
+        if (t < TypeCount)
+            CoreTypes[t].Cpus++;
+    }
+
+    for (uint32_t t = 1; t < TypeCount; t++)
+    {
+        for (uint32_t u = t; (u > 0) && (CoreTypes[u].EfficiencyClass > CoreTypes[u - 1].EfficiencyClass); u--)
+        {
+            CORE_TYPE Temp = CoreTypes[u];
+            CoreTypes[u] = CoreTypes[u - 1];
+            CoreTypes[u - 1] = Temp;
+        }
+    }
+
+    for (uint32_t t = 0; t < TypeCount; t++)
+    {
+        const char *Name = LookUpCoreType(CoreTypes[t].CoreType);
+
+        if (Name)
+            sprintf_s(CoreTypes[t].Name, sizeof(CoreTypes[t].Name), "%s", Name);
+        else
+            sprintf_s(CoreTypes[t].Name, sizeof(CoreTypes[t].Name), "class %u cores", CoreTypes[t].EfficiencyClass);
+
+        for (uint32_t i = 0; i < CpuCount; i++)
+        {
+            if ((Cpus[i].EfficiencyClass == CoreTypes[t].EfficiencyClass) && (Cpus[i].CoreType == CoreTypes[t].CoreType))
+                Cpus[i].Type = t;
+        }
+    }
+}
+
+void ShowCoreTypes()
+{
+    printf("%u logical CPUs, %u core type%s:\n\n", CpuCount, TypeCount, (TypeCount == 1) ? "" : "s");
+
+    for (uint32_t t = 0; t < TypeCount; t++)
+    {
+        printf("  type %u: %-20s efficiency class %u, leaf 1A type %02X, %3u CPUs:",
+            t, CoreTypes[t].Name, CoreTypes[t].EfficiencyClass, CoreTypes[t].CoreType, CoreTypes[t].Cpus);
+
+        for (uint32_t i = 0; i < CpuCount; i++)
+        {
+            if (Cpus[i].Type == t)
+                printf(" %u:%u", Cpus[i].Group, Cpus[i].Number);
+        }
+
+        printf("\n");
+    }
+
+    uint32_t Ignored = 0;
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        if (Cpus[i].Type == NO_TYPE)
+            Ignored++;
+    }
+
+    if (Ignored)
+        printf("  %u CPUs of more than %u core types are ignored\n", Ignored, MAX_TYPES);
+}
+
+//
+// Compare the feature registers of every core type with the first type.
+// Windows normally masks features down to what every core supports, so
+// any difference here means code can fault after a migration.
+//
+
+bool ShowIsaDifference(uint32_t Cpu, uint32_t RefCpu)
+{
+    bool Differs = false;
+
+    for (uint32_t r = 0; r < ISA_REGS; r++)
+    {
+        uint32_t Diff = Cpus[Cpu].Isa[r] ^ Cpus[RefCpu].Isa[r];
+
+        for (int Bit = 0; Bit < 32; Bit++)
+        {
+            if (!((Diff >> Bit) & 1))
+                continue;
+
+            const char *Name = "";
+
+            for (uint32_t b = 0; b < ISA_BITS; b++)
+            {
+                if ((IsaBits[b].Function == IsaRegs[r].Function) && (IsaBits[b].Sub == IsaRegs[r].Sub) &&
+                    (IsaBits[b].Reg == IsaRegs[r].Reg) && (IsaBits[b].Bit == Bit))
+                    Name = IsaBits[b].Name;
+            }
+
+            printf("  cpu %u:%-3u leaf %08X.%u %s bit %2u %-16s %s on cpu %u:%u\n",
+                Cpus[Cpu].Group, Cpus[Cpu].Number,
+                IsaRegs[r].Function, IsaRegs[r].Sub, RegNames[IsaRegs[r].Reg], Bit, Name,
+                ((Cpus[Cpu].Isa[r] >> Bit) & 1) ? "present, absent" : "absent, present",
+                Cpus[RefCpu].Group, Cpus[RefCpu].Number);
+
+            Differs = true;
+        }
+    }
+
+    return Differs;
+}
+
+//
+// Compare the first CPU of every core type with the first CPU of type 0, and
+// every other CPU with the first CPU of its own type.  Windows normally masks
+// features down to what every core supports, so any difference here means
+// code can fault after the thread migrates.
+//
+
+void ShowIsaDifferences()
+{
+#if HAS_CPUID
+    bool Differs = false;
+
+    printf("\nISA differences between core types:\n\n");
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        if (Cpus[i].Type == NO_TYPE)
+            continue;
+
+        uint32_t First = CoreTypes[Cpus[i].Type].FirstCpu;
+
+        Differs |= ShowIsaDifference(i, (i == First) ? CoreTypes[0].FirstCpu : First);
+    }
+
+    if (!Differs)
+        printf("  none, all CPUs report the same feature bits\n");
+#else
+    printf("\nISA differences are only checked on x86, x64, and ARM64EC builds.\n");
+#endif
+}
+
+//
+// The kernels.  Each does a fixed amount of work and returns a checksum so
+// that the compiler cannot discard it.  Work units are integer operations,
+// floating-point operations, vector lanes, bytes, and loads respectively.
+//
+
+typedef uint64_t (KERNEL)(void);
+
+uint32_t *MemBuffer = NULL;            // random cyclic permutation, shared by all threads
+
+uint64_t KernelInteger()
+{
+    uint64_t a = 1, b = 2, c = 3, d = 4;
+
+    for (uint32_t i = 0; i < INT_ITERS; i++)
+    {
+        a = (a ^ (a >> 7)) * 0x9E3779B97F4A7C15ull;
+        b = (b ^ (b << 9)) + 0xBF58476D1CE4E5B9ull;
+        c = (c + (c >> 3)) ^ 0x94D049BB133111EBull;
+        d = (d * 5) ^ (d >> 11);
+    }
+
+    return a + b + c + d;
+}
+
+uint64_t KernelFloat()
+{
+    double a = 1.0, b = 1.1, c = 1.2, d = 1.3;
+
+    for (uint32_t i = 0; i < FP_ITERS; i++)
+    {
+        a = a * 0.999999 + 0.000001;
+        b = b * 0.999998 + 0.000002;
+        c = c * 0.999997 + 0.000003;
+        d = d * 0.999996 + 0.000004;
+    }
+
+    return (uint64_t)((a + b + c + d) * 1000.0);
+}
+
+__declspec(align(64)) float VecX[VEC_FLOATS];
+
+uint64_t KernelVector()
+{
+    // each thread needs its own destination so the threads do not share lines
+
+    __declspec(align(64)) float VecY[VEC_FLOATS];
+
+    for (uint32_t i = 0; i < VEC_FLOATS; i++)
+        VecY[i] = 0.0f;
+
+#if _M_IX86 || _M_AMD64
+    __m128 Scale = _mm_set1_ps(0.999f);
+
+    for (uint32_t Pass = 0; Pass < VEC_PASSES; Pass++)
+    {
+        for (uint32_t i = 0; i < VEC_FLOATS; i += 8)
+        {
+            __m128 y0 = _mm_load_ps(&VecY[i]);
+            __m128 y1 = _mm_load_ps(&VecY[i + 4]);
+
+            y0 = _mm_add_ps(_mm_mul_ps(y0, Scale), _mm_load_ps(&VecX[i]));
+            y1 = _mm_add_ps(_mm_mul_ps(y1, Scale), _mm_load_ps(&VecX[i + 4]));
+
+            _mm_store_ps(&VecY[i], y0);
+            _mm_store_ps(&VecY[i + 4], y1);
+        }
+    }
+#else
+    for (uint32_t Pass = 0; Pass < VEC_PASSES; Pass++)
+    {
+        for (uint32_t i = 0; i < VEC_FLOATS; i++)
+            VecY[i] = VecY[i] * 0.999f + VecX[i];
+    }
+#endif
+
+    return (uint64_t)VecY[VEC_FLOATS / 2];
+}
+
+uint64_t KernelBandwidth()
+{
+    const uint64_t *p = (const uint64_t *)MemBuffer;
+    uint64_t Sum0 = 0, Sum1 = 0, Sum2 = 0, Sum3 = 0;
+
+    for (uint32_t Pass = 0; Pass < MEM_PASSES; Pass++)
+    {
+        for (size_t i = 0; i < MEM_BYTES / sizeof(uint64_t); i += 4)
+        {
+            Sum0 += p[i];
+            Sum1 += p[i + 1];
+            Sum2 += p[i + 2];
+            Sum3 += p[i + 3];
+        }
+    }
+
+    return Sum0 + Sum1 + Sum2 + Sum3;
+}
+
+uint64_t KernelLatency()
+{
+    uint32_t Index = 0;
+
+    for (uint32_t i = 0; i < CHASE_LOADS; i++)
+        Index = MemBuffer[Index];
+
+    return Index;
+}
+
+typedef struct KERNEL_INFO
+{
+    const char *Name;
+    KERNEL     *Kernel;
+    double      Work;
+    const char *Units;
+    bool        IsLatency;             // report time per unit rather than units per time
+} KERNEL_INFO;
+
+const KERNEL_INFO Kernels[] =
+{
+    { "integer",        KernelInteger,   INT_ITERS * 4.0 * 3.0,                     "Gops/s",  false },
+    { "floating-point", KernelFloat,     FP_ITERS * 4.0 * 2.0,                      "Gflop/s", false },
+    { "vector",         KernelVector,    (double)VEC_PASSES * VEC_FLOATS * 2.0,     "Gflop/s", false },
+    { "mem bandwidth",  KernelBandwidth, (double)MEM_PASSES * MEM_BYTES,            "GB/s",    false },
+    { "mem latency",    KernelLatency,   (double)CHASE_LOADS,                       "ns/load", true  },
+};
+
+#define KERNELS (sizeof(Kernels) / sizeof(Kernels[0]))
+
+//
+// Run a kernel on a set of CPUs at once.  Every thread is pinned and waits
+// for a common start signal, and the elapsed time is that of the slowest.
+//
+
+typedef struct WORKER
+{
+    HANDLE        Thread;
+    uint32_t      Cpu;
+    KERNEL       *Kernel;
+    volatile LONG *Ready;
+    volatile LONG *Go;
+    double        ElapsedNs;
+    uint64_t      Result;
+} WORKER;
+
+double ElapsedNs(LARGE_INTEGER Start, LARGE_INTEGER Stop)
+{
+    static LARGE_INTEGER Freq;
+
+    if (Freq.QuadPart == 0)
+        QueryPerformanceFrequency(&Freq);
+
+    return (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+}
+
+DWORD WINAPI WorkerProc(LPVOID Param)
+{
+    WORKER *Worker = (WORKER *)Param;
+
+    PinToCpu(Worker->Cpu);
+
+    _InterlockedIncrement(Worker->Ready);
+
+    while (!*Worker->Go)
+        YieldProcessor();
+
+    LARGE_INTEGER Start, Stop;
+    QueryPerformanceCounter(&Start);
+
+    Worker->Result = (*Worker->Kernel)();
+
+    QueryPerformanceCounter(&Stop);
+    Worker->ElapsedNs = ElapsedNs(Start, Stop);
+
+    return 0;
+}
+
+WORKER Workers[MAX_CPUS];
+uint64_t Sink = 0;
+
+double Single[KERNELS][MAX_TYPES];
+double Parallel[KERNELS][MAX_TYPES];
+
+//
+// Work done by one CPU of the type while all CPUs of the type are busy,
+// relative to one CPU of type 0 running alone.  Latencies are inverted so
+// that higher is always better.
+//
+
+double PerCpuRatio(uint32_t Kernel, uint32_t Type)
+{
+    if (Kernels[Kernel].IsLatency)
+        return Single[Kernel][0] / Parallel[Kernel][Type];
+
+    return Parallel[Kernel][Type] / CoreTypes[Type].Cpus / Single[Kernel][0];
+}
+
+//
+// Returns the work rate (or latency) of one CPU of the type, or of all of them together.
+//
+
+double RunKernel(const KERNEL_INFO *Info, uint32_t Type, bool AllCpus)
+{
+    volatile LONG Ready = 0;
+    volatile LONG Go = 0;
+    uint32_t Count = 0;
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        // an unclassified CPU has NO_TYPE and never matches
+
+        if ((Cpus[i].Type != Type) || (!AllCpus && (i != CoreTypes[Type].FirstCpu)))
+            continue;
+
+        WORKER *Worker = &Workers[Count];
+
+        Worker->Cpu = i;
+        Worker->Kernel = Info->Kernel;
+        Worker->Ready = &Ready;
+        Worker->Go = &Go;
+        Worker->Thread = CreateThread(NULL, 0, WorkerProc, Worker, 0, NULL);
+
+        if (Worker->Thread == NULL)
+        {
+            printf("CreateThread failed with error %u\n", GetLastError());
+            break;
+        }
+
+        Count++;
+    }
+
+    while ((uint32_t)Ready < Count)
+        SwitchToThread();
+
+    Go = 1;
+
+    double MaxNs = 0.0;
+
+    for (uint32_t w = 0; w < Count; w++)
+    {
+        WaitForSingleObject(Workers[w].Thread, INFINITE);
+        CloseHandle(Workers[w].Thread);
+
+        MaxNs = max(MaxNs, Workers[w].ElapsedNs);
+        Sink += Workers[w].Result;
+    }
+
+    if ((Count == 0) || (MaxNs == 0.0))
+        return 0.0;
+
+    // latency is per thread, throughput is the sum over all the threads
+
+    if (Info->IsLatency)
+        return MaxNs / Info->Work;
+
+    return Info->Work * Count / MaxNs;
+}
+
+void BuildChase()
+{
+    uint32_t Count = MEM_BYTES / sizeof(uint32_t);
+    uint64_t Seed = 12345;
+
+    for (uint32_t i = 0; i < Count; i++)
+        MemBuffer[i] = i;
+
+    // Sattolo's algorithm gives a single cycle through every element
+
+    for (uint32_t i = Count - 1; i > 0; i--)
+    {
+        Seed = Seed * 6364136223846793005ull + 1442695040888963407ull;
+
+        uint32_t j = (uint32_t)((Seed >> 33) % i);
+        uint32_t Temp = MemBuffer[i];
+
+        MemBuffer[i] = MemBuffer[j];
+        MemBuffer[j] = Temp;
+    }
+
+    for (uint32_t i = 0; i < VEC_FLOATS; i++)
+        VecX[i] = (float)i / VEC_FLOATS;
+}
+
+int __cdecl main()
+{
+    printf("\nHybrid core characterization.\n\n");
+
+    if (!EnumerateCpus())
+        return 1;
+
+    ClassifyCpus();
+    ShowCoreTypes();
+    ShowIsaDifferences();
+
+    MemBuffer = (uint32_t *)VirtualAlloc(NULL, MEM_BYTES, MEM_COMMIT, PAGE_READWRITE);
+
+    if (MemBuffer == NULL)
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    BuildChase();
+
+    for (uint32_t k = 0; k < KERNELS; k++)
+    {
+        for (uint32_t t = 0; t < TypeCount; t++)
+        {
+            Single[k][t] = RunKernel(&Kernels[k], t, false);
+            Parallel[k][t] = RunKernel(&Kernels[k], t, true);
+        }
+    }
+
+    // ratios are always "how much work this type does relative to type 0", so invert latencies
+
+    printf("\nOne CPU of each type (ratio is relative to type 0):\n\n");
+    printf("%-16s %-8s", "kernel", "units");
+
+    for (uint32_t t = 0; t < TypeCount; t++)
+        printf("   type %u    ratio", t);
+
+    printf("\n");
+
+    for (uint32_t k = 0; k < KERNELS; k++)
+    {
+        printf("%-16s %-8s", Kernels[k].Name, Kernels[k].Units);
+
+        for (uint32_t t = 0; t < TypeCount; t++)
+        {
+            double Ratio = Kernels[k].IsLatency ? (Single[k][0] / Single[k][t]) : (Single[k][t] / Single[k][0]);
+            printf(" %9.2f %8.2f", Single[k][t], Ratio);
+        }
+
+        printf("\n");
+    }
+
+    printf("\nAll CPUs of each type at once (per-CPU ratio is relative to one CPU of type 0):\n\n");
+    printf("%-16s %-8s", "kernel", "units");
+
+    for (uint32_t t = 0; t < TypeCount; t++)
+        printf("   type %u  per-cpu  scaling", t);
+
+    printf("\n");
+
+    for (uint32_t k = 0; k < KERNELS; k++)
+    {
+        printf("%-16s %-8s", Kernels[k].Name, Kernels[k].Units);
+
+        for (uint32_t t = 0; t < TypeCount; t++)
+        {
+            // scaling is aggregate throughput over single-CPU throughput, ideally the CPU count
+
+            double PerCpu  = PerCpuRatio(k, t);
+            double Scaling = Kernels[k].IsLatency ? (Single[k][t] / Parallel[k][t]) : (Parallel[k][t] / Single[k][t]);
+
+            printf(" %9.2f %8.2f %8.2f", Parallel[k][t], PerCpu, Scaling);
+        }
+
+        printf("\n");
+    }
+
+    if (TypeCount > 1)
+    {
+        printf("\nSuggested work weights per CPU (type 0 = 1.00, geometric mean of the parallel per-CPU ratios):\n\n");
+
+        for (uint32_t t = 0; t < TypeCount; t++)
+        {
+            double LogSum = 0.0;
+
+            for (uint32_t k = 0; k < KERNELS; k++)
+                LogSum += log(PerCpuRatio(k, t) / PerCpuRatio(k, 0));
+
+            printf("  type %u %-20s %5.2f\n", t, CoreTypes[t].Name, exp(LogSum / KERNELS));
+        }
+    }
+
+    VirtualFree(MemBuffer, 0, MEM_RELEASE);
+
+    return Sink == 0;
+}
+
@@ -0,0 +1,465 @@
+
+//
+// LARGEPAGES.C
+//
+// Page size probe: 4 KB pages vs 2 MB large pages vs 1 GB huge pages.
+//
+// VA2.C compares allocation flags for code pages.  This does the same for
+// data, allocating the same region with small pages, with MEM_LARGE_PAGES,
+// and with VirtualAlloc2() and MEM_EXTENDED_PARAMETER_NONPAGED_HUGE, and
+// measures for each:
+//
+// - the cost of the allocation itself, of touching every 4 KB of it for the
+//   first time (demand-zero faults for small pages, large pages are already
+//   committed and zeroed), and of freeing it,
+//
+// - the latency of a random pointer chase over growing working sets.  Once
+//   the working set exceeds the reach of the TLB, each load also pays for a
+//   page walk, and the difference between the small-page and large-page
+//   columns is the TLB miss penalty.
+//
+// Large and huge pages require the "Lock pages in memory" user right
+// (SeLockMemoryPrivilege), which is not granted to anyone by default.  Add
+// it with secpol.msc and log off and on again, then run elevated.
+//
+// Windows has no transparent huge pages, so there is nothing to compare
+// between explicit and transparent 2 MB pages.  With LA57 each page walk
+// has a fifth level, and the OS uses it only when the user address space
+// extends past 128 TB, which is shown as well.
+//
+// Usage: largepages [-csv] [-mb N]
+//
+//   -csv   print machine-readable comma-separated records only
+//   -mb    size of the region in megabytes (default 1024)
+//
+// The -csv records are:
+//
+//   paging,LA57 supported,max user address,5-level paging in use
+//   alloc,page size,bytes,alloc ms,first touch ms,free ms
+//   latency,page size,working set bytes,ns per load
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define LINE_BYTES    (64)
+#define MIN_WORKSET   (64 * 1024)
+#define CHASE_LOADS   (4 * 1024 * 1024)
+#define MAX_WORKSETS  (32)
+#define HUGE_PAGE     (1024 * 1024 * 1024)
+
+typedef void *(ALLOCATOR)(size_t numBytesToAllocate);
+
+bool CsvOutput = false;
+double TicksPerNs = 0.0;
+
+void *AllocateReadWrite(size_t numBytesToAllocate)
+{
+    return VirtualAlloc(NULL, numBytesToAllocate, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+void *AllocateReadWriteLarge(size_t numBytesToAllocate)
+{
+    // the size must be a multiple of the large page size
+
+    return VirtualAlloc(NULL, numBytesToAllocate, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+}
+
+void *AllocateReadWriteHuge(size_t numBytesToAllocate)
+{
+    MEM_EXTENDED_PARAMETER Parameter = { 0 };
+    Parameter.Type = MemExtendedParameterAttributeFlags;
+    Parameter.ULong64 = MEM_EXTENDED_PARAMETER_NONPAGED_HUGE;
+
+    void *Address = VirtualAlloc2 (
+        GetCurrentProcess(),
+        NULL,
+        numBytesToAllocate,
+        MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES,
+        PAGE_READWRITE,
+        &Parameter,
+        1);
+
+    return Address;
+}
+
+typedef struct PAGE_KIND
+{
+    const char *Name;
+    ALLOCATOR  *Allocate;
+    size_t      PageBytes;             // 0 when this page size is not available
+    bool        Allocated;
+    double      AllocMs;
+    double      TouchMs;
+    double      FreeMs;
+    double      LatencyNs[MAX_WORKSETS];
+} PAGE_KIND;
+
+PAGE_KIND Kinds[] =
+{
+    { "4K", AllocateReadWrite,      4096 },
+    { "2M", AllocateReadWriteLarge, 0 },
+    { "1G", AllocateReadWriteHuge,  0 },
+};
+
+#define KINDS (sizeof(Kinds) / sizeof(Kinds[0]))
+
+//
+// Large pages can only be allocated with SeLockMemoryPrivilege enabled in
+// the token.  AdjustTokenPrivileges() succeeds even when the privilege is
+// not held, and reports that through GetLastError() instead.
+//
+
+bool EnableLockMemoryPrivilege()
+{
+    HANDLE Token = NULL;
+    TOKEN_PRIVILEGES Privileges = { 0 };
+
+    if (!OpenProcessToken(GetCurrentProcess(), TOKEN_ADJUST_PRIVILEGES | TOKEN_QUERY, &Token))
+        return false;
+
+    Privileges.PrivilegeCount = 1;
+    Privileges.Privileges[0].Attributes = SE_PRIVILEGE_ENABLED;
+
+    bool Enabled = false;
+
+    if (LookupPrivilegeValue(NULL, SE_LOCK_MEMORY_NAME, &Privileges.Privileges[0].Luid))
+    {
+        SetLastError(0);
+        AdjustTokenPrivileges(Token, FALSE, &Privileges, 0, NULL, NULL);
+        Enabled = (GetLastError() == ERROR_SUCCESS);
+    }
+
+    CloseHandle(Token);
+    return Enabled;
+}
+
+#if _M_IX86 || _M_AMD64
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool HasPDPE1GB()  { return LookUpRegBit(0x80000001, 0, CPUID_EDX, 26); }
+bool HasLA57()     { return LookUpRegBit(7, 0, CPUID_ECX, 16); }
+
+#else
+
+bool HasPDPE1GB()  { return true; }
+bool HasLA57()     { return false; }
+
+#endif
+
+//
+// Time in milliseconds using QPC, since the TSC is only calibrated later.
+//
+
+double NowMs()
+{
+    LARGE_INTEGER Freq, Now;
+
+    QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&Now);
+
+    return (double)Now.QuadPart * 1000.0 / (double)Freq.QuadPart;
+}
+
+uint64_t ReadTimeStamp()
+{
+#if _M_IX86 || _M_AMD64
+    return __rdtsc();
+#else
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter(&Now);
+    return Now.QuadPart;
+#endif
+}
+
+double CalibrateTicksPerNs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TicksStart = ReadTimeStamp();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TicksStop = ReadTimeStamp();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return (double)(TicksStop - TicksStart) / Ns;
+}
+
+//
+// Link every cache line of the first Bytes of the region into a single
+// random cycle with Sattolo's algorithm.  The first 4 bytes of each line
+// hold the index of the next line.
+//
+
+void BuildChase(uint8_t *Region, size_t Bytes)
+{
+    uint32_t Lines = (uint32_t)(Bytes / LINE_BYTES);
+    uint64_t Seed = 12345;
+
+    for (uint32_t i = 0; i < Lines; i++)
+        *(uint32_t *)(Region + (size_t)i * LINE_BYTES) = i;
+
+    for (uint32_t i = Lines - 1; i > 0; i--)
+    {
+        Seed = Seed * 6364136223846793005ull + 1442695040888963407ull;
+
+        uint32_t j = (uint32_t)((Seed >> 33) % i);
+        uint32_t *pi = (uint32_t *)(Region + (size_t)i * LINE_BYTES);
+        uint32_t *pj = (uint32_t *)(Region + (size_t)j * LINE_BYTES);
+        uint32_t Temp = *pi;
+
+        *pi = *pj;
+        *pj = Temp;
+    }
+}
+
+volatile uint32_t Sink;
+
+double MeasureChase(uint8_t *Region, size_t Bytes)
+{
+    uint32_t Lines = (uint32_t)(Bytes / LINE_BYTES);
+    uint32_t Index = 0;
+
+    // one lap, or as much as is going to be measured, to warm the caches and TLB
+
+    for (uint32_t i = 0; i < min(Lines, CHASE_LOADS); i++)
+        Index = *(uint32_t *)(Region + (size_t)Index * LINE_BYTES);
+
+    uint64_t Start = ReadTimeStamp();
+
+    for (uint32_t i = 0; i < CHASE_LOADS; i++)
+        Index = *(uint32_t *)(Region + (size_t)Index * LINE_BYTES);
+
+    uint64_t Ticks = ReadTimeStamp() - Start;
+
+    Sink = Index;
+
+    return (double)Ticks / TicksPerNs / CHASE_LOADS;
+}
+
+void FormatBytes(char *Label, size_t Size, size_t Bytes)
+{
+    if (Bytes >= 1024 * 1024)
+        sprintf_s(Label, Size, "%u MB", (uint32_t)(Bytes >> 20));
+    else
+        sprintf_s(Label, Size, "%u KB", (uint32_t)(Bytes >> 10));
+}
+
+void MeasureKind(PAGE_KIND *Kind, size_t Bytes)
+{
+    // round up to whole pages, the chase only ever uses the first Bytes
+
+    size_t AllocBytes = (Bytes + Kind->PageBytes - 1) / Kind->PageBytes * Kind->PageBytes;
+
+    double Start = NowMs();
+    uint8_t *Region = (uint8_t *)(*Kind->Allocate)(AllocBytes);
+    Kind->AllocMs = NowMs() - Start;
+
+    if (Region == NULL)
+    {
+        if (!CsvOutput)
+            printf("%s pages: allocation of %u MB failed with error %u\n", Kind->Name, (uint32_t)(AllocBytes >> 20), GetLastError());
+
+        return;
+    }
+
+    Kind->Allocated = true;
+
+    Start = NowMs();
+
+    for (size_t i = 0; i < AllocBytes; i += 4096)
+        Region[i] = 1;
+
+    Kind->TouchMs = NowMs() - Start;
+
+    uint32_t w = 0;
+
+    for (size_t Workset = MIN_WORKSET; (Workset <= Bytes) && (w < MAX_WORKSETS); Workset *= 2, w++)
+    {
+        BuildChase(Region, Workset);
+        Kind->LatencyNs[w] = MeasureChase(Region, Workset);
+    }
+
+    Start = NowMs();
+    VirtualFree(Region, 0, MEM_RELEASE);
+    Kind->FreeMs = NowMs() - Start;
+}
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t Mb = 1024;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-mb") && (i + 1 < argc))
+        {
+            // min() and max() evaluate their arguments twice
+            Mb = strtoul(argv[++i], NULL, 0);
+            Mb = max(1, Mb);
+        }
+        else
+        {
+            printf("Usage: largepages [-csv] [-mb N]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86
+    // leave the 32-bit address space some room
+    Mb = min(512, Mb);
+#endif
+
+    size_t Bytes = (size_t)Mb * 1024 * 1024;
+
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo(&SystemInfo);
+
+    uintptr_t MaxAddress = (uintptr_t)SystemInfo.lpMaximumApplicationAddress;
+    bool FiveLevel = (sizeof(void *) == 8) && ((uint64_t)MaxAddress > 0x00007FFFFFFFFFFFull);
+
+    bool Privileged = EnableLockMemoryPrivilege();
+
+    if (Privileged)
+    {
+        Kinds[1].PageBytes = GetLargePageMinimum();
+
+        if ((sizeof(void *) == 8) && HasPDPE1GB())
+            Kinds[2].PageBytes = HUGE_PAGE;
+    }
+
+    TicksPerNs = CalibrateTicksPerNs();
+
+    if (CsvOutput)
+    {
+        printf("paging,%u,%p,%u\n", HasLA57(), (void *)MaxAddress, FiveLevel);
+    }
+    else
+    {
+        printf("\nPage size probe over a %u MB region.\n\n", Mb);
+        printf("LA57 supported         = %s\n", HasLA57() ? "yes" : "no");
+        printf("Max user address       = %p\n", (void *)MaxAddress);
+        printf("5-level paging in use  = %s\n", FiveLevel ? "yes" : "no");
+        printf("Large page minimum     = %u KB\n", (uint32_t)(GetLargePageMinimum() >> 10));
+        printf("SeLockMemoryPrivilege  = %s\n", Privileged ? "enabled" : "not held, large and huge pages are skipped");
+        printf("\n");
+    }
+
+    for (uint32_t k = 0; k < KINDS; k++)
+    {
+        if (Kinds[k].PageBytes != 0)
+            MeasureKind(&Kinds[k], Bytes);
+    }
+
+    if (!CsvOutput)
+        printf("\n%-6s %12s %12s %12s %16s\n", "pages", "alloc ms", "touch ms", "free ms", "us per MB total");
+
+    for (uint32_t k = 0; k < KINDS; k++)
+    {
+        PAGE_KIND *Kind = &Kinds[k];
+
+        if (!Kind->Allocated)
+            continue;
+
+        double Total = Kind->AllocMs + Kind->TouchMs + Kind->FreeMs;
+
+        if (CsvOutput)
+            printf("alloc,%s,%u,%.3f,%.3f,%.3f\n", Kind->Name, (uint32_t)Bytes, Kind->AllocMs, Kind->TouchMs, Kind->FreeMs);
+        else
+            printf("%-6s %12.3f %12.3f %12.3f %16.2f\n", Kind->Name, Kind->AllocMs, Kind->TouchMs, Kind->FreeMs, Total * 1000.0 / Mb);
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\nRandom pointer chase latency in ns per load:\n\n%10s", "working set");
+
+        for (uint32_t k = 0; k < KINDS; k++)
+        {
+            if (Kinds[k].Allocated)
+                printf(" %8s", Kinds[k].Name);
+        }
+
+        printf("\n");
+    }
+
+    uint32_t w = 0;
+    size_t LastWorkset = 0;
+
+    for (size_t Workset = MIN_WORKSET; (Workset <= Bytes) && (w < MAX_WORKSETS); Workset *= 2, w++)
+    {
+        LastWorkset = Workset;
+
+        if (CsvOutput)
+        {
+            for (uint32_t k = 0; k < KINDS; k++)
+            {
+                if (Kinds[k].Allocated)
+                    printf("latency,%s,%u,%.2f\n", Kinds[k].Name, (uint32_t)Workset, Kinds[k].LatencyNs[w]);
+            }
+
+            continue;
+        }
+
+        char Label[16];
+        FormatBytes(Label, sizeof(Label), Workset);
+
+        printf("%11s", Label);
+
+        for (uint32_t k = 0; k < KINDS; k++)
+        {
+            if (Kinds[k].Allocated)
+                printf(" %8.2f", Kinds[k].LatencyNs[w]);
+        }
+
+        printf("\n");
+    }
+
+    // the page walk cost is what the large pages save at the largest working set
+
+    if (!CsvOutput && (w > 0) && Kinds[0].Allocated && Kinds[1].Allocated)
+    {
+        char Label[16];
+        FormatBytes(Label, sizeof(Label), LastWorkset);
+
+        printf("\n  TLB miss penalty at %s is about %.1f ns per load with 4 KB pages%s\n",
+            Label, Kinds[0].LatencyNs[w - 1] - Kinds[1].LatencyNs[w - 1], FiveLevel ? " and 5-level paging" : "");
+    }
+
+    return 0;
+}
+
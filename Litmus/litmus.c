@@ -0,0 +1,522 @@
+
+//
+// LITMUS.C
+//
+// Memory model litmus tests: SB, SB+MFENCE, MP, LB, and IRIW.
+//
+// x86 guarantees total store order (TSO): the only reordering a program can
+// observe is a later load passing an earlier store to a different address,
+// through the store buffer.  ARM64 allows much more, so an emulator running
+// x86 code on ARM64 has to insert barriers or use ordered loads and stores,
+// and that is exactly where an emulator might trade correctness for speed.
+//
+// Each test runs small code fragments on pinned threads against a batch of
+// fresh shared variables, walking the batch in lock step so that the
+// threads really race, and histograms the values the loads saw.  Outcomes
+// that x86-TSO forbids are flagged.  The relaxed SB outcome is allowed and
+// shows that the harness does provoke reordering.  The iteration rate is a
+// measure of what ordering costs: compare the x64 build run natively and
+// under emulation.  A test with more threads than there are logical CPUs
+// is not run, since every instance would wait for a context switch.
+//
+//   SB        T0: x=1; r0=y           T1: y=1; r1=x           r0=0 r1=0 allowed
+//   SB+MFENCE T0: x=1; MFENCE; r0=y   T1: y=1; MFENCE; r1=x   r0=0 r1=0 forbidden
+//   MP        T0: x=1; y=1            T1: r0=y; r1=x          r0=1 r1=0 forbidden
+//   LB        T0: r0=x; y=1           T1: r1=y; x=1           r0=1 r1=1 forbidden
+//   IRIW      T0: x=1  T1: y=1  T2: r0=x; r1=y  T3: r2=y; r3=x
+//                                          r0=1 r1=0 r2=1 r3=0 forbidden
+//
+// Usage: litmus [-csv] [-iterations N]
+//
+//   -csv         print machine-readable comma-separated records only
+//   -iterations  instances of each test (default 10000000)
+//
+// The -csv records are:
+//
+//   rate,test,threads,iterations,iterations per second
+//   outcome,test,outcome,count,forbidden
+//   skipped,test,threads,logical CPUs
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define BATCH         (10000)          // instances raced between two barriers
+#define MAX_THREADS   (4)
+#define MAX_CPUS      (256)
+#define NO_OUTCOME    (~0u)
+
+bool CsvOutput = false;
+
+typedef struct CPU_ENTRY
+{
+    WORD Group;
+    BYTE Number;
+} CPU_ENTRY;
+
+CPU_ENTRY Cpus[MAX_CPUS];
+uint32_t CpuCount = 0;
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+//
+// The shared variables of one test instance, on separate cache lines.
+//
+
+typedef struct INSTANCE
+{
+    __declspec(align(64)) volatile LONG x;
+    __declspec(align(64)) volatile LONG y;
+} INSTANCE;
+
+INSTANCE *Instances = NULL;
+uint8_t *Results[MAX_THREADS];         // each thread's loaded values, one bit per register
+
+//
+// The threads of each test, one instance per call.  Loads and stores are
+// volatile, so the compiler emits them in program order and the only
+// reordering is the hardware's (or the emulator's).
+//
+
+typedef void (ROLE)(INSTANCE *I, uint8_t *R);
+
+void SbWriteX(INSTANCE *I, uint8_t *R)
+{
+    I->x = 1;
+    *R = (uint8_t)I->y;
+}
+
+void SbWriteY(INSTANCE *I, uint8_t *R)
+{
+    I->y = 1;
+    *R = (uint8_t)I->x;
+}
+
+void SbFenceWriteX(INSTANCE *I, uint8_t *R)
+{
+    I->x = 1;
+    _mm_mfence();
+    *R = (uint8_t)I->y;
+}
+
+void SbFenceWriteY(INSTANCE *I, uint8_t *R)
+{
+    I->y = 1;
+    _mm_mfence();
+    *R = (uint8_t)I->x;
+}
+
+void MpWrite(INSTANCE *I, uint8_t *R)
+{
+    (void)R;
+
+    I->x = 1;
+    I->y = 1;
+}
+
+void MpRead(INSTANCE *I, uint8_t *R)
+{
+    LONG r0 = I->y;
+    LONG r1 = I->x;
+
+    *R = (uint8_t)(r0 | (r1 << 1));
+}
+
+void LbReadX(INSTANCE *I, uint8_t *R)
+{
+    *R = (uint8_t)I->x;
+    I->y = 1;
+}
+
+void LbReadY(INSTANCE *I, uint8_t *R)
+{
+    *R = (uint8_t)I->y;
+    I->x = 1;
+}
+
+void IriwWriteX(INSTANCE *I, uint8_t *R)
+{
+    (void)R;
+
+    I->x = 1;
+}
+
+void IriwWriteY(INSTANCE *I, uint8_t *R)
+{
+    (void)R;
+
+    I->y = 1;
+}
+
+void IriwReadXY(INSTANCE *I, uint8_t *R)
+{
+    LONG r0 = I->x;
+    LONG r1 = I->y;
+
+    *R = (uint8_t)(r0 | (r1 << 1));
+}
+
+void IriwReadYX(INSTANCE *I, uint8_t *R)
+{
+    LONG r2 = I->y;
+    LONG r3 = I->x;
+
+    *R = (uint8_t)(r2 | (r3 << 1));
+}
+
+//
+// A test is its threads, where each thread's result bits go in the
+// outcome, and which outcomes are forbidden (Forbidden) or allowed but
+// only possible through reordering (Relaxed).
+//
+
+typedef struct LITMUS_TEST
+{
+    const char *Name;
+    uint32_t    Threads;
+    uint32_t    Registers;
+    ROLE       *Roles[MAX_THREADS];
+    uint32_t    Shift[MAX_THREADS];    // NO_OUTCOME when the thread loads nothing
+    uint32_t    Forbidden;
+    uint32_t    Relaxed;
+} LITMUS_TEST;
+
+const LITMUS_TEST Tests[] =
+{
+    { "SB",        2, 2, { SbWriteX,      SbWriteY      }, { 0, 1 }, NO_OUTCOME, 0 },
+    { "SB+MFENCE", 2, 2, { SbFenceWriteX, SbFenceWriteY }, { 0, 1 }, 0,          NO_OUTCOME },
+    { "MP",        2, 2, { MpWrite,       MpRead        }, { NO_OUTCOME, 0 }, 1,   NO_OUTCOME },
+    { "LB",        2, 2, { LbReadX,       LbReadY       }, { 0, 1 }, 3,          NO_OUTCOME },
+    { "IRIW",      4, 4, { IriwWriteX, IriwWriteY, IriwReadXY, IriwReadYX }, { NO_OUTCOME, NO_OUTCOME, 0, 2 }, 5, NO_OUTCOME },
+};
+
+#define TESTS (sizeof(Tests) / sizeof(Tests[0]))
+
+//
+// Sense-reversing spin barrier.  It yields after a while, in case another
+// process has taken one of the CPUs.
+//
+
+typedef struct SPIN_BARRIER
+{
+    volatile LONG Count;
+    volatile LONG Sense;
+    LONG          Threads;
+} SPIN_BARRIER;
+
+SPIN_BARRIER Barrier;
+
+//
+// Threads that merely start together drift apart by hundreds of instances
+// within a batch and then never race.  So before each instance every thread
+// publishes its sequence number and waits for the others to get there too,
+// which keeps them within a cache line transfer of each other.
+//
+
+__declspec(align(64)) volatile LONG Arrived[MAX_THREADS][16];
+
+void WaitBarrier(LONG *LocalSense)
+{
+    *LocalSense = !*LocalSense;
+
+    if (_InterlockedIncrement(&Barrier.Count) == Barrier.Threads)
+    {
+        Barrier.Count = 0;
+        Barrier.Sense = *LocalSense;
+        return;
+    }
+
+    for (uint32_t Spins = 0; Barrier.Sense != *LocalSense; Spins++)
+    {
+        YieldProcessor();
+
+        if (Spins > 10000)
+            SwitchToThread();
+    }
+}
+
+void WaitForOthers(uint32_t Role, uint32_t Threads, LONG Sequence)
+{
+    Arrived[Role][0] = Sequence;
+
+    for (uint32_t t = 0; t < Threads; t++)
+    {
+        for (uint32_t Spins = 0; Arrived[t][0] < Sequence; Spins++)
+        {
+            YieldProcessor();
+
+            if (Spins > 10000)
+                SwitchToThread();
+        }
+    }
+}
+
+bool PinToCpu(uint32_t Index)
+{
+    GROUP_AFFINITY Affinity = { 0 };
+
+    Affinity.Group = Cpus[Index].Group;
+    Affinity.Mask = (KAFFINITY)1 << Cpus[Index].Number;
+
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+        return false;
+
+    SwitchToThread();
+    return true;
+}
+
+void EnumerateCpus()
+{
+    WORD Groups = GetActiveProcessorGroupCount();
+
+    for (WORD Group = 0; Group < Groups; Group++)
+    {
+        DWORD Count = GetActiveProcessorCount(Group);
+
+        for (DWORD Number = 0; (Number < Count) && (CpuCount < MAX_CPUS); Number++)
+        {
+            Cpus[CpuCount].Group = Group;
+            Cpus[CpuCount].Number = (BYTE)Number;
+            CpuCount++;
+        }
+    }
+}
+
+typedef struct WORKER
+{
+    const LITMUS_TEST *Test;
+    uint32_t           Role;
+    uint32_t           Cpu;
+    uint32_t           Batches;
+    uint64_t          *Histogram;      // filled in by thread 0 only
+} WORKER;
+
+//
+// Thread 0 also resets the instances before each batch and tallies the
+// outcomes after it, while the other threads wait at the barrier.
+//
+
+DWORD WINAPI WorkerProc(LPVOID Param)
+{
+    WORKER *Worker = (WORKER *)Param;
+    const LITMUS_TEST *Test = Worker->Test;
+    LONG LocalSense = 0;
+
+    PinToCpu(Worker->Cpu);
+
+    for (uint32_t b = 0; b < Worker->Batches; b++)
+    {
+        if (Worker->Role == 0)
+        {
+            for (uint32_t i = 0; i < BATCH; i++)
+            {
+                Instances[i].x = 0;
+                Instances[i].y = 0;
+            }
+        }
+
+        WaitBarrier(&LocalSense);
+
+        for (uint32_t i = 0; i < BATCH; i++)
+        {
+            WaitForOthers(Worker->Role, Test->Threads, (LONG)(b * BATCH + i + 1));
+            (*Test->Roles[Worker->Role])(&Instances[i], &Results[Worker->Role][i]);
+        }
+
+        WaitBarrier(&LocalSense);
+
+        if (Worker->Role == 0)
+        {
+            for (uint32_t i = 0; i < BATCH; i++)
+            {
+                uint32_t Outcome = 0;
+
+                for (uint32_t t = 0; t < Test->Threads; t++)
+                {
+                    if (Test->Shift[t] != NO_OUTCOME)
+                        Outcome |= (uint32_t)Results[t][i] << Test->Shift[t];
+                }
+
+                Worker->Histogram[Outcome]++;
+            }
+        }
+    }
+
+    return 0;
+}
+
+//
+// Run one test and return how many forbidden outcomes it saw.
+//
+
+uint64_t RunTest(const LITMUS_TEST *Test, uint32_t Batches)
+{
+    static WORKER Workers[MAX_THREADS];
+    static HANDLE Threads[MAX_THREADS];
+    uint64_t Histogram[1 << MAX_THREADS] = { 0 };
+
+    Barrier.Count = 0;
+    Barrier.Sense = 0;
+    Barrier.Threads = Test->Threads;
+
+    for (uint32_t t = 0; t < MAX_THREADS; t++)
+        Arrived[t][0] = 0;
+
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&Start);
+
+    uint32_t Count = 0;
+
+    for (uint32_t t = 0; t < Test->Threads; t++)
+    {
+        // spread the threads over the CPUs, which avoids SMT siblings on most systems
+
+        Workers[t].Test = Test;
+        Workers[t].Role = t;
+        Workers[t].Cpu = (t * CpuCount / Test->Threads) % CpuCount;
+        Workers[t].Batches = Batches;
+        Workers[t].Histogram = Histogram;
+
+        Threads[t] = CreateThread(NULL, 0, WorkerProc, &Workers[t], 0, NULL);
+
+        if (Threads[t] == NULL)
+        {
+            printf("CreateThread failed with error %u\n", GetLastError());
+            exit(1);
+        }
+
+        Count++;
+    }
+
+    for (uint32_t t = 0; t < Count; t++)
+    {
+        WaitForSingleObject(Threads[t], INFINITE);
+        CloseHandle(Threads[t]);
+    }
+
+    QueryPerformanceCounter(&Stop);
+
+    double Seconds = (double)(Stop.QuadPart - Start.QuadPart) / (double)Freq.QuadPart;
+    uint64_t Iterations = (uint64_t)Batches * BATCH;
+
+    if (CsvOutput)
+        printf("rate,%s,%u,%llu,%.0f\n", Test->Name, Test->Threads, Iterations, Iterations / Seconds);
+    else
+        printf("\n%-10s %u threads, %llu iterations, %.2f million per second\n", Test->Name, Test->Threads, Iterations, Iterations / Seconds / 1e6);
+
+    for (uint32_t Outcome = 0; Outcome < (1u << Test->Registers); Outcome++)
+    {
+        bool IsForbidden = (Outcome == Test->Forbidden);
+
+        if (CsvOutput)
+        {
+            printf("outcome,%s,", Test->Name);
+
+            for (uint32_t r = 0; r < Test->Registers; r++)
+                printf("%u", (Outcome >> r) & 1);
+
+            printf(",%llu,%u\n", Histogram[Outcome], IsForbidden);
+            continue;
+        }
+
+        printf("   ");
+
+        for (uint32_t r = 0; r < Test->Registers; r++)
+            printf(" r%u=%u", r, (Outcome >> r) & 1);
+
+        printf(" %12llu", Histogram[Outcome]);
+
+        if (IsForbidden)
+            printf("  forbidden by x86-TSO%s", Histogram[Outcome] ? ", ORDERING VIOLATION" : "");
+        else if (Outcome == Test->Relaxed)
+            printf("  relaxed, allowed by x86-TSO");
+
+        printf("\n");
+    }
+
+    return (Test->Forbidden != NO_OUTCOME) ? Histogram[Test->Forbidden] : 0;
+}
+
+#endif // _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t Iterations = 10000000;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-iterations") && (i + 1 < argc))
+        {
+            // min() and max() evaluate their arguments twice
+            Iterations = strtoul(argv[++i], NULL, 0);
+            Iterations = max(BATCH, Iterations);
+        }
+        else
+        {
+            printf("Usage: litmus [-csv] [-iterations N]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+    EnumerateCpus();
+
+    Instances = (INSTANCE *)VirtualAlloc(NULL, BATCH * sizeof(INSTANCE), MEM_COMMIT, PAGE_READWRITE);
+
+    for (uint32_t t = 0; t < MAX_THREADS; t++)
+        Results[t] = (uint8_t *)VirtualAlloc(NULL, BATCH, MEM_COMMIT, PAGE_READWRITE);
+
+    if ((Instances == NULL) || (Results[MAX_THREADS - 1] == NULL))
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    if (!CsvOutput)
+        printf("\nMemory model litmus tests on %u logical CPUs, batches of %u instances.\n", CpuCount, BATCH);
+
+    uint64_t Violations = 0;
+
+    for (uint32_t t = 0; t < TESTS; t++)
+    {
+        if (Tests[t].Threads > CpuCount)
+        {
+            if (CsvOutput)
+                printf("skipped,%s,%u,%u\n", Tests[t].Name, Tests[t].Threads, CpuCount);
+            else
+                printf("\n%-10s %u threads, not run on %u logical CPUs\n", Tests[t].Name, Tests[t].Threads, CpuCount);
+
+            continue;
+        }
+
+        Violations += RunTest(&Tests[t], Iterations / BATCH);
+    }
+
+    if (!CsvOutput)
+    {
+        if (Violations)
+            printf("\nWarning: %llu outcomes forbidden by x86-TSO were observed\n", Violations);
+        else
+            printf("\nNo outcomes forbidden by x86-TSO were observed.\n");
+    }
+
+    return Violations ? 1 : 0;
+
+#else
+
+    printf("This probe tests the x86 memory model, run the x64 build to test the emulator on ARM64.\n");
+    return 0;
+
+#endif
+}
+
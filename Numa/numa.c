@@ -0,0 +1,555 @@
+
+//
+// NUMA.C
+//
+// NUMA memory bandwidth, latency, and placement probe.
+//
+// CPUIDEX -topology decodes which cores share caches but knows nothing
+// about which memory is close to which core.  This discovers the NUMA nodes
+// and, for every pair of a CPU node and a memory node, allocates the region
+// on the memory node with VirtualAllocExNuma() and measures:
+//
+// - the idle latency of a random pointer chase from one CPU of the CPU node,
+//
+// - read, write, and copy bandwidth with 1, 2, 4, ... up to all logical
+//   CPUs of the CPU node, each thread streaming through its own slice.
+//
+// Then it runs all CPUs of all nodes at once, each reading its own slice of
+// one shared region, with three placements of that region:
+//
+// - first touch, where every thread initializes its own slice, so the pages
+//   land on its node,
+// - serial init, where one thread initializes everything, the common mistake
+//   that puts all the pages on one node,
+// - interleaved, where the region is allocated in 64 KB chunks that
+//   alternate between the nodes.
+//
+// On a machine with one node this still measures the 1x1 matrix and the
+// thread scaling, and the three placements come out the same.
+//
+// Usage: numa [-csv] [-mb N]
+//
+//   -csv   print machine-readable comma-separated records only
+//   -mb    size of the region in megabytes (default 256)
+//
+// The -csv records are:
+//
+//   node,node,logical CPUs,available bytes
+//   latency,CPU node,memory node,ns per load
+//   bandwidth,CPU node,memory node,threads,read GB/s,write GB/s,copy GB/s
+//   placement,placement,threads,read GB/s
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <intrin.h>
+
+#define LINE_BYTES    (64)
+#define CHASE_LOADS   (4 * 1024 * 1024)
+#define PASSES        (3)              // timed passes over the region, after one untimed
+#define CHUNK_BYTES   (64 * 1024)      // interleave granularity
+#define MAX_CPUS      (256)
+#define MAX_NODES     (64)
+
+bool CsvOutput = false;
+
+typedef struct CPU_ENTRY
+{
+    WORD   Group;
+    BYTE   Number;
+    USHORT Node;
+} CPU_ENTRY;
+
+CPU_ENTRY Cpus[MAX_CPUS];
+uint32_t CpuCount = 0;
+
+typedef struct NODE_ENTRY
+{
+    uint32_t  Cpus[MAX_CPUS];          // indexes into Cpus[]
+    uint32_t  CpuCount;
+    ULONGLONG AvailableBytes;
+} NODE_ENTRY;
+
+NODE_ENTRY Nodes[MAX_NODES];
+uint32_t NodeCount = 0;
+
+bool PinToCpu(uint32_t Index)
+{
+    GROUP_AFFINITY Affinity = { 0 };
+
+    Affinity.Group = Cpus[Index].Group;
+    Affinity.Mask = (KAFFINITY)1 << Cpus[Index].Number;
+
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+        return false;
+
+    SwitchToThread();
+    return true;
+}
+
+//
+// Every logical CPU is put on the list of its node.  Nodes without CPUs,
+// such as CXL memory expanders, are kept, since they are still memory
+// nodes that the CPU nodes can be measured against.
+//
+
+void EnumerateNodes()
+{
+    ULONG Highest = 0;
+
+    GetNumaHighestNodeNumber(&Highest);
+    NodeCount = min(MAX_NODES, Highest + 1);
+
+    for (uint32_t n = 0; n < NodeCount; n++)
+        GetNumaAvailableMemoryNodeEx((USHORT)n, &Nodes[n].AvailableBytes);
+
+    WORD Groups = GetActiveProcessorGroupCount();
+
+    for (WORD Group = 0; Group < Groups; Group++)
+    {
+        DWORD Count = GetActiveProcessorCount(Group);
+
+        for (DWORD Number = 0; (Number < Count) && (CpuCount < MAX_CPUS); Number++)
+        {
+            PROCESSOR_NUMBER Processor = { 0 };
+            USHORT Node = 0;
+
+            Processor.Group = Group;
+            Processor.Number = (BYTE)Number;
+
+            if (!GetNumaProcessorNodeEx(&Processor, &Node) || (Node >= NodeCount))
+                Node = 0;
+
+            Cpus[CpuCount].Group = Group;
+            Cpus[CpuCount].Number = (BYTE)Number;
+            Cpus[CpuCount].Node = Node;
+
+            Nodes[Node].Cpus[Nodes[Node].CpuCount++] = CpuCount;
+            CpuCount++;
+        }
+    }
+}
+
+double NowNs()
+{
+    LARGE_INTEGER Freq, Now;
+
+    QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&Now);
+
+    return (double)Now.QuadPart * 1e9 / (double)Freq.QuadPart;
+}
+
+//
+// The streaming kernels.  Copy moves the first half of the slice to the
+// second half, and counts both the bytes read and the bytes written.
+//
+
+typedef enum STREAM_OP
+{
+    OP_READ,
+    OP_WRITE,
+    OP_COPY,
+} STREAM_OP;
+
+uint64_t StreamRead(const uint64_t *p, size_t Bytes)
+{
+    uint64_t Sum0 = 0, Sum1 = 0, Sum2 = 0, Sum3 = 0;
+
+    for (size_t i = 0; i < Bytes / sizeof(uint64_t); i += 4)
+    {
+        Sum0 += p[i + 0];
+        Sum1 += p[i + 1];
+        Sum2 += p[i + 2];
+        Sum3 += p[i + 3];
+    }
+
+    return Sum0 + Sum1 + Sum2 + Sum3;
+}
+
+void StreamWrite(uint64_t *p, size_t Bytes, uint64_t Value)
+{
+    for (size_t i = 0; i < Bytes / sizeof(uint64_t); i++)
+        p[i] = Value;
+}
+
+typedef struct WORKER
+{
+    uint32_t       Cpu;
+    STREAM_OP      Op;
+    uint32_t       Passes;
+    uint8_t       *Slice;
+    size_t         Bytes;
+    volatile LONG *Ready;
+    volatile LONG *Go;
+    uint64_t       Sum;
+} WORKER;
+
+DWORD WINAPI WorkerProc(LPVOID Param)
+{
+    WORKER *Worker = (WORKER *)Param;
+
+    PinToCpu(Worker->Cpu);
+    _InterlockedIncrement(Worker->Ready);
+
+    while (*Worker->Go == 0)
+        YieldProcessor();
+
+    for (uint32_t p = 0; p < Worker->Passes; p++)
+    {
+        switch (Worker->Op)
+            {
+        case OP_READ:
+            Worker->Sum += StreamRead((const uint64_t *)Worker->Slice, Worker->Bytes);
+            break;
+
+        case OP_WRITE:
+            StreamWrite((uint64_t *)Worker->Slice, Worker->Bytes, p);
+            break;
+
+        case OP_COPY:
+            memcpy(Worker->Slice + Worker->Bytes / 2, Worker->Slice, Worker->Bytes / 2);
+            break;
+            }
+    }
+
+    return 0;
+}
+
+WORKER Workers[MAX_CPUS];
+HANDLE Handles[MAX_CPUS];
+
+//
+// Run Op on the given CPUs, each on its own slice of the region, and return
+// the aggregate bandwidth in GB/s.  The clock starts once every thread has
+// pinned itself and stops when the last one is done.
+//
+
+double RunStream(const uint32_t *CpuList, uint32_t Threads, uint8_t *Region, size_t Bytes, STREAM_OP Op, uint32_t Passes)
+{
+    volatile LONG Ready = 0;
+    volatile LONG Go = 0;
+    size_t SliceBytes = (Bytes / Threads) & ~(size_t)(CHUNK_BYTES - 1);
+    uint32_t Count = 0;
+
+    for (uint32_t t = 0; t < Threads; t++)
+    {
+        WORKER *Worker = &Workers[t];
+
+        memset(Worker, 0, sizeof(*Worker));
+        Worker->Cpu = CpuList[t];
+        Worker->Op = Op;
+        Worker->Passes = Passes;
+        Worker->Slice = Region + t * SliceBytes;
+        Worker->Bytes = SliceBytes;
+        Worker->Ready = &Ready;
+        Worker->Go = &Go;
+
+        Handles[Count] = CreateThread(NULL, 0, WorkerProc, Worker, 0, NULL);
+
+        if (Handles[Count] == NULL)
+        {
+            printf("CreateThread failed with error %u\n", GetLastError());
+            break;
+        }
+
+        Count++;
+    }
+
+    while (Ready < (LONG)Count)
+        SwitchToThread();
+
+    double Start = NowNs();
+    Go = 1;
+
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        WaitForSingleObject(Handles[i], INFINITE);
+        CloseHandle(Handles[i]);
+    }
+
+    double Ns = NowNs() - Start;
+
+    return (double)SliceBytes * Count * Passes / Ns;
+}
+
+void BuildChase(uint8_t *Region, size_t Bytes)
+{
+    uint32_t Lines = (uint32_t)(Bytes / LINE_BYTES);
+    uint64_t Seed = 12345;
+
+    for (uint32_t i = 0; i < Lines; i++)
+        *(uint32_t *)(Region + (size_t)i * LINE_BYTES) = i;
+
+    for (uint32_t i = Lines - 1; i > 0; i--)
+    {
+        Seed = Seed * 6364136223846793005ull + 1442695040888963407ull;
+
+        uint32_t j = (uint32_t)((Seed >> 33) % i);
+        uint32_t *pi = (uint32_t *)(Region + (size_t)i * LINE_BYTES);
+        uint32_t *pj = (uint32_t *)(Region + (size_t)j * LINE_BYTES);
+        uint32_t Temp = *pi;
+
+        *pi = *pj;
+        *pj = Temp;
+    }
+}
+
+volatile uint64_t Sink;
+
+double MeasureChase(uint8_t *Region)
+{
+    uint32_t Index = 0;
+
+    for (uint32_t i = 0; i < CHASE_LOADS / 4; i++)
+        Index = *(uint32_t *)(Region + (size_t)Index * LINE_BYTES);
+
+    double Start = NowNs();
+
+    for (uint32_t i = 0; i < CHASE_LOADS; i++)
+        Index = *(uint32_t *)(Region + (size_t)Index * LINE_BYTES);
+
+    double Ns = NowNs() - Start;
+
+    Sink = Index;
+
+    return Ns / CHASE_LOADS;
+}
+
+//
+// One CPU node against one memory node.  The bandwidth is measured at
+// every power of two number of threads and at all CPUs of the node.
+//
+
+void MeasurePair(uint32_t CpuNode, uint32_t MemNode, size_t Bytes)
+{
+    uint8_t *Region = (uint8_t *)VirtualAllocExNuma(GetCurrentProcess(), NULL, Bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE, MemNode);
+
+    if (Region == NULL)
+    {
+        if (!CsvOutput)
+            printf("VirtualAllocExNuma of %u MB on node %u failed with error %u\n", (uint32_t)(Bytes >> 20), MemNode, GetLastError());
+
+        return;
+    }
+
+    const NODE_ENTRY *Node = &Nodes[CpuNode];
+
+    PinToCpu(Node->Cpus[0]);
+    BuildChase(Region, Bytes);
+
+    double LatencyNs = MeasureChase(Region);
+
+    if (CsvOutput)
+        printf("latency,%u,%u,%.1f\n", CpuNode, MemNode, LatencyNs);
+    else
+        printf("\nCPU node %u, memory node %u: idle latency %.1f ns\n", CpuNode, MemNode, LatencyNs);
+
+    for (uint32_t Threads = 1; ; Threads = min(Threads * 2, Node->CpuCount))
+    {
+        RunStream(Node->Cpus, Threads, Region, Bytes, OP_WRITE, 1);
+
+        double ReadGBs  = RunStream(Node->Cpus, Threads, Region, Bytes, OP_READ,  PASSES);
+        double WriteGBs = RunStream(Node->Cpus, Threads, Region, Bytes, OP_WRITE, PASSES);
+        double CopyGBs  = RunStream(Node->Cpus, Threads, Region, Bytes, OP_COPY,  PASSES);
+
+        if (CsvOutput)
+            printf("bandwidth,%u,%u,%u,%.2f,%.2f,%.2f\n", CpuNode, MemNode, Threads, ReadGBs, WriteGBs, CopyGBs);
+        else
+            printf("  %3u threads %10.2f %10.2f %10.2f GB/s read, write, copy\n", Threads, ReadGBs, WriteGBs, CopyGBs);
+
+        if (Threads == Node->CpuCount)
+            break;
+    }
+
+    VirtualFree(Region, 0, MEM_RELEASE);
+}
+
+//
+// Committing part of a reserved region ignores the node passed to
+// VirtualAllocExNuma(), so the interleaved region is reserved as a
+// placeholder and each chunk is split off it and replaced by an allocation
+// of its own on its node.  That keeps the region contiguous for the slices.
+//
+
+void FreeInterleaved(uint8_t *Region, size_t Bytes)
+{
+    MEMORY_BASIC_INFORMATION Info;
+
+    // one allocation per chunk, then what is left of the placeholder
+
+    for (size_t Offset = 0; Offset < Bytes; Offset += Info.RegionSize)
+    {
+        if (VirtualQuery(Region + Offset, &Info, sizeof(Info)) == 0)
+            break;
+
+        VirtualFree(Region + Offset, 0, MEM_RELEASE);
+    }
+}
+
+uint8_t *AllocateInterleaved(size_t Bytes)
+{
+    uint8_t *Region = (uint8_t *)VirtualAlloc2(GetCurrentProcess(), NULL, Bytes, MEM_RESERVE | MEM_RESERVE_PLACEHOLDER, PAGE_NOACCESS, NULL, 0);
+
+    if (Region == NULL)
+        return NULL;
+
+    for (size_t Offset = 0; Offset < Bytes; Offset += CHUNK_BYTES)
+    {
+        MEM_EXTENDED_PARAMETER Parameter = { 0 };
+        Parameter.Type = MemExtendedParameterNumaNode;
+        Parameter.ULong = (DWORD)((Offset / CHUNK_BYTES) % NodeCount);
+
+        // the last chunk is the whole remaining placeholder and needs no split
+
+        bool Split = (Offset + CHUNK_BYTES >= Bytes) ||
+            VirtualFree(Region + Offset, CHUNK_BYTES, MEM_RELEASE | MEM_PRESERVE_PLACEHOLDER);
+
+        if (!Split || (VirtualAlloc2(GetCurrentProcess(), Region + Offset, CHUNK_BYTES, MEM_RESERVE | MEM_COMMIT | MEM_REPLACE_PLACEHOLDER, PAGE_READWRITE, &Parameter, 1) == NULL))
+        {
+            DWORD Error = GetLastError();
+            FreeInterleaved(Region, Bytes);
+            SetLastError(Error);
+            return NULL;
+        }
+    }
+
+    return Region;
+}
+
+//
+// All CPUs read their own slice of one region.  Plain VirtualAlloc() leaves
+// the placement to the first touch, which is either parallel or serial, and
+// the interleaved region is allocated chunk by chunk on alternating nodes.
+//
+
+typedef enum PLACEMENT
+{
+    PLACE_FIRST_TOUCH,
+    PLACE_SERIAL_INIT,
+    PLACE_INTERLEAVED,
+} PLACEMENT;
+
+const char *PlacementNames[] = { "first touch", "serial init", "interleaved" };
+
+void MeasurePlacement(PLACEMENT Placement, size_t Bytes)
+{
+    static uint32_t AllCpus[MAX_CPUS];
+    uint8_t *Region = NULL;
+
+    // each node's CPUs together, so that the slices of a node are adjacent
+
+    uint32_t Count = 0;
+
+    for (uint32_t n = 0; n < NodeCount; n++)
+    {
+        for (uint32_t c = 0; c < Nodes[n].CpuCount; c++)
+            AllCpus[Count++] = Nodes[n].Cpus[c];
+    }
+
+    if (Placement == PLACE_INTERLEAVED)
+        Region = AllocateInterleaved(Bytes);
+    else
+        Region = (uint8_t *)VirtualAlloc(NULL, Bytes, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+
+    if (Region == NULL)
+    {
+        if (!CsvOutput)
+            printf("allocation of %u MB failed with error %u\n", (uint32_t)(Bytes >> 20), GetLastError());
+
+        return;
+    }
+
+    if (Placement == PLACE_FIRST_TOUCH)
+        RunStream(AllCpus, Count, Region, Bytes, OP_WRITE, 1);
+    else
+        RunStream(AllCpus, 1, Region, Bytes, OP_WRITE, 1);
+
+    double ReadGBs = RunStream(AllCpus, Count, Region, Bytes, OP_READ, PASSES);
+
+    if (CsvOutput)
+        printf("placement,%s,%u,%.2f\n", PlacementNames[Placement], Count, ReadGBs);
+    else
+        printf("%-12s %4u threads %10.2f GB/s read\n", PlacementNames[Placement], Count, ReadGBs);
+
+    if (Placement == PLACE_INTERLEAVED)
+        FreeInterleaved(Region, Bytes);
+    else
+        VirtualFree(Region, 0, MEM_RELEASE);
+}
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t Mb = 256;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-mb") && (i + 1 < argc))
+        {
+            // min() and max() evaluate their arguments twice
+            Mb = strtoul(argv[++i], NULL, 0);
+            Mb = max(16, Mb);
+        }
+        else
+        {
+            printf("Usage: numa [-csv] [-mb N]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86
+    // leave the 32-bit address space some room
+    Mb = min(512, Mb);
+#endif
+
+    size_t Bytes = (size_t)Mb * 1024 * 1024;
+
+    EnumerateNodes();
+
+    if (!CsvOutput)
+        printf("\nNUMA nodes: %u, logical CPUs: %u, region: %u MB\n\n", NodeCount, CpuCount, Mb);
+
+    for (uint32_t n = 0; n < NodeCount; n++)
+    {
+        if (CsvOutput)
+            printf("node,%u,%u,%llu\n", n, Nodes[n].CpuCount, Nodes[n].AvailableBytes);
+        else
+            printf("node %2u: %3u logical CPUs, %8.1f GB available\n", n, Nodes[n].CpuCount, Nodes[n].AvailableBytes / 1e9);
+    }
+
+    for (uint32_t c = 0; c < NodeCount; c++)
+    {
+        if (Nodes[c].CpuCount == 0)
+            continue;
+
+        for (uint32_t m = 0; m < NodeCount; m++)
+        {
+            if (Nodes[m].AvailableBytes < Bytes)
+            {
+                if (!CsvOutput)
+                    printf("\nCPU node %u, memory node %u: skipped, not enough memory available\n", c, m);
+
+                continue;
+            }
+
+            MeasurePair(c, m, Bytes);
+        }
+    }
+
+    if (!CsvOutput)
+        printf("\nAll CPUs reading their own slice, by placement of the region:\n\n");
+
+    for (uint32_t p = PLACE_FIRST_TOUCH; p <= PLACE_INTERLEAVED; p++)
+        MeasurePlacement((PLACEMENT)p, Bytes);
+
+    return 0;
+}
+
@@ -0,0 +1,455 @@
+
+//
+// PREFETCH.C
+//
+// Software prefetch efficacy probe: PREFETCHT0/T1/T2/NTA and PREFETCHW.
+//
+// CPUIDEX shows the PREFETCHW bit, but not whether the prefetch hints do
+// anything.  Depending on the microarchitecture they help, do nothing
+// because the hardware prefetchers already got there, or hurt by wasting
+// load slots, and emulators often drop them entirely.  This runs three
+// access patterns over a working set far larger than the caches:
+//
+// - strided, one 8-byte read every 256 bytes, which the hardware prefetchers
+//   should already handle,
+// - a pointer chase through a random cycle of 64-byte nodes, where each node
+//   also has a jump pointer to the node the given distance ahead, which is
+//   what gets prefetched,
+// - a gather, summing table elements at random indices as in a hash join
+//   probe, prefetching the element the given distance ahead.
+//
+// Each pattern runs without prefetching and with each hint at distances of
+// 1 to 64 elements, and the speedup over no prefetching is reported along
+// with the best hint and distance.  PREFETCHW is only timed when CPUID
+// reports it.
+//
+// Usage: prefetch [-csv] [-mb N]
+//
+//   -csv   print machine-readable comma-separated records only
+//   -mb    size of the working set in megabytes (default 256)
+//
+// The -csv records are:
+//
+//   baseline,pattern,ns per element
+//   speedup,pattern,hint,distance,ns per element,speedup
+//   best,pattern,hint,distance,speedup
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define STRIDE        (256)
+#define ELEMENTS      (2 * 1024 * 1024)    // elements visited per chase or gather run
+#define MAX_DISTANCE  (64)
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+bool CsvOutput = false;
+double TscPerNs = 0.0;
+
+const uint32_t Distances[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+#define DISTANCES (sizeof(Distances) / sizeof(Distances[0]))
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool Has3DPREF()    { return LookUpRegBit(0x80000001, 0, CPUID_ECX,  8); }  // PREFETCHW
+bool HasAlways()    { return true; }
+
+//
+// A chase node fills one cache line.  Jump points Distance nodes ahead on
+// the cycle and is rewritten for every distance.
+//
+
+typedef struct NODE
+{
+    struct NODE *Next;
+    struct NODE *Jump;
+    uint64_t     Payload;
+    uint64_t     Padding[5];
+} NODE;
+
+uint8_t  *Strided = NULL;              // Elements * STRIDE bytes
+NODE     *Nodes = NULL;
+uint32_t *Order = NULL;                // the nodes in cycle order
+uint64_t *Table = NULL;
+uint32_t *Indices = NULL;              // ELEMENTS + MAX_DISTANCE random table indices
+
+uint32_t StridedCount = 0;
+uint32_t NodeCount = 0;
+uint32_t TableCount = 0;
+
+//
+// Each hint gets one loop per pattern, generated by a macro because the
+// hint of _mm_prefetch() has to be a constant.  Distance 0 means no
+// prefetch at all and is the baseline.
+//
+
+#define PATTERN_LOOPS(Name, Prefetch)                                       \
+                                                                            \
+uint64_t Name##Strided(uint32_t Distance)                                   \
+{                                                                           \
+    uint64_t Sum = 0;                                                       \
+                                                                            \
+    for (uint32_t i = 0; i < StridedCount; i++)                             \
+    {                                                                       \
+        if (Distance != 0)                                                  \
+            Prefetch(Strided + (size_t)(i + Distance) * STRIDE);            \
+                                                                            \
+        Sum += *(uint64_t *)(Strided + (size_t)i * STRIDE);                 \
+    }                                                                       \
+                                                                            \
+    return Sum;                                                             \
+}                                                                           \
+                                                                            \
+uint64_t Name##Chase(uint32_t Distance)                                     \
+{                                                                           \
+    const NODE *Node = &Nodes[Order[0]];                                    \
+    uint64_t Sum = 0;                                                       \
+                                                                            \
+    for (uint32_t i = 0; i < ELEMENTS; i++)                                 \
+    {                                                                       \
+        if (Distance != 0)                                                  \
+            Prefetch(Node->Jump);                                           \
+                                                                            \
+        Sum += Node->Payload;                                               \
+        Node = Node->Next;                                                  \
+    }                                                                       \
+                                                                            \
+    return Sum;                                                             \
+}                                                                           \
+                                                                            \
+uint64_t Name##Gather(uint32_t Distance)                                    \
+{                                                                           \
+    uint64_t Sum = 0;                                                       \
+                                                                            \
+    for (uint32_t i = 0; i < ELEMENTS; i++)                                 \
+    {                                                                       \
+        if (Distance != 0)                                                  \
+            Prefetch(&Table[Indices[i + Distance]]);                        \
+                                                                            \
+        Sum += Table[Indices[i]];                                           \
+    }                                                                       \
+                                                                            \
+    return Sum;                                                             \
+}
+
+#define PREFETCH_T0(p)    _mm_prefetch((const char *)(p), _MM_HINT_T0)
+#define PREFETCH_T1(p)    _mm_prefetch((const char *)(p), _MM_HINT_T1)
+#define PREFETCH_T2(p)    _mm_prefetch((const char *)(p), _MM_HINT_T2)
+#define PREFETCH_NTA(p)   _mm_prefetch((const char *)(p), _MM_HINT_NTA)
+#define PREFETCH_W(p)     _m_prefetchw((void *)(p))
+
+PATTERN_LOOPS(T0,  PREFETCH_T0)
+PATTERN_LOOPS(T1,  PREFETCH_T1)
+PATTERN_LOOPS(T2,  PREFETCH_T2)
+PATTERN_LOOPS(Nta, PREFETCH_NTA)
+PATTERN_LOOPS(W,   PREFETCH_W)
+
+typedef uint64_t (LOOP)(uint32_t Distance);
+
+typedef struct HINT
+{
+    const char *Name;
+    bool      (*IsPresent)(void);
+    LOOP       *Strided;
+    LOOP       *Chase;
+    LOOP       *Gather;
+} HINT;
+
+const HINT Hints[] =
+{
+    { "T0",  HasAlways, T0Strided,  T0Chase,  T0Gather  },
+    { "T1",  HasAlways, T1Strided,  T1Chase,  T1Gather  },
+    { "T2",  HasAlways, T2Strided,  T2Chase,  T2Gather  },
+    { "NTA", HasAlways, NtaStrided, NtaChase, NtaGather },
+    { "W",   Has3DPREF, WStrided,   WChase,   WGather   },
+};
+
+#define HINTS (sizeof(Hints) / sizeof(Hints[0]))
+
+typedef enum PATTERN
+{
+    PATTERN_STRIDED,
+    PATTERN_CHASE,
+    PATTERN_GATHER,
+} PATTERN;
+
+const char *PatternNames[] = { "strided", "chase", "gather" };
+
+double CalibrateTscPerNs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return (double)(TscStop - TscStart) / Ns;
+}
+
+uint64_t Seed = 12345;
+
+uint32_t NextRandom()
+{
+    Seed = Seed * 6364136223846793005ull + 1442695040888963407ull;
+
+    return (uint32_t)(Seed >> 32);
+}
+
+//
+// Link the nodes into one random cycle with Sattolo's algorithm, and
+// remember the cycle order so that the jump pointers can be set for any
+// distance.
+//
+
+void BuildChase()
+{
+    for (uint32_t i = 0; i < NodeCount; i++)
+        Order[i] = i;
+
+    for (uint32_t i = NodeCount - 1; i > 0; i--)
+    {
+        uint32_t j = NextRandom() % i;
+        uint32_t Temp = Order[i];
+
+        Order[i] = Order[j];
+        Order[j] = Temp;
+    }
+
+    for (uint32_t k = 0; k < NodeCount; k++)
+    {
+        NODE *Node = &Nodes[Order[k]];
+
+        Node->Next = &Nodes[Order[(k + 1) % NodeCount]];
+        Node->Jump = Node->Next;
+        Node->Payload = k;
+    }
+}
+
+void SetJumpDistance(uint32_t Distance)
+{
+    for (uint32_t k = 0; k < NodeCount; k++)
+        Nodes[Order[k]].Jump = &Nodes[Order[(k + Distance) % NodeCount]];
+}
+
+volatile uint64_t Sink;
+
+double TimeLoop(LOOP *Loop, uint32_t Distance, uint32_t Elements)
+{
+    uint64_t Start = __rdtsc();
+    Sink = (*Loop)(Distance);
+    uint64_t Ticks = __rdtsc() - Start;
+
+    return (double)Ticks / TscPerNs / Elements;
+}
+
+LOOP *PatternLoop(const HINT *Hint, PATTERN Pattern)
+{
+    switch (Pattern)
+        {
+    case PATTERN_STRIDED:
+        return Hint->Strided;
+
+    case PATTERN_CHASE:
+        return Hint->Chase;
+
+    default:
+        return Hint->Gather;
+        }
+}
+
+void MeasurePattern(PATTERN Pattern)
+{
+    uint32_t Elements = (Pattern == PATTERN_STRIDED) ? StridedCount : ELEMENTS;
+    const char *Name = PatternNames[Pattern];
+
+    // the loops of every hint are the same without a prefetch
+
+    TimeLoop(PatternLoop(&Hints[0], Pattern), 0, Elements);
+    double BaseNs = TimeLoop(PatternLoop(&Hints[0], Pattern), 0, Elements);
+
+    double BestSpeedup = 0.0;
+    uint32_t BestHint = 0, BestDistance = 0;
+
+    if (CsvOutput)
+    {
+        printf("baseline,%s,%.2f\n", Name, BaseNs);
+    }
+    else
+    {
+        printf("\n%s, %.2f ns per element without prefetch, speedup with:\n\n", Name, BaseNs);
+        printf("%8s", "distance");
+
+        for (uint32_t h = 0; h < HINTS; h++)
+            printf(" %8s", Hints[h].Name);
+
+        printf("\n");
+    }
+
+    for (uint32_t d = 0; d < DISTANCES; d++)
+    {
+        uint32_t Distance = Distances[d];
+
+        if (Pattern == PATTERN_CHASE)
+            SetJumpDistance(Distance);
+
+        if (!CsvOutput)
+            printf("%8u", Distance);
+
+        for (uint32_t h = 0; h < HINTS; h++)
+        {
+            if (!(*Hints[h].IsPresent)())
+            {
+                if (!CsvOutput)
+                    printf(" %8s", "absent");
+
+                continue;
+            }
+
+            double Ns = TimeLoop(PatternLoop(&Hints[h], Pattern), Distance, Elements);
+            double Speedup = BaseNs / Ns;
+
+            if (Speedup > BestSpeedup)
+            {
+                BestSpeedup = Speedup;
+                BestHint = h;
+                BestDistance = Distance;
+            }
+
+            if (CsvOutput)
+                printf("speedup,%s,%s,%u,%.2f,%.3f\n", Name, Hints[h].Name, Distance, Ns, Speedup);
+            else
+                printf(" %7.2fx", Speedup);
+        }
+
+        if (!CsvOutput)
+            printf("\n");
+    }
+
+    if (CsvOutput)
+        printf("best,%s,%s,%u,%.3f\n", Name, Hints[BestHint].Name, BestDistance, BestSpeedup);
+    else if (BestSpeedup > 1.05)
+        printf("best: %s at distance %u, %.2fx\n", Hints[BestHint].Name, BestDistance, BestSpeedup);
+    else
+        printf("best: no prefetch, no hint is more than 5%% faster\n");
+}
+
+#endif // _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t Mb = 256;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-mb") && (i + 1 < argc))
+        {
+            // min() and max() evaluate their arguments twice
+            Mb = strtoul(argv[++i], NULL, 0);
+            Mb = max(16, Mb);
+        }
+        else
+        {
+            printf("Usage: prefetch [-csv] [-mb N]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+#if _M_IX86
+    // leave the 32-bit address space some room
+    Mb = min(512, Mb);
+#endif
+
+    size_t Bytes = (size_t)Mb * 1024 * 1024;
+
+    StridedCount = (uint32_t)(Bytes / STRIDE) - MAX_DISTANCE;
+    NodeCount = (uint32_t)(Bytes / sizeof(NODE));
+    TableCount = (uint32_t)(Bytes / sizeof(uint64_t));
+
+    Strided = (uint8_t *)VirtualAlloc(NULL, Bytes, MEM_COMMIT, PAGE_READWRITE);
+    Nodes = (NODE *)VirtualAlloc(NULL, Bytes, MEM_COMMIT, PAGE_READWRITE);
+    Order = (uint32_t *)VirtualAlloc(NULL, NodeCount * sizeof(uint32_t), MEM_COMMIT, PAGE_READWRITE);
+    Table = (uint64_t *)VirtualAlloc(NULL, Bytes, MEM_COMMIT, PAGE_READWRITE);
+    Indices = (uint32_t *)VirtualAlloc(NULL, (ELEMENTS + MAX_DISTANCE) * sizeof(uint32_t), MEM_COMMIT, PAGE_READWRITE);
+
+    if ((Strided == NULL) || (Nodes == NULL) || (Order == NULL) || (Table == NULL) || (Indices == NULL))
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    for (size_t i = 0; i < Bytes / sizeof(uint64_t); i++)
+    {
+        ((uint64_t *)Strided)[i] = i;
+        Table[i] = i;
+    }
+
+    for (uint32_t i = 0; i < ELEMENTS + MAX_DISTANCE; i++)
+        Indices[i] = NextRandom() % TableCount;
+
+    BuildChase();
+
+    TscPerNs = CalibrateTscPerNs();
+
+    if (!CsvOutput)
+        printf("\nSoftware prefetch over a %u MB working set per pattern.\n", Mb);
+
+    MeasurePattern(PATTERN_STRIDED);
+    MeasurePattern(PATTERN_CHASE);
+    MeasurePattern(PATTERN_GATHER);
+
+    VirtualFree(Strided, 0, MEM_RELEASE);
+    VirtualFree(Nodes, 0, MEM_RELEASE);
+    VirtualFree(Order, 0, MEM_RELEASE);
+    VirtualFree(Table, 0, MEM_RELEASE);
+    VirtualFree(Indices, 0, MEM_RELEASE);
+
+#else
+
+    printf("This probe uses x86 prefetch instructions, run the x64 build to test the emulator on ARM64.\n");
+
+#endif
+
+    return 0;
+}
+
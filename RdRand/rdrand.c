@@ -0,0 +1,384 @@
+
+//
+// RDRAND.C
+//
+// RDRAND and RDSEED latency, throughput, and contention benchmark.
+//
+// CPUIDEX.C shows whether RDRAND and RDSEED are present, but not what they
+// cost.  Both are implemented in microcode that talks to a single shared
+// random number generator per package, so they are slow, they serialize
+// across cores, and they can fail (return with CF clear) when the entropy
+// source is drained.  Some hypervisors also trap them.  This measures the
+// per-call latency distribution of each width on one thread, then the
+// sustained rate from 1 to N threads along with how often a call failed and
+// had to be retried, and compares both with BCryptGenRandom(), which is what
+// Windows code is expected to use instead.
+//
+// Usage: rdrand [-csv] [-ms N]
+//
+//   -csv   print machine-readable comma-separated records only
+//   -ms    duration of each throughput measurement (default 200)
+//
+// The -csv records are:
+//
+//   latency,source,bits,p50 ns,p90 ns,p99 ns,p99.9 ns,max ns,failures
+//   throughput,source,bits,threads,calls/s,MB/s,failures,retries,exhausted
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <bcrypt.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define SAMPLES       (10000)
+#define RETRY_LIMIT   (10)             // Intel's recommended number of RDRAND retries
+#define MAX_THREADS   (256)
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+bool CsvOutput = false;
+double TscPerNs = 0.0;
+
+//
+// Each source returns one random value and 1 on success, 0 if the
+// instruction returned with CF clear or the call failed.
+//
+
+typedef int (STEP)(uint64_t *Value);
+
+int StepBCrypt(uint64_t *Value)
+{
+    return BCRYPT_SUCCESS(BCryptGenRandom(NULL, (PUCHAR)Value, sizeof(*Value), BCRYPT_USE_SYSTEM_PREFERRED_RNG));
+}
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool HasRDRAND()   { return LookUpRegBit(1, 0, CPUID_ECX, 30); }
+bool HasRDSEED()   { return LookUpRegBit(7, 0, CPUID_EBX, 18); }
+
+int StepRdRand16(uint64_t *Value) { unsigned short v = 0; int Ok = _rdrand16_step(&v); *Value = v; return Ok; }
+int StepRdRand32(uint64_t *Value) { unsigned int   v = 0; int Ok = _rdrand32_step(&v); *Value = v; return Ok; }
+int StepRdSeed16(uint64_t *Value) { unsigned short v = 0; int Ok = _rdseed16_step(&v); *Value = v; return Ok; }
+int StepRdSeed32(uint64_t *Value) { unsigned int   v = 0; int Ok = _rdseed32_step(&v); *Value = v; return Ok; }
+
+#if _M_AMD64
+int StepRdRand64(uint64_t *Value) { unsigned __int64 v = 0; int Ok = _rdrand64_step(&v); *Value = v; return Ok; }
+int StepRdSeed64(uint64_t *Value) { unsigned __int64 v = 0; int Ok = _rdseed64_step(&v); *Value = v; return Ok; }
+#endif
+
+#else
+
+bool HasRDRAND()   { return false; }
+bool HasRDSEED()   { return false; }
+
+#endif
+
+bool HasBCrypt()   { return true; }
+
+typedef struct SOURCE
+{
+    const char *Name;
+    uint32_t    Bits;
+    STEP       *Step;
+    bool      (*IsPresent)(void);
+} SOURCE;
+
+const SOURCE Sources[] =
+{
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+    { "RDRAND",  16, StepRdRand16, HasRDRAND },
+    { "RDRAND",  32, StepRdRand32, HasRDRAND },
+#if _M_AMD64
+    { "RDRAND",  64, StepRdRand64, HasRDRAND },
+#endif
+    { "RDSEED",  16, StepRdSeed16, HasRDSEED },
+    { "RDSEED",  32, StepRdSeed32, HasRDSEED },
+#if _M_AMD64
+    { "RDSEED",  64, StepRdSeed64, HasRDSEED },
+#endif
+#endif
+    { "BCrypt",  64, StepBCrypt,   HasBCrypt },
+};
+
+#define SOURCES (sizeof(Sources) / sizeof(Sources[0]))
+
+double CalibrateTscPerNs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return (double)(TscStop - TscStart) / Ns;
+}
+
+int __cdecl CompareTicks(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+//
+// Single-threaded latency distribution, timing every call individually.
+//
+
+void MeasureLatency(const SOURCE *Source)
+{
+    static uint64_t Ticks[SAMPLES];
+    uint32_t Failures = 0;
+    uint64_t Sum = 0;
+
+    for (uint32_t i = 0; i < SAMPLES; i++)
+    {
+        uint64_t Value = 0;
+
+        uint64_t Start = __rdtsc();
+        int Ok = (*Source->Step)(&Value);
+        Ticks[i] = __rdtsc() - Start;
+
+        Failures += !Ok;
+        Sum += Value;
+    }
+
+    qsort(Ticks, SAMPLES, sizeof(Ticks[0]), CompareTicks);
+
+    double P50  = Ticks[SAMPLES / 2] / TscPerNs;
+    double P90  = Ticks[SAMPLES * 90 / 100] / TscPerNs;
+    double P99  = Ticks[SAMPLES * 99 / 100] / TscPerNs;
+    double P999 = Ticks[SAMPLES * 999 / 1000] / TscPerNs;
+    double Max  = Ticks[SAMPLES - 1] / TscPerNs;
+
+    if (CsvOutput)
+        printf("latency,%s,%u,%.1f,%.1f,%.1f,%.1f,%.1f,%u\n", Source->Name, Source->Bits, P50, P90, P99, P999, Max, Failures);
+    else
+        printf("%-8s %4u %9.1f %9.1f %9.1f %9.1f %10.1f %9u\n", Source->Name, Source->Bits, P50, P90, P99, P999, Max, Failures);
+
+    // the values are summed only so that the calls cannot be discarded
+
+    if (Sum == 1)
+        printf("!");
+}
+
+//
+// Multi-threaded throughput.  Each thread keeps calling for the given time,
+// retrying failed calls up to RETRY_LIMIT times the way callers are
+// supposed to, and counts calls, failures, and retry loops that gave up.
+// Each worker has cache lines of its own so that updating the counts does
+// not move lines between the threads being measured.
+//
+
+typedef struct WORKER
+{
+    __declspec(align(64))
+    const SOURCE  *Source;
+    uint32_t       Ms;
+    volatile LONG *Go;
+    uint64_t       Calls;
+    uint64_t       Failures;
+    uint64_t       Retries;
+    uint64_t       Exhausted;
+    uint64_t       Sum;
+} WORKER;
+
+DWORD WINAPI WorkerProc(LPVOID Param)
+{
+    WORKER *Worker = (WORKER *)Param;
+    STEP *Step = Worker->Source->Step;
+
+    while (!*Worker->Go)
+        YieldProcessor();
+
+    uint64_t Stop = __rdtsc() + (uint64_t)(Worker->Ms * 1e6 * TscPerNs);
+
+    while (__rdtsc() < Stop)
+    {
+        uint64_t Value = 0;
+        uint32_t Tries = 0;
+
+        for (Tries = 0; Tries < RETRY_LIMIT; Tries++)
+        {
+            Worker->Calls++;
+
+            if ((*Step)(&Value))
+                break;
+
+            Worker->Failures++;
+        }
+
+        if (Tries > 0)
+            Worker->Retries++;
+
+        if (Tries == RETRY_LIMIT)
+            Worker->Exhausted++;
+
+        Worker->Sum += Value;
+    }
+
+    return 0;
+}
+
+void MeasureThroughput(const SOURCE *Source, uint32_t Threads, uint32_t Ms)
+{
+    static WORKER Workers[MAX_THREADS];
+    static HANDLE Handles[MAX_THREADS];
+    volatile LONG Go = 0;
+    uint32_t Count = 0;
+
+    for (uint32_t i = 0; i < Threads; i++)
+    {
+        WORKER *Worker = &Workers[i];
+
+        memset(Worker, 0, sizeof(*Worker));
+        Worker->Source = Source;
+        Worker->Ms = Ms;
+        Worker->Go = &Go;
+
+        Handles[Count] = CreateThread(NULL, 0, WorkerProc, Worker, 0, NULL);
+
+        if (Handles[Count] == NULL)
+        {
+            printf("CreateThread failed with error %u\n", GetLastError());
+            break;
+        }
+
+        Count++;
+    }
+
+    Sleep(10);
+    Go = 1;
+
+    WORKER Total = { 0 };
+
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        WaitForSingleObject(Handles[i], INFINITE);
+        CloseHandle(Handles[i]);
+
+        Total.Calls     += Workers[i].Calls;
+        Total.Failures  += Workers[i].Failures;
+        Total.Retries   += Workers[i].Retries;
+        Total.Exhausted += Workers[i].Exhausted;
+    }
+
+    double CallsPerSec = Total.Calls * 1000.0 / Ms;
+    double MBPerSec = (Total.Calls - Total.Failures) * (Source->Bits / 8) / (Ms * 1000.0);
+
+    if (CsvOutput)
+    {
+        printf("throughput,%s,%u,%u,%.0f,%.2f,%llu,%llu,%llu\n", Source->Name, Source->Bits, Count,
+            CallsPerSec, MBPerSec, Total.Failures, Total.Retries, Total.Exhausted);
+    }
+    else
+    {
+        printf("%-8s %4u %7u %12.0f %9.2f %10llu %10llu %10llu\n", Source->Name, Source->Bits, Count,
+            CallsPerSec, MBPerSec, Total.Failures, Total.Retries, Total.Exhausted);
+    }
+}
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t Ms = 200;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-ms") && (i + 1 < argc))
+        {
+            Ms = strtoul(argv[++i], NULL, 0);
+            Ms = max(1, Ms);
+        }
+        else
+        {
+            printf("Usage: rdrand [-csv] [-ms N]\n");
+            return 1;
+        }
+    }
+
+    uint32_t Cpus = GetActiveProcessorCount(ALL_PROCESSOR_GROUPS);
+    Cpus = min(Cpus, MAX_THREADS);
+
+    TscPerNs = CalibrateTscPerNs();
+
+    if (!CsvOutput)
+    {
+        printf("\nRDRAND / RDSEED benchmark, %u logical CPUs, TSC at %.0f MHz.\n", Cpus, TscPerNs * 1000.0);
+
+        if (!HasRDRAND())
+            printf("RDRAND is not present.\n");
+
+        if (!HasRDSEED())
+            printf("RDSEED is not present.\n");
+
+        printf("\nSingle-thread latency of %u calls, in ns:\n\n", SAMPLES);
+        printf("%-8s %4s %9s %9s %9s %9s %10s %9s\n", "source", "bits", "p50", "p90", "p99", "p99.9", "max", "failures");
+    }
+
+    for (uint32_t s = 0; s < SOURCES; s++)
+    {
+        if ((*Sources[s].IsPresent)())
+            MeasureLatency(&Sources[s]);
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\nThroughput over %u ms per test, with up to %u retries per value:\n\n", Ms, RETRY_LIMIT);
+        printf("%-8s %4s %7s %12s %9s %10s %10s %10s\n", "source", "bits", "threads", "calls/s", "MB/s", "failures", "retries", "exhausted");
+    }
+
+    for (uint32_t s = 0; s < SOURCES; s++)
+    {
+        if (!(*Sources[s].IsPresent)())
+            continue;
+
+        // 1, 2, 4, ... threads and then every logical CPU
+
+        for (uint32_t Threads = 1; ; Threads = min(Threads * 2, Cpus))
+        {
+            MeasureThroughput(&Sources[s], Threads, Ms);
+
+            if (Threads == Cpus)
+                break;
+        }
+    }
+
+    return 0;
+}
+
@@ -0,0 +1,366 @@
+
+//
+// SMC.C
+//
+// Self-modifying and cross-modifying code cost probe.
+//
+// VA2.C writes a few bytes of code, write-protects them, and runs them once.
+// This probe instead keeps patching JIT-ed code while it is hot, the way a
+// tracing hook hot-patches function prologues, and measures what each patch
+// costs on top of the steady-state call cost.  Natively that is mostly a
+// pipeline and i-cache flush.  Under x64-on-ARM64 emulation every patch can
+// invalidate the translation of the page and force a retranslation.
+//
+// Usage: smc [-noflush] [-wx] [rate ...]
+//
+//   rate      number of calls between patches (default 1 10 100 1000 10000)
+//   -noflush  do not call FlushInstructionCache() after each patch, which
+//             tests the emulator's own self-modifying code detection
+//   -wx       flip the page RX -> RW -> RX around each patch like a W^X JIT
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define PAGE_BYTES   (4096)
+#define CODE_PAGES   (4)
+
+#define TOTAL_CALLS  (1000000)     // calls per measurement when patching is rare
+#define MAX_PATCHES  (20000)       // upper bound on patches per measurement
+#define MAX_RATES    (16)
+
+typedef uint32_t (PFN)(uint32_t);
+
+bool FlushAfterPatch = true;
+bool FlipProtection = false;
+
+//
+// Each generated function is "return Arg + Imm32".  Patching rewrites the
+// 32-bit immediate, which is the smallest change that alters the code bytes.
+//
+
+#if _M_IX86
+
+#define IMM_OFFSET   (5)
+
+void EmitAddFunction(uint8_t *Code, uint32_t Imm)
+{
+    Code[0] = 0x8B; Code[1] = 0x44; Code[2] = 0x24; Code[3] = 0x04;  // MOV EAX,[ESP+4]
+    Code[4] = 0x05; *(uint32_t *)&Code[5] = Imm;                     // ADD EAX,imm32
+    Code[9] = 0xC3;                                                  // RET
+}
+
+#elif _M_AMD64 || _M_ARM64EC
+
+#define IMM_OFFSET   (3)
+
+void EmitAddFunction(uint8_t *Code, uint32_t Imm)
+{
+    Code[0] = 0x8B; Code[1] = 0xC1;                                  // MOV EAX,ECX
+    Code[2] = 0x05; *(uint32_t *)&Code[3] = Imm;                     // ADD EAX,imm32
+    Code[7] = 0xC3;                                                  // RET
+}
+
+#endif
+
+//
+// Patch the immediate of a generated function, optionally toggling page
+// protection around the write and notifying the OS (and any emulator).
+//
+
+void PatchFunction(uint8_t *Code, uint32_t Imm)
+{
+    DWORD OldProtect = 0;
+
+    if (FlipProtection)
+        VirtualProtect(Code, IMM_OFFSET + 4, PAGE_READWRITE, &OldProtect);
+
+    *(volatile uint32_t *)&Code[IMM_OFFSET] = Imm;
+
+    if (FlipProtection)
+        VirtualProtect(Code, IMM_OFFSET + 4, PAGE_EXECUTE_READ, &OldProtect);
+
+    if (FlushAfterPatch)
+        FlushInstructionCache(GetCurrentProcess(), Code, IMM_OFFSET + 4);
+}
+
+double ElapsedNs(LARGE_INTEGER Start, LARGE_INTEGER Stop)
+{
+    static LARGE_INTEGER Freq;
+
+    if (Freq.QuadPart == 0)
+        QueryPerformanceFrequency(&Freq);
+
+    return (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+}
+
+//
+// Single-threaded measurement: call Hot() Calls times, patching Target every
+// Rate calls.  When Target is Hot itself, also verify that the very next call
+// observes the new immediate, since stale code after a flush is a defect.
+//
+
+typedef struct SMC_RESULT
+{
+    double   NsPerCall;
+    double   NsPerPatch;
+    uint32_t Patches;
+    uint32_t Stale;
+} SMC_RESULT;
+
+SMC_RESULT RunSameThread(uint8_t *Hot, uint8_t *Target, uint32_t Rate, double BaselineNs)
+{
+    SMC_RESULT Result = { 0 };
+    PFN *pfn = (PFN *)(void *)Hot;
+
+    uint32_t Calls = (Rate == 0) ? TOTAL_CALLS : (uint32_t)min(TOTAL_CALLS, (uint64_t)Rate * MAX_PATCHES);
+    uint32_t Imm = 1;
+    uint32_t Total = 0;
+    uint32_t Countdown = Rate;
+
+    LARGE_INTEGER Start, Stop;
+    QueryPerformanceCounter(&Start);
+
+    for (uint32_t i = 0; i < Calls; i++)
+    {
+        Total = (*pfn)(Total);
+
+        if (Rate && (--Countdown == 0))
+        {
+            Countdown = Rate;
+            PatchFunction(Target, ++Imm);
+            Result.Patches++;
+
+            if ((Target == Hot) && ((*pfn)(0) != Imm))
+                Result.Stale++;
+        }
+    }
+
+    QueryPerformanceCounter(&Stop);
+
+    double Ns = ElapsedNs(Start, Stop);
+
+    Result.NsPerCall = Ns / Calls;
+
+    if (Result.Patches)
+        Result.NsPerPatch = (Ns - (BaselineNs * Calls)) / Result.Patches;
+
+    // keep the compiler from discarding the calls
+
+    if (Total == 0xFFFFFFFF)
+        printf("!");
+
+    return Result;
+}
+
+//
+// Cross-modifying measurement: a worker thread keeps calling Target while
+// this thread patches Target every Rate worker calls.
+//
+
+typedef struct WORKER_STATE
+{
+    PFN *pfn;
+    volatile LONG Stop;
+    volatile LONG Ready;
+    volatile LONG Calls;               // 32 bits so that 32-bit code reads it in one go
+    double ElapsedNs;
+} WORKER_STATE;
+
+DWORD WINAPI WorkerProc(LPVOID Param)
+{
+    WORKER_STATE *State = (WORKER_STATE *)Param;
+    uint32_t Total = 0;
+
+    LARGE_INTEGER Start, Stop;
+
+    State->Ready = 1;
+    QueryPerformanceCounter(&Start);
+
+    while (!State->Stop)
+    {
+        Total = (*State->pfn)(Total);
+        State->Calls++;
+    }
+
+    QueryPerformanceCounter(&Stop);
+    State->ElapsedNs = ElapsedNs(Start, Stop);
+
+    return Total;
+}
+
+SMC_RESULT RunCrossThread(uint8_t *Target, uint32_t Rate, double BaselineNs)
+{
+    SMC_RESULT Result = { 0 };
+    WORKER_STATE State = { 0 };
+
+    State.pfn = (PFN *)(void *)Target;
+
+    uint32_t Calls = (Rate == 0) ? TOTAL_CALLS : (uint32_t)min(TOTAL_CALLS, (uint64_t)Rate * MAX_PATCHES);
+    uint32_t Imm = 1;
+
+    HANDLE hThread = CreateThread(NULL, 0, WorkerProc, &State, 0, NULL);
+
+    if (hThread == NULL)
+    {
+        printf("CreateThread failed with error %u\n", GetLastError());
+        return Result;
+    }
+
+    // keep the patching thread and the executing thread on different cores
+
+    SYSTEM_INFO SysInfo;
+    GetSystemInfo(&SysInfo);
+
+    if (SysInfo.dwNumberOfProcessors > 1)
+    {
+        SetThreadAffinityMask(GetCurrentThread(), 1);
+        SetThreadAffinityMask(hThread, 2);
+    }
+
+    while (!State.Ready)
+        _mm_pause();
+
+    uint32_t NextPatch = Rate;
+    uint32_t Done;
+
+    while ((Done = (uint32_t)State.Calls) < Calls)
+    {
+        if (Rate && (Done >= NextPatch))
+        {
+            NextPatch = Done + Rate;
+            PatchFunction(Target, ++Imm);
+            Result.Patches++;
+        }
+        else
+        {
+            _mm_pause();
+        }
+    }
+
+    State.Stop = 1;
+    WaitForSingleObject(hThread, INFINITE);
+    CloseHandle(hThread);
+
+    SetThreadAffinityMask(GetCurrentThread(), SysInfo.dwActiveProcessorMask);
+
+    Result.NsPerCall = State.ElapsedNs / (double)State.Calls;
+
+    if (Result.Patches)
+        Result.NsPerPatch = (State.ElapsedNs - (BaselineNs * (double)State.Calls)) / Result.Patches;
+
+    return Result;
+}
+
+void PrintResult(const char *Scenario, uint32_t Rate, SMC_RESULT *Result)
+{
+    printf("%-16s %8u %10.2f %10u %12.1f", Scenario, Rate, Result->NsPerCall, Result->Patches, Result->NsPerPatch);
+
+    if (Result->Stale)
+        printf("   Warning: %u calls ran stale code after a patch", Result->Stale);
+
+    printf("\n");
+}
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t Rates[MAX_RATES] = { 1, 10, 100, 1000, 10000 };
+    uint32_t RateCount = 5;
+    uint32_t UserRates = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-noflush"))
+            FlushAfterPatch = false;
+        else if (!_stricmp(argv[i], "-wx"))
+            FlipProtection = true;
+        else if ((UserRates < MAX_RATES) && (strtoul(argv[i], NULL, 0) > 0))
+            Rates[UserRates++] = strtoul(argv[i], NULL, 0);
+    }
+
+    if (UserRates)
+        RateCount = UserRates;
+
+#if _M_IX86 || _M_AMD64 || _M_ARM64EC
+
+    // Page 0 holds the hot function plus a cold function sharing its page,
+    // page 1 is the neighbouring page, page 2 is executed by another thread.
+
+    uint8_t *Code = (uint8_t *)VirtualAlloc(NULL, CODE_PAGES * PAGE_BYTES, MEM_COMMIT, PAGE_EXECUTE_READWRITE);
+
+    if (Code == NULL)
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    uint8_t *HotFunc      = Code;
+    uint8_t *SamePageFunc = Code + 256;
+    uint8_t *NextPageFunc = Code + PAGE_BYTES;
+    uint8_t *CrossFunc    = Code + 2 * PAGE_BYTES;
+
+    EmitAddFunction(HotFunc,      1);
+    EmitAddFunction(SamePageFunc, 1);
+    EmitAddFunction(NextPageFunc, 1);
+    EmitAddFunction(CrossFunc,    1);
+
+    DWORD OldProtect = 0;
+
+    if (FlipProtection)
+        VirtualProtect(Code, CODE_PAGES * PAGE_BYTES, PAGE_EXECUTE_READ, &OldProtect);
+
+    FlushInstructionCache(GetCurrentProcess(), Code, CODE_PAGES * PAGE_BYTES);
+
+    printf("Generated code at %p, patches %s flushed%s.\n\n", Code,
+        FlushAfterPatch ? "are" : "are not",
+        FlipProtection ? ", pages flipped RX/RW around each patch" : "");
+
+    // steady-state call cost with no patching, for the same thread and for the worker
+
+    SMC_RESULT Baseline = RunSameThread(HotFunc, HotFunc, 0, 0.0);
+    SMC_RESULT CrossBaseline = RunCrossThread(CrossFunc, 0, 0.0);
+
+    printf("Steady-state call cost      = %10.2f ns\n", Baseline.NsPerCall);
+    printf("Steady-state worker call    = %10.2f ns\n\n", CrossBaseline.NsPerCall);
+
+    printf("%-16s %8s %10s %10s %12s\n", "scenario", "rate", "ns/call", "patches", "ns/patch");
+
+    for (uint32_t r = 0; r < RateCount; r++)
+    {
+        SMC_RESULT Result;
+
+        Result = RunSameThread(HotFunc, HotFunc, Rates[r], Baseline.NsPerCall);
+        PrintResult("same-function", Rates[r], &Result);
+
+        Result = RunSameThread(HotFunc, SamePageFunc, Rates[r], Baseline.NsPerCall);
+        PrintResult("same-page", Rates[r], &Result);
+
+        Result = RunSameThread(HotFunc, NextPageFunc, Rates[r], Baseline.NsPerCall);
+        PrintResult("neighbour-page", Rates[r], &Result);
+
+        // a W^X page cannot be made writable while another thread executes it
+
+        if (!FlipProtection)
+        {
+            Result = RunCrossThread(CrossFunc, Rates[r], CrossBaseline.NsPerCall);
+            PrintResult("cross-modifying", Rates[r], &Result);
+        }
+    }
+
+    VirtualFree(Code, 0, MEM_RELEASE);
+
+#else
+
+    printf("This probe generates x86/x64 code and requires an x86, x64, or ARM64EC build.\n");
+
+#endif
+
+    return 0;
+}
+
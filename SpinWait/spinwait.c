@@ -0,0 +1,592 @@
+
+//
+// SPINWAIT.C
+//
+// Spin-wait primitive latency probe: PAUSE, UMONITOR/UMWAIT, TPAUSE,
+// MONITORX/MWAITX, and MONITOR/MWAIT.
+//
+// CPUIDEX shows the MWAIT, MWAITX, and WAITPKG bits, but the primitive
+// every user mode spin loop actually uses is PAUSE, and its latency went
+// from about 10 cycles to about 140 on Skylake and back down to about 40
+// on later cores, so a spin count tuned on one machine is off by an order
+// of magnitude on another.  This measures:
+//
+// - the latency of PAUSE,
+//
+// - whether the wait instructions execute in user mode: UMONITOR/UMWAIT
+//   and TPAUSE (WAITPKG), MONITORX/MWAITX (AMD), and MONITOR/MWAIT, which
+//   normally faults outside ring 0,
+//
+// - how long TPAUSE actually waits for a requested number of TSC ticks,
+//   in the C0.1 and the deeper C0.2 state,
+//
+// - the wake-up latency of a waiting thread after another CPU stores to
+//   the line it waits on, when spinning, spinning with PAUSE, waiting in
+//   UMWAIT or MWAITX, and blocking on an event,
+//
+// and recommends how many PAUSEs to spin before blocking: about as long as
+// blocking and waking up again through an event costs.
+//
+// Usage: spinwait [-csv] [-cpu N]
+//
+//   -csv   print machine-readable comma-separated records only
+//   -cpu   logical CPU of the waiting thread (default the last CPU, the
+//          signaling thread runs on CPU 0)
+//
+// The -csv records are:
+//
+//   pause,ns per PAUSE,TSC ticks per PAUSE
+//   instruction,name,advertised,executes,exception code
+//   tpause,requested ticks,C0.1 ticks,C0.2 ticks
+//   wake,method,median ns,p90 ns,p99 ns
+//   recommend,PAUSE count,spin ns
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define PAUSES        (10000)          // per PAUSE round
+#define ROUNDS        (10)             // the fastest round is reported
+#define TPAUSE_TRIES  (1000)
+#define WAKES         (1000)           // wake-ups timed per method
+#define SIGNAL_US     (20)             // delay before each signal, so that the waiter is really waiting
+#define WAIT_TICKS    (1000000)        // UMWAIT and MWAITX timeout, the loops just wait again
+#define MAX_CPUS      (256)
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+bool CsvOutput = false;
+double TscPerNs = 0.0;
+
+typedef struct CPU_ENTRY
+{
+    WORD Group;
+    BYTE Number;
+} CPU_ENTRY;
+
+CPU_ENTRY Cpus[MAX_CPUS];
+uint32_t CpuCount = 0;
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool HasMONITOR()   { return LookUpRegBit(1, 0, CPUID_ECX,  3); }
+bool HasWAITPKG()   { return LookUpRegBit(7, 0, CPUID_ECX,  5); }
+bool HasMONITORX()  { return LookUpRegBit(0x80000001, 0, CPUID_ECX, 29); }
+bool HasAlways()    { return true; }
+
+double CalibrateTscPerNs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return (double)(TscStop - TscStart) / Ns;
+}
+
+bool PinToCpu(uint32_t Index)
+{
+    GROUP_AFFINITY Affinity = { 0 };
+
+    Affinity.Group = Cpus[Index].Group;
+    Affinity.Mask = (KAFFINITY)1 << Cpus[Index].Number;
+
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+        return false;
+
+    SwitchToThread();
+    return true;
+}
+
+void EnumerateCpus()
+{
+    WORD Groups = GetActiveProcessorGroupCount();
+
+    for (WORD Group = 0; Group < Groups; Group++)
+    {
+        DWORD Count = GetActiveProcessorCount(Group);
+
+        for (DWORD Number = 0; (Number < Count) && (CpuCount < MAX_CPUS); Number++)
+        {
+            Cpus[CpuCount].Group = Group;
+            Cpus[CpuCount].Number = (BYTE)Number;
+            CpuCount++;
+        }
+    }
+}
+
+//
+// Best of ROUNDS rounds of PAUSES back to back, in TSC ticks per PAUSE.
+//
+
+double MeasurePause()
+{
+    uint64_t Best = ~0ull;
+    unsigned int Aux;
+
+    for (uint32_t r = 0; r <= ROUNDS; r++)
+    {
+        uint64_t Start = __rdtscp(&Aux);
+
+        for (uint32_t i = 0; i < PAUSES; i++)
+            _mm_pause();
+
+        uint64_t Ticks = __rdtscp(&Aux) - Start;
+
+        // the first round only warms up
+
+        if (r > 0)
+            Best = min(Best, Ticks);
+    }
+
+    return (double)Best / PAUSES;
+}
+
+//
+// Execute each wait instruction once under an exception handler.  The
+// monitored line is a local that nobody writes, so the waits end on their
+// timeout, or on an interrupt for MWAIT, which has none.
+//
+
+typedef enum WAIT_KIND
+{
+    WAIT_UMWAIT,
+    WAIT_TPAUSE,
+    WAIT_MWAITX,
+    WAIT_MWAIT,
+} WAIT_KIND;
+
+typedef struct WAIT_INSTRUCTION
+{
+    const char *Name;
+    bool      (*IsPresent)(void);
+    WAIT_KIND   Kind;
+} WAIT_INSTRUCTION;
+
+const WAIT_INSTRUCTION WaitInstructions[] =
+{
+    { "UMONITOR/UMWAIT", HasWAITPKG,  WAIT_UMWAIT },
+    { "TPAUSE",          HasWAITPKG,  WAIT_TPAUSE },
+    { "MONITORX/MWAITX", HasMONITORX, WAIT_MWAITX },
+    { "MONITOR/MWAIT",   HasMONITOR,  WAIT_MWAIT  },
+};
+
+#define WAIT_INSTRUCTIONS (sizeof(WaitInstructions) / sizeof(WaitInstructions[0]))
+
+bool Executes[WAIT_INSTRUCTIONS];
+
+bool ProbeWait(WAIT_KIND Kind, DWORD *ExceptionCode)
+{
+    volatile LONG Line = 0;
+
+    __try
+    {
+        switch (Kind)
+            {
+        case WAIT_UMWAIT:
+            _umonitor((void *)&Line);
+            _umwait(0, __rdtsc() + 1000);
+            break;
+
+        case WAIT_TPAUSE:
+            _tpause(0, __rdtsc() + 1000);
+            break;
+
+        case WAIT_MWAITX:
+            _mm_monitorx((void *)&Line, 0, 0);
+            _mm_mwaitx(2, 0, 1000);
+            break;
+
+        case WAIT_MWAIT:
+            _mm_monitor((void *)&Line, 0, 0);
+            _mm_mwait(0, 0);
+            break;
+            }
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        *ExceptionCode = GetExceptionCode();
+        return false;
+    }
+
+    return true;
+}
+
+//
+// TPAUSE waits until the TSC reaches the deadline, or until the OS limit
+// in IA32_UMWAIT_CONTROL or an interrupt ends it early.  Control 0 asks for
+// C0.2, which saves more power but is slower to wake up, and 1 for C0.1.
+//
+
+double MeasureTpause(uint32_t Control, uint64_t Requested)
+{
+    uint64_t Total = 0;
+
+    for (uint32_t i = 0; i < TPAUSE_TRIES; i++)
+    {
+        uint64_t Start = __rdtsc();
+        _tpause(Control, Start + Requested);
+        Total += __rdtsc() - Start;
+    }
+
+    return (double)Total / TPAUSE_TRIES;
+}
+
+//
+// Wake-up latency.  The signaling thread stores the TSC and then the round
+// number to one line, the waiting thread waits for the round number by the
+// given method and notes the TSC as soon as it sees it.  The invariant TSC
+// is the same on all CPUs, so the difference is the wake-up latency.
+//
+
+typedef enum WAKE_METHOD
+{
+    WAKE_SPIN,
+    WAKE_PAUSE,
+    WAKE_UMWAIT,
+    WAKE_MWAITX,
+    WAKE_EVENT,
+} WAKE_METHOD;
+
+typedef struct WAKE
+{
+    const char  *Name;
+    int          Instruction;          // index into WaitInstructions[] that must execute, or -1
+    WAKE_METHOD  Method;
+} WAKE;
+
+const WAKE Wakes[] =
+{
+    { "spin",       -1, WAKE_SPIN   },
+    { "PAUSE spin", -1, WAKE_PAUSE  },
+    { "UMWAIT",      0, WAKE_UMWAIT },
+    { "MWAITX",      2, WAKE_MWAITX },
+    { "event",      -1, WAKE_EVENT  },
+};
+
+#define WAKE_METHODS (sizeof(Wakes) / sizeof(Wakes[0]))
+
+__declspec(align(64)) volatile uint64_t SignalLine[8];     // [0] round, [1] TSC at the store
+__declspec(align(64)) volatile LONG AckLine[16];
+
+HANDLE WakeEvent = NULL;
+uint64_t WakeTicks[WAKES];
+
+typedef struct WAITER
+{
+    uint32_t    Cpu;
+    WAKE_METHOD Method;
+} WAITER;
+
+DWORD WINAPI WaiterProc(LPVOID Param)
+{
+    WAITER *Waiter = (WAITER *)Param;
+
+    PinToCpu(Waiter->Cpu);
+    AckLine[0] = 0;
+
+    for (uint32_t Round = 1; Round <= WAKES; Round++)
+    {
+        switch (Waiter->Method)
+            {
+        case WAKE_SPIN:
+            while (SignalLine[0] != Round)
+                ;
+            break;
+
+        case WAKE_PAUSE:
+            while (SignalLine[0] != Round)
+                _mm_pause();
+            break;
+
+        case WAKE_UMWAIT:
+            while (SignalLine[0] != Round)
+            {
+                _umonitor((void *)&SignalLine[0]);
+
+                if (SignalLine[0] != Round)
+                    _umwait(0, __rdtsc() + WAIT_TICKS);
+            }
+            break;
+
+        case WAKE_MWAITX:
+            while (SignalLine[0] != Round)
+            {
+                _mm_monitorx((void *)&SignalLine[0], 0, 0);
+
+                if (SignalLine[0] != Round)
+                    _mm_mwaitx(2, 0, WAIT_TICKS);
+            }
+            break;
+
+        case WAKE_EVENT:
+            while (SignalLine[0] != Round)
+                WaitForSingleObject(WakeEvent, INFINITE);
+            break;
+            }
+
+        WakeTicks[Round - 1] = __rdtsc() - SignalLine[1];
+        AckLine[0] = Round;
+    }
+
+    return 0;
+}
+
+int __cdecl CompareTicks(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+//
+// Returns the median wake-up latency in nanoseconds, or 0 if the waiting
+// thread could not be started.
+//
+
+double MeasureWake(const WAKE *Wake, uint32_t WaiterCpu)
+{
+    WAITER Waiter = { WaiterCpu, Wake->Method };
+
+    SignalLine[0] = 0;
+    AckLine[0] = ~0;
+
+    HANDLE Thread = CreateThread(NULL, 0, WaiterProc, &Waiter, 0, NULL);
+
+    if (Thread == NULL)
+    {
+        printf("CreateThread failed with error %u\n", GetLastError());
+        return 0.0;
+    }
+
+    uint64_t Delay = (uint64_t)(SIGNAL_US * 1000.0 * TscPerNs);
+
+    for (uint32_t Round = 1; Round <= WAKES; Round++)
+    {
+        for (uint32_t Spins = 0; AckLine[0] != (LONG)(Round - 1); Spins++)
+        {
+            _mm_pause();
+
+            if (Spins > 100000)
+                SwitchToThread();
+        }
+
+        uint64_t Until = __rdtsc() + Delay;
+
+        while (__rdtsc() < Until)
+            _mm_pause();
+
+        SignalLine[1] = __rdtsc();
+        SignalLine[0] = Round;
+
+        if (Wake->Method == WAKE_EVENT)
+            SetEvent(WakeEvent);
+    }
+
+    WaitForSingleObject(Thread, INFINITE);
+    CloseHandle(Thread);
+
+    qsort(WakeTicks, WAKES, sizeof(WakeTicks[0]), CompareTicks);
+
+    double P50 = WakeTicks[WAKES / 2] / TscPerNs;
+    double P90 = WakeTicks[WAKES * 90 / 100] / TscPerNs;
+    double P99 = WakeTicks[WAKES * 99 / 100] / TscPerNs;
+
+    if (CsvOutput)
+        printf("wake,%s,%.1f,%.1f,%.1f\n", Wake->Name, P50, P90, P99);
+    else
+        printf("%-12s %10.1f %10.1f %10.1f\n", Wake->Name, P50, P90, P99);
+
+    return P50;
+}
+
+const uint64_t TpauseTicks[] = { 100, 1000, 10000, 100000 };
+
+#define TPAUSE_REQUESTS (sizeof(TpauseTicks) / sizeof(TpauseTicks[0]))
+
+#endif // _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+int __cdecl main(int argc, char **argv)
+{
+    uint32_t WaiterCpu = ~0u;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else if (!_stricmp(argv[i], "-cpu") && (i + 1 < argc))
+            WaiterCpu = strtoul(argv[++i], NULL, 0);
+        else
+        {
+            printf("Usage: spinwait [-csv] [-cpu N]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+    EnumerateCpus();
+
+    if (WaiterCpu >= CpuCount)
+        WaiterCpu = CpuCount - 1;
+
+    PinToCpu(0);
+
+    TscPerNs = CalibrateTscPerNs();
+
+    double PauseTicks = MeasurePause();
+    double PauseNs = PauseTicks / TscPerNs;
+
+    if (CsvOutput)
+        printf("pause,%.2f,%.1f\n", PauseNs, PauseTicks);
+    else
+        printf("\nPAUSE: %.2f ns, %.1f TSC ticks\n", PauseNs, PauseTicks);
+
+    if (!CsvOutput)
+    {
+        printf("\nWait instructions in user mode:\n\n");
+        printf("%-16s %10s %10s\n", "instruction", "advertised", "executes");
+    }
+
+    for (uint32_t w = 0; w < WAIT_INSTRUCTIONS; w++)
+    {
+        const WAIT_INSTRUCTION *Wait = &WaitInstructions[w];
+        bool Advertised = (*Wait->IsPresent)();
+        DWORD ExceptionCode = 0;
+
+        // only the advertised ones are tried, the others may be anything on an old CPU
+
+        Executes[w] = Advertised && ProbeWait(Wait->Kind, &ExceptionCode);
+
+        if (CsvOutput)
+            printf("instruction,%s,%u,%u,%08X\n", Wait->Name, Advertised, Executes[w], ExceptionCode);
+        else if (ExceptionCode != 0)
+            printf("%-16s %10s %10s exception %08X\n", Wait->Name, "yes", "no", ExceptionCode);
+        else
+            printf("%-16s %10s %10s\n", Wait->Name, Advertised ? "yes" : "no", Executes[w] ? "yes" : "no");
+    }
+
+    if (Executes[WAIT_TPAUSE])
+    {
+        if (!CsvOutput)
+        {
+            printf("\nTPAUSE, TSC ticks actually waited:\n\n");
+            printf("%10s %10s %10s\n", "requested", "C0.1", "C0.2");
+        }
+
+        for (uint32_t t = 0; t < TPAUSE_REQUESTS; t++)
+        {
+            double C01 = MeasureTpause(1, TpauseTicks[t]);
+            double C02 = MeasureTpause(0, TpauseTicks[t]);
+
+            if (CsvOutput)
+                printf("tpause,%llu,%.0f,%.0f\n", TpauseTicks[t], C01, C02);
+            else
+                printf("%10llu %10.0f %10.0f\n", TpauseTicks[t], C01, C02);
+        }
+    }
+
+    // the wake-up tests need the waiter and the signaler on different CPUs
+
+    if (WaiterCpu == 0)
+    {
+        if (!CsvOutput)
+            printf("\nOnly one CPU, the wake-up latency needs two.\n");
+
+        return 0;
+    }
+
+    WakeEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    if (!CsvOutput)
+    {
+        printf("\nWake-up latency after a store from CPU 0 to a line CPU %u waits on, ns:\n\n", WaiterCpu);
+        printf("%-12s %10s %10s %10s\n", "method", "median", "p90", "p99");
+    }
+
+    double EventNs = 0.0;
+
+    for (uint32_t m = 0; m < WAKE_METHODS; m++)
+    {
+        const WAKE *Wake = &Wakes[m];
+
+        if ((Wake->Instruction >= 0) && !Executes[Wake->Instruction])
+            continue;
+
+        double Ns = MeasureWake(Wake, WaiterCpu);
+
+        if (Wake->Method == WAKE_EVENT)
+            EventNs = Ns;
+    }
+
+    CloseHandle(WakeEvent);
+
+    //
+    // Spinning longer than blocking would take is wasted, and spinning much
+    // less gives up before a lock holder that is about to release it.  So
+    // spin for about what blocking and waking up through an event costs.
+    //
+
+    uint32_t PauseCount = (uint32_t)(EventNs / PauseNs);
+
+    if (CsvOutput)
+    {
+        printf("recommend,%u,%.0f\n", PauseCount, EventNs);
+    }
+    else
+    {
+        printf("\nRecommendation: spin up to %u PAUSEs (%.1f us, what blocking on an event and\n", PauseCount, EventNs / 1000.0);
+        printf("being woken up costs here) before blocking.");
+
+        if (Executes[WAIT_UMWAIT])
+            printf("  UMWAIT with a TSC deadline can replace the PAUSE loop.");
+
+        printf("\n");
+    }
+
+#else
+
+    printf("This probe uses x86 wait instructions, run the x64 build to test the emulator on ARM64.\n");
+
+#endif
+
+    return 0;
+}
+
@@ -0,0 +1,402 @@
+
+//
+// SYSCALL.C
+//
+// Kernel transition cost probe.
+//
+// CPUIDEX shows the SYSENTER/SYSEXIT bit, but what a system call actually
+// costs depends far more on the kernel's speculation mitigations, on the
+// hypervisor, and on the WOW64 or emulation layer between the program and
+// the kernel.  This times the round trip of:
+//
+// - NtTestAlert(), about the most trivial system call there is, called
+//   directly through NTDLL,
+//
+// - QueryPerformanceCounter() and GetSystemTimePreciseAsFileTime(), which
+//   normally read the shared user data page and the counter without ever
+//   entering the kernel (the Windows equivalent of a vDSO call),
+//
+// - a demand-zero page fault on the first touch of a committed page,
+//
+// - an access violation caught by a structured exception handler, which is
+//   a hardware fault delivered back to user mode, the Windows equivalent of
+//   a signal, and RaiseException() for the software-only dispatch,
+//
+// - a user APC queued to the thread itself and delivered by SleepEx().
+//
+// Every sample times a few operations in a row so that the coarser timers
+// of ARM64 still resolve it, and the distribution of the samples is
+// reported per operation.  Build and host ISA are printed with the results:
+// run the x64 build natively, the x86 build under WOW64, and both under
+// emulation on ARM64 to compare the layers.
+//
+// Usage: syscall [-csv]
+//
+//   -csv   print machine-readable comma-separated records only
+//
+// The -csv records are:
+//
+//   latency,build,host,mode,operation,min ns,median ns,p90 ns,p99 ns,p99.9 ns,max ns
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define SAMPLES       (10000)
+#define WARMUP        (100)
+#define REPEAT        (8)              // operations per timed sample
+#define FAULT_PAGES   (1024)
+#define PAGE_BYTES    (4096)
+
+typedef LONG (NTAPI NT_TEST_ALERT)(void);
+
+bool CsvOutput = false;
+double TicksPerNs = 0.0;
+
+NT_TEST_ALERT *pfnNtTestAlert = NULL;
+volatile uint8_t *FaultRegion = NULL;
+volatile LONG *NoAccessPage = NULL;
+volatile LONG Sink;
+
+//
+// The ISA this binary was built for, and the ISA of the machine underneath
+// as reported by IsWow64Process2(), which is not available before Windows 10.
+//
+
+const char *GetBuildArch()
+{
+#if _M_IX86
+    return "x86";
+#elif _M_ARM64EC
+    // check for ARM64EC before AMD64 because AMD64 is defined for it too
+    return "ARM64EC";
+#elif _M_AMD64
+    return "x64";
+#elif _M_ARM64
+    return "ARM64";
+#else
+    return "unknown";
+#endif
+}
+
+USHORT GetHostMachine()
+{
+    BOOL (WINAPI *pfnIsWow64Process2)(HANDLE, USHORT *, USHORT *) = NULL;
+    USHORT ProcessMachine = 0;
+    USHORT NativeMachine = 0;
+    BOOL IsWow = FALSE;
+
+    pfnIsWow64Process2 = (void *)GetProcAddress(GetModuleHandleA("kernel32.dll"), "IsWow64Process2");
+
+    if (pfnIsWow64Process2 && (*pfnIsWow64Process2)(GetCurrentProcess(), &ProcessMachine, &NativeMachine))
+        return NativeMachine;
+
+    if (IsWow64Process(GetCurrentProcess(), &IsWow) && IsWow)
+        return IMAGE_FILE_MACHINE_AMD64;
+
+#if _M_IX86
+    return IMAGE_FILE_MACHINE_I386;
+#elif _M_AMD64
+    return IMAGE_FILE_MACHINE_AMD64;
+#else
+    return IMAGE_FILE_MACHINE_ARM64;
+#endif
+}
+
+const char *GetHostArch(USHORT Machine)
+{
+    switch (Machine)
+        {
+    case IMAGE_FILE_MACHINE_I386:
+        return "x86";
+
+    case IMAGE_FILE_MACHINE_AMD64:
+        return "x64";
+
+    case IMAGE_FILE_MACHINE_ARM64:
+        return "ARM64";
+
+    default:
+        return "unknown";
+        }
+}
+
+//
+// x86 and x64 code on an ARM64 host is emulated, x86 code on an x64 host
+// goes through the 32-bit WOW64 layer, and everything else is native.
+//
+
+const char *GetMode(USHORT Machine)
+{
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+    if (Machine == IMAGE_FILE_MACHINE_ARM64)
+        return "emulated";
+#endif
+
+#if _M_IX86
+    if (Machine == IMAGE_FILE_MACHINE_AMD64)
+        return "32-bit compat";
+#endif
+
+    (void)Machine;
+    return "native";
+}
+
+uint64_t ReadTimeStamp()
+{
+#if _M_IX86 || _M_AMD64
+    return __rdtsc();
+#else
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter(&Now);
+    return Now.QuadPart;
+#endif
+}
+
+double CalibrateTicksPerNs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TicksStart = ReadTimeStamp();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TicksStop = ReadTimeStamp();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return (double)(TicksStop - TicksStart) / Ns;
+}
+
+//
+// The operations.  Each one does REPEAT round trips, and the optional
+// Prepare function sets up the next sample outside of the timed region.
+//
+
+void DoNtTestAlert(uint32_t Sample)
+{
+    (void)Sample;
+
+    for (uint32_t r = 0; r < REPEAT; r++)
+        (*pfnNtTestAlert)();
+}
+
+void DoQpc(uint32_t Sample)
+{
+    LARGE_INTEGER Now;
+
+    (void)Sample;
+
+    for (uint32_t r = 0; r < REPEAT; r++)
+        QueryPerformanceCounter(&Now);
+
+    Sink = (LONG)Now.LowPart;
+}
+
+void DoPreciseTime(uint32_t Sample)
+{
+    FILETIME Now;
+
+    (void)Sample;
+
+    for (uint32_t r = 0; r < REPEAT; r++)
+        GetSystemTimePreciseAsFileTime(&Now);
+
+    Sink = (LONG)Now.dwLowDateTime;
+}
+
+//
+// The fault region is decommitted and committed again whenever all of its
+// pages have been touched, so that every touch is a fresh demand-zero fault.
+//
+
+void PrepareFault(uint32_t Sample)
+{
+    if (((Sample * REPEAT) % FAULT_PAGES) == 0)
+    {
+        VirtualFree((void *)FaultRegion, FAULT_PAGES * PAGE_BYTES, MEM_DECOMMIT);
+        VirtualAlloc((void *)FaultRegion, FAULT_PAGES * PAGE_BYTES, MEM_COMMIT, PAGE_READWRITE);
+    }
+}
+
+void DoFault(uint32_t Sample)
+{
+    uint32_t First = (Sample * REPEAT) % FAULT_PAGES;
+
+    for (uint32_t r = 0; r < REPEAT; r++)
+        FaultRegion[(size_t)(First + r) * PAGE_BYTES] = 1;
+}
+
+void DoAccessViolation(uint32_t Sample)
+{
+    (void)Sample;
+
+    for (uint32_t r = 0; r < REPEAT; r++)
+    {
+        __try
+        {
+            Sink = *NoAccessPage;
+        }
+        __except ((GetExceptionCode() == EXCEPTION_ACCESS_VIOLATION) ? EXCEPTION_EXECUTE_HANDLER : EXCEPTION_CONTINUE_SEARCH)
+        {
+        }
+    }
+}
+
+void DoRaiseException(uint32_t Sample)
+{
+    (void)Sample;
+
+    for (uint32_t r = 0; r < REPEAT; r++)
+    {
+        __try
+        {
+            RaiseException(0xE0000001, 0, 0, NULL);
+        }
+        __except (EXCEPTION_EXECUTE_HANDLER)
+        {
+        }
+    }
+}
+
+void CALLBACK ApcRoutine(ULONG_PTR Parameter)
+{
+    Sink = (LONG)Parameter;
+}
+
+void DoUserApc(uint32_t Sample)
+{
+    for (uint32_t r = 0; r < REPEAT; r++)
+    {
+        QueueUserAPC(ApcRoutine, GetCurrentThread(), Sample);
+        SleepEx(0, TRUE);
+    }
+}
+
+typedef void (OPERATION)(uint32_t Sample);
+
+typedef struct TRANSITION
+{
+    const char *Name;
+    OPERATION  *Prepare;
+    OPERATION  *Run;
+} TRANSITION;
+
+const TRANSITION Transitions[] =
+{
+    { "NtTestAlert syscall",   NULL,         DoNtTestAlert     },
+    { "QPC (user mode)",       NULL,         DoQpc             },
+    { "precise system time",   NULL,         DoPreciseTime     },
+    { "demand-zero fault",     PrepareFault, DoFault           },
+    { "access violation",      NULL,         DoAccessViolation },
+    { "RaiseException",        NULL,         DoRaiseException  },
+    { "user APC",              NULL,         DoUserApc         },
+};
+
+#define TRANSITIONS (sizeof(Transitions) / sizeof(Transitions[0]))
+
+int __cdecl CompareTicks(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+void MeasureTransition(const TRANSITION *Transition, const char *Build, const char *Host, const char *Mode)
+{
+    static uint64_t Ticks[SAMPLES];
+
+    for (uint32_t i = 0; i < WARMUP + SAMPLES; i++)
+    {
+        if (Transition->Prepare != NULL)
+            (*Transition->Prepare)(i);
+
+        uint64_t Start = ReadTimeStamp();
+        (*Transition->Run)(i);
+        uint64_t Stop = ReadTimeStamp();
+
+        if (i >= WARMUP)
+            Ticks[i - WARMUP] = Stop - Start;
+    }
+
+    qsort(Ticks, SAMPLES, sizeof(Ticks[0]), CompareTicks);
+
+    double Scale = 1.0 / (TicksPerNs * REPEAT);
+
+    double Min  = Ticks[0] * Scale;
+    double P50  = Ticks[SAMPLES / 2] * Scale;
+    double P90  = Ticks[SAMPLES * 90 / 100] * Scale;
+    double P99  = Ticks[SAMPLES * 99 / 100] * Scale;
+    double P999 = Ticks[SAMPLES * 999 / 1000] * Scale;
+    double Max  = Ticks[SAMPLES - 1] * Scale;
+
+    if (CsvOutput)
+        printf("latency,%s,%s,%s,%s,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f\n", Build, Host, Mode, Transition->Name, Min, P50, P90, P99, P999, Max);
+    else
+        printf("%-22s %9.1f %9.1f %9.1f %9.1f %9.1f %10.1f\n", Transition->Name, Min, P50, P90, P99, P999, Max);
+}
+
+int __cdecl main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else
+        {
+            printf("Usage: syscall [-csv]\n");
+            return 1;
+        }
+    }
+
+    pfnNtTestAlert = (NT_TEST_ALERT *)(void *)GetProcAddress(GetModuleHandleA("ntdll.dll"), "NtTestAlert");
+
+    if (pfnNtTestAlert == NULL)
+    {
+        printf("NtTestAlert not found in NTDLL\n");
+        return 1;
+    }
+
+    FaultRegion = (volatile uint8_t *)VirtualAlloc(NULL, FAULT_PAGES * PAGE_BYTES, MEM_RESERVE, PAGE_READWRITE);
+    NoAccessPage = (volatile LONG *)VirtualAlloc(NULL, PAGE_BYTES, MEM_COMMIT, PAGE_NOACCESS);
+
+    if ((FaultRegion == NULL) || (NoAccessPage == NULL))
+    {
+        printf("VirtualAlloc failed with error %u\n", GetLastError());
+        return 1;
+    }
+
+    USHORT Machine = GetHostMachine();
+    const char *Build = GetBuildArch();
+    const char *Host = GetHostArch(Machine);
+    const char *Mode = GetMode(Machine);
+
+    TicksPerNs = CalibrateTicksPerNs();
+
+    if (!CsvOutput)
+    {
+        printf("\nKernel transition costs, %s build on %s host (%s), nanoseconds per operation.\n\n", Build, Host, Mode);
+        printf("%-22s %9s %9s %9s %9s %9s %10s\n", "operation", "min", "median", "p90", "p99", "p99.9", "max");
+    }
+
+    for (uint32_t t = 0; t < TRANSITIONS; t++)
+        MeasureTransition(&Transitions[t], Build, Host, Mode);
+
+    VirtualFree((void *)FaultRegion, 0, MEM_RELEASE);
+    VirtualFree((void *)NoAccessPage, 0, MEM_RELEASE);
+
+    return 0;
+}
+
@@ -0,0 +1,405 @@
+
+//
+// TIMESTAMPS.C
+//
+// Timestamp and CPU number source benchmark.
+//
+// CPUIDEX only checks that RDTSC and RDTSCP increase.  Tracing code reads
+// a clock for every event, and the cost of that read ranges from a few
+// nanoseconds for RDTSC to microseconds where a hypervisor traps it or an
+// emulator has to synthesize it.  This measures every source a Windows
+// program has for a timestamp or the current CPU:
+//
+//   RDTSC, RDTSCP, LFENCE+RDTSC, RDPID          x86 and x64 builds
+//   CNTVCT_EL0                                  ARM64 build
+//   QueryPerformanceCounter, QueryInterruptTimePrecise,
+//   QueryUnbiasedInterruptTimePrecise, GetSystemTimePreciseAsFileTime,
+//   GetTickCount64, GetCurrentProcessorNumber(Ex)
+//
+// For each source it reports the cost of back-to-back reads (throughput)
+// and of reads each followed by a fence, so that the next read cannot
+// overlap it (latency).  For the clocks it also reports the unit of the
+// value, the smallest and the median step between successive different
+// values, how many reads return the same value before it changes, and
+// whether the value ever went backwards.  RDPID is only timed when CPUID
+// reports it, the interrupt time functions only when Windows has them.
+//
+// Usage: timestamps [-csv]
+//
+//   -csv   print machine-readable comma-separated records only
+//
+// The -csv records are:
+//
+//   cost,source,ns per read,fenced ns per read
+//   step,source,unit ns,min step ns,median step ns,reads per step,backwards
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <intrin.h>
+
+#define READS         (100000)         // reads per round
+#define ROUNDS        (5)              // the fastest round is reported
+#define MAX_STEPS     (1000)           // value changes sampled per clock
+#define STEP_MS       (200)            // give up sampling slow clocks after this
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+typedef void (WINAPI QUERY_TIME)(PULONGLONG Time);
+
+bool CsvOutput = false;
+
+QUERY_TIME *pfnQueryInterruptTimePrecise = NULL;
+QUERY_TIME *pfnQueryUnbiasedInterruptTimePrecise = NULL;
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+#define FENCE()       _mm_lfence()
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool HasRDTSCP()    { return LookUpRegBit(0x80000001, 0, CPUID_EDX, 27); }
+bool HasRDPID()     { return LookUpRegBit(7, 0, CPUID_ECX, 22); }
+
+#elif _M_ARM64
+
+#define FENCE()       __isb(_ARM64_BARRIER_SY)
+
+#else
+
+#define FENCE()       MemoryBarrier()
+
+#endif
+
+bool HasAlways()    { return true; }
+bool HasInterruptTime()         { return pfnQueryInterruptTimePrecise != NULL; }
+bool HasUnbiasedInterruptTime() { return pfnQueryUnbiasedInterruptTimePrecise != NULL; }
+
+uint64_t QpcValue()
+{
+    LARGE_INTEGER Now;
+    QueryPerformanceCounter(&Now);
+    return Now.QuadPart;
+}
+
+uint64_t InterruptTimeValue()
+{
+    ULONGLONG Now;
+    (*pfnQueryInterruptTimePrecise)(&Now);
+    return Now;
+}
+
+uint64_t UnbiasedInterruptTimeValue()
+{
+    ULONGLONG Now;
+    (*pfnQueryUnbiasedInterruptTimePrecise)(&Now);
+    return Now;
+}
+
+uint64_t PreciseSystemTimeValue()
+{
+    FILETIME Now;
+    GetSystemTimePreciseAsFileTime(&Now);
+    return ((uint64_t)Now.dwHighDateTime << 32) | Now.dwLowDateTime;
+}
+
+uint64_t ProcessorNumberExValue()
+{
+    PROCESSOR_NUMBER Number;
+    GetCurrentProcessorNumberEx(&Number);
+    return ((uint64_t)Number.Group << 8) | Number.Number;
+}
+
+//
+// Each source gets a single read and two loops, generated by a macro so
+// that the read is inlined into the loops rather than called through a
+// pointer.  The values are summed so that the reads cannot be discarded.
+//
+
+#define SOURCE_LOOPS(Name, Expression)                                      \
+                                                                            \
+uint64_t Name##Read()                                                       \
+{                                                                           \
+    unsigned int Aux;                                                       \
+                                                                            \
+    (void)Aux;                                                              \
+    return (uint64_t)(Expression);                                          \
+}                                                                           \
+                                                                            \
+uint64_t Name##BackToBack()                                                 \
+{                                                                           \
+    unsigned int Aux;                                                       \
+    uint64_t Sum = 0;                                                       \
+                                                                            \
+    (void)Aux;                                                              \
+                                                                            \
+    for (uint32_t i = 0; i < READS; i++)                                    \
+        Sum += (uint64_t)(Expression);                                      \
+                                                                            \
+    return Sum;                                                             \
+}                                                                           \
+                                                                            \
+uint64_t Name##Fenced()                                                     \
+{                                                                           \
+    unsigned int Aux;                                                       \
+    uint64_t Sum = 0;                                                       \
+                                                                            \
+    (void)Aux;                                                              \
+                                                                            \
+    for (uint32_t i = 0; i < READS; i++)                                    \
+    {                                                                       \
+        Sum += (uint64_t)(Expression);                                      \
+        FENCE();                                                            \
+    }                                                                       \
+                                                                            \
+    return Sum;                                                             \
+}
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+SOURCE_LOOPS(Rdtsc,       __rdtsc())
+SOURCE_LOOPS(Rdtscp,      __rdtscp(&Aux))
+SOURCE_LOOPS(LfenceRdtsc, (_mm_lfence(), __rdtsc()))
+SOURCE_LOOPS(Rdpid,       _rdpid_u32())
+#elif _M_ARM64
+SOURCE_LOOPS(Cntvct,      _ReadStatusReg(ARM64_CNTVCT))
+#endif
+SOURCE_LOOPS(Qpc,         QpcValue())
+SOURCE_LOOPS(Interrupt,   InterruptTimeValue())
+SOURCE_LOOPS(Unbiased,    UnbiasedInterruptTimeValue())
+SOURCE_LOOPS(SystemTime,  PreciseSystemTimeValue())
+SOURCE_LOOPS(TickCount,   GetTickCount64())
+SOURCE_LOOPS(ProcNumber,  GetCurrentProcessorNumber())
+SOURCE_LOOPS(ProcNumEx,   ProcessorNumberExValue())
+
+typedef uint64_t (READ)(void);
+
+//
+// UnitNs is the length of one unit of the value in nanoseconds, 0 for
+// counters whose rate is calibrated against QPC, and the CPU number
+// sources are not clocks at all.
+//
+
+typedef struct SOURCE
+{
+    const char *Name;
+    bool      (*IsPresent)(void);
+    bool        IsClock;
+    double      UnitNs;
+    READ       *Read;
+    READ       *BackToBack;
+    READ       *Fenced;
+} SOURCE;
+
+const SOURCE Sources[] =
+{
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+    { "RDTSC",                HasAlways,                true,  0.0,   RdtscRead,       RdtscBackToBack,       RdtscFenced       },
+    { "RDTSCP",               HasRDTSCP,                true,  0.0,   RdtscpRead,      RdtscpBackToBack,      RdtscpFenced      },
+    { "LFENCE+RDTSC",         HasAlways,                true,  0.0,   LfenceRdtscRead, LfenceRdtscBackToBack, LfenceRdtscFenced },
+    { "RDPID",                HasRDPID,                 false, 0.0,   RdpidRead,       RdpidBackToBack,       RdpidFenced       },
+#elif _M_ARM64
+    { "CNTVCT_EL0",           HasAlways,                true,  0.0,   CntvctRead,      CntvctBackToBack,      CntvctFenced      },
+#endif
+    { "QPC",                  HasAlways,                true,  0.0,   QpcRead,         QpcBackToBack,         QpcFenced         },
+    { "InterruptTimePrecise", HasInterruptTime,         true,  100.0, InterruptRead,   InterruptBackToBack,   InterruptFenced   },
+    { "UnbiasedIntTimePrec",  HasUnbiasedInterruptTime, true,  100.0, UnbiasedRead,    UnbiasedBackToBack,    UnbiasedFenced    },
+    { "SystemTimePrecise",    HasAlways,                true,  100.0, SystemTimeRead,  SystemTimeBackToBack,  SystemTimeFenced  },
+    { "GetTickCount64",       HasAlways,                true,  1e6,   TickCountRead,   TickCountBackToBack,   TickCountFenced   },
+    { "ProcessorNumber",      HasAlways,                false, 0.0,   ProcNumberRead,  ProcNumberBackToBack,  ProcNumberFenced  },
+    { "ProcessorNumberEx",    HasAlways,                false, 0.0,   ProcNumExRead,   ProcNumExBackToBack,   ProcNumExFenced   },
+};
+
+#define SOURCES (sizeof(Sources) / sizeof(Sources[0]))
+
+double NowNs()
+{
+    LARGE_INTEGER Freq, Now;
+
+    QueryPerformanceFrequency(&Freq);
+    QueryPerformanceCounter(&Now);
+
+    return (double)Now.QuadPart * 1e9 / (double)Freq.QuadPart;
+}
+
+double CalibrateUnitNs(READ *Read)
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t UnitsStart = (*Read)();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t UnitsStop = (*Read)();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return Ns / (double)(UnitsStop - UnitsStart);
+}
+
+volatile uint64_t Sink;
+
+double TimeReads(READ *Loop)
+{
+    double Best = 0.0;
+
+    for (uint32_t r = 0; r < ROUNDS; r++)
+    {
+        double Start = NowNs();
+        Sink = (*Loop)();
+        double Ns = (NowNs() - Start) / READS;
+
+        Best = (r == 0) ? Ns : min(Best, Ns);
+    }
+
+    return Best;
+}
+
+int __cdecl CompareSteps(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x < y) ? -1 : (x > y) ? 1 : 0;
+}
+
+//
+// Read the clock in a tight loop and record the difference every time the
+// value changes.  Slow clocks such as GetTickCount64 stop after STEP_MS.
+//
+
+void MeasureSteps(const SOURCE *Source, double UnitNs)
+{
+    static uint64_t Steps[MAX_STEPS];
+    uint32_t Changes = 0;
+    uint64_t Reads = 0;
+    uint64_t Backwards = 0;
+    double Deadline = NowNs() + STEP_MS * 1e6;
+
+    uint64_t Previous = (*Source->Read)();
+
+    while (Changes < MAX_STEPS)
+    {
+        uint64_t Value = (*Source->Read)();
+
+        if (Value < Previous)
+            Backwards++;
+        else if (Value > Previous)
+            Steps[Changes++] = Value - Previous;
+
+        Previous = Value;
+
+        if ((++Reads % 256) == 0 && (NowNs() > Deadline))
+            break;
+    }
+
+    qsort(Steps, Changes, sizeof(Steps[0]), CompareSteps);
+
+    double MinNs    = Changes ? Steps[0] * UnitNs : 0.0;
+    double MedianNs = Changes ? Steps[Changes / 2] * UnitNs : 0.0;
+    double PerStep  = (double)Reads / (double)max(1, Changes);
+
+    if (CsvOutput)
+        printf("step,%s,%.3f,%.1f,%.1f,%.1f,%llu\n", Source->Name, UnitNs, MinNs, MedianNs, PerStep, Backwards);
+    else
+        printf("%-21s %12.3f %12.1f %12.1f %12.1f %10llu\n", Source->Name, UnitNs, MinNs, MedianNs, PerStep, Backwards);
+}
+
+int __cdecl main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else
+        {
+            printf("Usage: timestamps [-csv]\n");
+            return 1;
+        }
+    }
+
+    // the precise interrupt time functions are new in Windows 10
+
+    HMODULE hMod = GetModuleHandleA("kernelbase.dll");
+
+    if (hMod != NULL)
+    {
+        pfnQueryInterruptTimePrecise = (QUERY_TIME *)(void *)GetProcAddress(hMod, "QueryInterruptTimePrecise");
+        pfnQueryUnbiasedInterruptTimePrecise = (QUERY_TIME *)(void *)GetProcAddress(hMod, "QueryUnbiasedInterruptTimePrecise");
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\nCost of reading each source, nanoseconds per read.\n\n");
+        printf("%-21s %10s %12s\n", "source", "ns/read", "fenced ns");
+    }
+
+    for (uint32_t s = 0; s < SOURCES; s++)
+    {
+        const SOURCE *Source = &Sources[s];
+
+        if (!(*Source->IsPresent)())
+        {
+            if (!CsvOutput)
+                printf("%-21s %10s\n", Source->Name, "absent");
+
+            continue;
+        }
+
+        double Ns = TimeReads(Source->BackToBack);
+        double FencedNs = TimeReads(Source->Fenced);
+
+        if (CsvOutput)
+            printf("cost,%s,%.2f,%.2f\n", Source->Name, Ns, FencedNs);
+        else
+            printf("%-21s %10.2f %12.2f\n", Source->Name, Ns, FencedNs);
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\nResolution of each clock, nanoseconds.\n\n");
+        printf("%-21s %12s %12s %12s %12s %10s\n", "source", "unit", "min step", "median step", "reads/step", "backwards");
+    }
+
+    for (uint32_t s = 0; s < SOURCES; s++)
+    {
+        const SOURCE *Source = &Sources[s];
+
+        if (!Source->IsClock || !(*Source->IsPresent)())
+            continue;
+
+        double UnitNs = (Source->UnitNs != 0.0) ? Source->UnitNs : CalibrateUnitNs(Source->Read);
+
+        MeasureSteps(Source, UnitNs);
+    }
+
+    return 0;
+}
+
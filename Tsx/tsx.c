@@ -0,0 +1,560 @@
+
+//
+// TSX.C
+//
+// RTM transactional memory throughput and abort reason profiler.
+//
+// CPUIDEX shows the HLE and RTM bits, but TSX has been disabled by
+// microcode on most of the CPUs that have it, sometimes with the bits
+// still set, and with RTM_ALWAYS_ABORT every transaction aborts no matter
+// what.  This executes real XBEGIN/XEND transactions, under an exception
+// handler so that a CPU or emulator where XBEGIN raises #UD is reported
+// cleanly instead of crashing, and measures:
+//
+// - the commit rate and the cost of a transaction as its read set and its
+//   write set grow, single threaded, which shows the capacity limits,
+//
+// - the throughput of a lock elided counter increment with 1, 2, 4, ...
+//   threads and 1, 16, or 1024 counters, i.e. from every transaction
+//   conflicting to almost none, with up to 3 retries before falling back to
+//   the lock.  The counters are checked afterwards, so that a transaction
+//   that commits without being atomic shows up as a count mismatch.
+//
+// Aborts are broken down by the bits of the XBEGIN status.  An abort with
+// no bit set is usually an interrupt or an instruction that always aborts.
+//
+// Usage: tsx [-csv]
+//
+//   -csv   print machine-readable comma-separated records only
+//
+// The -csv records are:
+//
+//   rtm,advertised,RTM_ALWAYS_ABORT,TSX_FORCE_ABORT,executes
+//   set,read lines,write lines,ns per attempt,commit %,conflict %,capacity %,retry %,explicit %,other %
+//   elision,threads,counters,Mops/s,commit %,fallback %,conflict %,capacity %,lock busy %,other %,count ok
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <intrin.h>
+
+#define ATTEMPTS      (10000)          // transactions per read or write set size
+#define RUN_MS        (200)            // per lock elision measurement
+#define MAX_SET_LINES (4096)           // 256 KB
+#define MAX_SLOTS     (1024)
+#define RETRIES       (3)
+#define LOCK_BUSY     (0xFF)           // XABORT code when the fallback lock is held
+#define MAX_CPUS      (256)
+
+typedef enum CPUID_REGS
+{
+    CPUID_EAX = 0,
+    CPUID_EBX = 1,
+    CPUID_ECX = 2,
+    CPUID_EDX = 3,
+} CPUID_REGS;
+
+bool CsvOutput = false;
+double TscPerNs = 0.0;
+
+typedef struct CPU_ENTRY
+{
+    WORD Group;
+    BYTE Number;
+} CPU_ENTRY;
+
+CPU_ENTRY Cpus[MAX_CPUS];
+uint32_t CpuCount = 0;
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+uint32_t LookUpRegBit(uint32_t Function, uint32_t Sub, CPUID_REGS Reg, int Bit)
+{
+    int CpuInfo[4] = { 0 };
+
+    __cpuidex(CpuInfo, Function & 0x80000000, 0);
+
+    if ((uint32_t)CpuInfo[CPUID_EAX] < Function)
+        return 0;
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    return ((uint32_t)CpuInfo[Reg] >> Bit) & 1;
+}
+
+bool HasRTM()            { return LookUpRegBit(7, 0, CPUID_EBX, 11); }
+bool HasRTMALWAYSABORT() { return LookUpRegBit(7, 0, CPUID_EDX, 11); }
+bool HasTSXFORCEABORT()  { return LookUpRegBit(7, 0, CPUID_EDX, 13); }
+
+// aligned so that the threads' counters never share a cache line
+
+typedef struct ABORT_STATS
+{
+    __declspec(align(64))
+    uint64_t Attempts;
+    uint64_t Commits;
+    uint64_t Conflict;
+    uint64_t Capacity;
+    uint64_t Retry;
+    uint64_t Explicit;
+    uint64_t LockBusy;
+    uint64_t Other;                    // no status bit set
+    uint64_t Operations;
+    uint64_t Fallbacks;
+} ABORT_STATS;
+
+void TallyAbort(ABORT_STATS *Stats, unsigned int Status)
+{
+    if (Status & _XABORT_CONFLICT)
+        Stats->Conflict++;
+
+    if (Status & _XABORT_CAPACITY)
+        Stats->Capacity++;
+
+    if (Status & _XABORT_RETRY)
+        Stats->Retry++;
+
+    if (Status & _XABORT_EXPLICIT)
+    {
+        if (_XABORT_CODE(Status) == LOCK_BUSY)
+            Stats->LockBusy++;
+        else
+            Stats->Explicit++;
+    }
+
+    if ((Status & (_XABORT_EXPLICIT | _XABORT_RETRY | _XABORT_CONFLICT | _XABORT_CAPACITY | _XABORT_DEBUG | _XABORT_NESTED)) == 0)
+        Stats->Other++;
+}
+
+double Percent(uint64_t Count, uint64_t Total)
+{
+    return Total ? 100.0 * (double)Count / (double)Total : 0.0;
+}
+
+//
+// XBEGIN either starts a transaction, aborts right away, or raises #UD
+// when RTM is not there at all.  An exception inside a transaction only
+// aborts it, so a fault here comes from XBEGIN itself.
+//
+
+bool ProbeRtm(DWORD *ExceptionCode)
+{
+    __try
+    {
+        unsigned int Status = _xbegin();
+
+        if (Status == _XBEGIN_STARTED)
+            _xend();
+    }
+    __except (EXCEPTION_EXECUTE_HANDLER)
+    {
+        *ExceptionCode = GetExceptionCode();
+        return false;
+    }
+
+    return true;
+}
+
+double CalibrateTscPerNs()
+{
+    LARGE_INTEGER Freq, Start, Stop;
+    QueryPerformanceFrequency(&Freq);
+
+    QueryPerformanceCounter(&Start);
+    uint64_t TscStart = __rdtsc();
+
+    do
+    {
+        QueryPerformanceCounter(&Stop);
+    } while ((Stop.QuadPart - Start.QuadPart) < (Freq.QuadPart / 10));
+
+    uint64_t TscStop = __rdtsc();
+
+    double Ns = (double)(Stop.QuadPart - Start.QuadPart) * 1e9 / (double)Freq.QuadPart;
+
+    return (double)(TscStop - TscStart) / Ns;
+}
+
+bool PinToCpu(uint32_t Index)
+{
+    GROUP_AFFINITY Affinity = { 0 };
+
+    Affinity.Group = Cpus[Index].Group;
+    Affinity.Mask = (KAFFINITY)1 << Cpus[Index].Number;
+
+    if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+        return false;
+
+    SwitchToThread();
+    return true;
+}
+
+void EnumerateCpus()
+{
+    WORD Groups = GetActiveProcessorGroupCount();
+
+    for (WORD Group = 0; Group < Groups; Group++)
+    {
+        DWORD Count = GetActiveProcessorCount(Group);
+
+        for (DWORD Number = 0; (Number < Count) && (CpuCount < MAX_CPUS); Number++)
+        {
+            Cpus[CpuCount].Group = Group;
+            Cpus[CpuCount].Number = (BYTE)Number;
+            CpuCount++;
+        }
+    }
+}
+
+//
+// Read and write set sizes.  Each transaction reads ReadLines and then
+// writes WriteLines distinct cache lines of a private buffer, which is
+// touched beforehand so that no page fault aborts it.
+//
+
+__declspec(align(64)) volatile uint64_t SetLines[MAX_SET_LINES][8];
+
+volatile uint64_t Sink;
+uint64_t SetCommits = 0;
+
+void MeasureSetSize(uint32_t ReadLines, uint32_t WriteLines)
+{
+    ABORT_STATS Stats = { 0 };
+    uint64_t Sum = 0;
+
+    for (uint32_t i = 0; i < MAX_SET_LINES; i++)
+        SetLines[i][0] = i;
+
+    uint64_t Start = __rdtsc();
+
+    for (uint32_t a = 0; a < ATTEMPTS; a++)
+    {
+        Stats.Attempts++;
+
+        unsigned int Status = _xbegin();
+
+        if (Status == _XBEGIN_STARTED)
+        {
+            uint64_t Value = 0;
+
+            for (uint32_t r = 0; r < ReadLines; r++)
+                Value += SetLines[r][0];
+
+            for (uint32_t w = 0; w < WriteLines; w++)
+                SetLines[w][1] = a;
+
+            _xend();
+
+            Sum += Value;
+            Stats.Commits++;
+        }
+        else
+        {
+            TallyAbort(&Stats, Status);
+        }
+    }
+
+    double Ns = (double)(__rdtsc() - Start) / TscPerNs / ATTEMPTS;
+
+    Sink = Sum;
+    SetCommits += Stats.Commits;
+
+    double CommitPct   = Percent(Stats.Commits,  Stats.Attempts);
+    double ConflictPct = Percent(Stats.Conflict, Stats.Attempts);
+    double CapacityPct = Percent(Stats.Capacity, Stats.Attempts);
+    double RetryPct    = Percent(Stats.Retry,    Stats.Attempts);
+    double ExplicitPct = Percent(Stats.Explicit, Stats.Attempts);
+    double OtherPct    = Percent(Stats.Other,    Stats.Attempts);
+
+    if (CsvOutput)
+    {
+        printf("set,%u,%u,%.1f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n", ReadLines, WriteLines, Ns,
+            CommitPct, ConflictPct, CapacityPct, RetryPct, ExplicitPct, OtherPct);
+    }
+    else
+    {
+        printf("%6u %6u %10.1f %8.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n", ReadLines, WriteLines, Ns,
+            CommitPct, ConflictPct, CapacityPct, RetryPct, ExplicitPct, OtherPct);
+    }
+}
+
+//
+// Lock elision.  A transaction reads the fallback lock so that it aborts
+// as soon as another thread takes it, and gives up with LOCK_BUSY if it is
+// already taken.  After RETRIES failed attempts the thread takes the lock.
+//
+
+__declspec(align(64)) volatile LONG FallbackLock;
+__declspec(align(64)) volatile LONG Counters[MAX_SLOTS][16];
+
+typedef struct WORKER
+{
+    __declspec(align(64))
+    uint32_t       Cpu;
+    uint32_t       Slots;
+    uint64_t       Seed;
+    volatile LONG *Ready;
+    volatile LONG *Go;
+    ABORT_STATS    Stats;
+} WORKER;
+
+DWORD WINAPI WorkerProc(LPVOID Param)
+{
+    WORKER *Worker = (WORKER *)Param;
+    ABORT_STATS *Stats = &Worker->Stats;
+
+    PinToCpu(Worker->Cpu);
+    _InterlockedIncrement(Worker->Ready);
+
+    while (*Worker->Go == 0)
+        YieldProcessor();
+
+    uint64_t Stop = __rdtsc() + (uint64_t)(RUN_MS * 1e6 * TscPerNs);
+
+    while (__rdtsc() < Stop)
+    {
+        Worker->Seed = Worker->Seed * 6364136223846793005ull + 1442695040888963407ull;
+
+        uint32_t Slot = (uint32_t)(Worker->Seed >> 32) % Worker->Slots;
+        bool Done = false;
+
+        for (uint32_t r = 0; (r < RETRIES) && !Done; r++)
+        {
+            while (FallbackLock)
+                YieldProcessor();
+
+            Stats->Attempts++;
+
+            unsigned int Status = _xbegin();
+
+            if (Status == _XBEGIN_STARTED)
+            {
+                if (FallbackLock)
+                    _xabort(LOCK_BUSY);
+
+                Counters[Slot][0]++;
+                _xend();
+
+                Stats->Commits++;
+                Done = true;
+            }
+            else
+            {
+                TallyAbort(Stats, Status);
+            }
+        }
+
+        if (!Done)
+        {
+            while (_InterlockedExchange(&FallbackLock, 1))
+            {
+                while (FallbackLock)
+                    YieldProcessor();
+            }
+
+            Counters[Slot][0]++;
+            _InterlockedExchange(&FallbackLock, 0);
+
+            Stats->Fallbacks++;
+        }
+
+        Stats->Operations++;
+    }
+
+    return 0;
+}
+
+WORKER Workers[MAX_CPUS];
+HANDLE Handles[MAX_CPUS];
+
+void MeasureElision(uint32_t Threads, uint32_t Slots)
+{
+    volatile LONG Ready = 0;
+    volatile LONG Go = 0;
+    uint32_t Count = 0;
+
+    memset((void *)Counters, 0, sizeof(Counters));
+    FallbackLock = 0;
+
+    for (uint32_t t = 0; t < Threads; t++)
+    {
+        WORKER *Worker = &Workers[t];
+
+        memset(Worker, 0, sizeof(*Worker));
+        Worker->Cpu = t;
+        Worker->Slots = Slots;
+        Worker->Seed = 12345 + t;
+        Worker->Ready = &Ready;
+        Worker->Go = &Go;
+
+        Handles[Count] = CreateThread(NULL, 0, WorkerProc, Worker, 0, NULL);
+
+        if (Handles[Count] == NULL)
+        {
+            printf("CreateThread failed with error %u\n", GetLastError());
+            break;
+        }
+
+        Count++;
+    }
+
+    while (Ready < (LONG)Count)
+        SwitchToThread();
+
+    Go = 1;
+
+    ABORT_STATS Total = { 0 };
+
+    for (uint32_t i = 0; i < Count; i++)
+    {
+        WaitForSingleObject(Handles[i], INFINITE);
+        CloseHandle(Handles[i]);
+
+        const ABORT_STATS *Stats = &Workers[i].Stats;
+
+        Total.Attempts   += Stats->Attempts;
+        Total.Commits    += Stats->Commits;
+        Total.Conflict   += Stats->Conflict;
+        Total.Capacity   += Stats->Capacity;
+        Total.LockBusy   += Stats->LockBusy;
+        Total.Other      += Stats->Other;
+        Total.Operations += Stats->Operations;
+        Total.Fallbacks  += Stats->Fallbacks;
+    }
+
+    uint64_t Counted = 0;
+
+    for (uint32_t s = 0; s < Slots; s++)
+        Counted += (ULONG)Counters[s][0];
+
+    bool CountOk = (Counted == Total.Operations);
+
+    double Mops = (double)Total.Operations / (RUN_MS * 1000.0);
+
+    double CommitPct   = Percent(Total.Commits,   Total.Attempts);
+    double FallbackPct = Percent(Total.Fallbacks, Total.Operations);
+    double ConflictPct = Percent(Total.Conflict,  Total.Attempts);
+    double CapacityPct = Percent(Total.Capacity,  Total.Attempts);
+    double BusyPct     = Percent(Total.LockBusy,  Total.Attempts);
+    double OtherPct    = Percent(Total.Other,     Total.Attempts);
+
+    if (CsvOutput)
+    {
+        printf("elision,%u,%u,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%u\n", Count, Slots, Mops,
+            CommitPct, FallbackPct, ConflictPct, CapacityPct, BusyPct, OtherPct, CountOk);
+    }
+    else
+    {
+        printf("%7u %8u %8.2f %8.2f %9.2f %9.2f %9.2f %9.2f %9.2f%s\n", Count, Slots, Mops,
+            CommitPct, FallbackPct, ConflictPct, CapacityPct, BusyPct, OtherPct, CountOk ? "" : "  COUNT MISMATCH");
+    }
+}
+
+const uint32_t ReadSets[]  = { 1, 16, 64, 256, 512, 1024, 4096 };
+const uint32_t WriteSets[] = { 1, 16, 64, 128, 256, 512 };
+const uint32_t SlotCounts[] = { 1, 16, MAX_SLOTS };
+
+#define READ_SETS   (sizeof(ReadSets) / sizeof(ReadSets[0]))
+#define WRITE_SETS  (sizeof(WriteSets) / sizeof(WriteSets[0]))
+#define SLOT_COUNTS (sizeof(SlotCounts) / sizeof(SlotCounts[0]))
+
+#endif // _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+int __cdecl main(int argc, char **argv)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        if (!_stricmp(argv[i], "-csv"))
+            CsvOutput = true;
+        else
+        {
+            printf("Usage: tsx [-csv]\n");
+            return 1;
+        }
+    }
+
+#if _M_IX86 || (_M_AMD64 && !_M_ARM64EC)
+
+    // try XBEGIN even when CPUID denies RTM, it may be masked rather than absent
+
+    DWORD ExceptionCode = 0;
+    bool Executes = ProbeRtm(&ExceptionCode);
+
+    if (CsvOutput)
+    {
+        printf("rtm,%u,%u,%u,%u\n", HasRTM(), HasRTMALWAYSABORT(), HasTSXFORCEABORT(), Executes);
+    }
+    else
+    {
+        printf("\nRTM advertised: %s, RTM_ALWAYS_ABORT: %s, TSX_FORCE_ABORT: %s\n",
+            HasRTM() ? "yes" : "no", HasRTMALWAYSABORT() ? "yes" : "no", HasTSXFORCEABORT() ? "yes" : "no");
+
+        if (Executes)
+            printf("XBEGIN executes.\n");
+        else
+            printf("XBEGIN raised exception %08X, RTM is not usable here.\n", ExceptionCode);
+    }
+
+    if (!Executes)
+        return 0;
+
+    EnumerateCpus();
+    PinToCpu(0);
+
+    TscPerNs = CalibrateTscPerNs();
+
+    if (!CsvOutput)
+    {
+        printf("\nRead and write set sizes in cache lines, %u transactions each, %% of attempts.\n\n", ATTEMPTS);
+        printf("%6s %6s %10s %8s %9s %9s %9s %9s %9s\n", "read", "write", "ns/xact", "commit", "conflict", "capacity", "retry", "explicit", "other");
+    }
+
+    for (uint32_t s = 0; s < READ_SETS; s++)
+        MeasureSetSize(ReadSets[s], 0);
+
+    for (uint32_t s = 0; s < WRITE_SETS; s++)
+        MeasureSetSize(0, WriteSets[s]);
+
+    // with RTM_ALWAYS_ABORT, or disabled under a hypervisor, XBEGIN executes but never commits
+
+    if (SetCommits == 0)
+    {
+        if (!CsvOutput)
+            printf("\nNo transaction committed, lock elision is not worth enabling here.\n");
+
+        return 0;
+    }
+
+    if (!CsvOutput)
+    {
+        printf("\nLock elided counter increments, %u retries before taking the lock, %% of attempts\n", RETRIES);
+        printf("except fallback, which is %% of increments.\n\n");
+        printf("%7s %8s %8s %8s %9s %9s %9s %9s %9s\n", "threads", "counters", "Mops/s", "commit", "fallback", "conflict", "capacity", "lock busy", "other");
+    }
+
+    for (uint32_t c = 0; c < SLOT_COUNTS; c++)
+    {
+        for (uint32_t Threads = 1; ; Threads = min(Threads * 2, CpuCount))
+        {
+            MeasureElision(Threads, SlotCounts[c]);
+
+            if (Threads == CpuCount)
+                break;
+        }
+    }
+
+#else
+
+    printf("This probe uses the x86 RTM instructions, run the x64 build to test the emulator on ARM64.\n");
+
+#endif
+
+    return 0;
+}
+
@@ -0,0 +1,305 @@
+
+//
+// CALLPATH.C
+//
+// Time the cost of different call shapes: direct, indirect through function
+// pointers and vtables, calls into external asm (CPUID64.ASM), tail calls,
+// thunks, deep recursion, and returns that defeat return-stack prediction.
+//
+// CPUIDMAX.C, CPUIDMAX-INDIRECT.C and CPUIDMAX-INTRIN.C show these call
+// shapes in the generated code.  This measures them.  Under emulation, and
+// for ARM64EC calling into x64 code through exit thunks, indirect calls are
+// among the most expensive operations, so the indirect call sites are run
+// at increasing polymorphism (number of distinct targets).
+//
+// 2026-10-19 darekm
+//
+
+#include <windows.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <intrin.h>
+
+#define CALLS         (10000000)
+#define MAX_TARGETS   (16)
+#define SEQ_LENGTH    (4096)           // must be a power of 2
+
+extern uint32_t CallIncrement(uint32_t Value);
+extern uint32_t CallTail(uint32_t Value);
+extern uint32_t CallThunk(uint32_t Value);
+extern uint32_t CallPopJmp(uint32_t Value);
+extern uint32_t CallUnbalanced(uint32_t Value);
+
+typedef uint32_t (AsmProc)(uint32_t);
+
+volatile uint32_t VolatileZero = 0;
+
+//
+// Sixteen distinct leaf functions so that indirect call sites can have up to
+// sixteen targets.  They must not be inlined or folded together by the linker.
+//
+
+#define DEFINE_LEAF(N) \
+    __declspec(noinline) uint32_t Leaf ## N(uint32_t Value) { return Value + N + 1; }
+
+DEFINE_LEAF(0)  DEFINE_LEAF(1)  DEFINE_LEAF(2)  DEFINE_LEAF(3)
+DEFINE_LEAF(4)  DEFINE_LEAF(5)  DEFINE_LEAF(6)  DEFINE_LEAF(7)
+DEFINE_LEAF(8)  DEFINE_LEAF(9)  DEFINE_LEAF(10) DEFINE_LEAF(11)
+DEFINE_LEAF(12) DEFINE_LEAF(13) DEFINE_LEAF(14) DEFINE_LEAF(15)
+
+AsmProc *LeafTable[MAX_TARGETS] =
+{
+    Leaf0,  Leaf1,  Leaf2,  Leaf3,  Leaf4,  Leaf5,  Leaf6,  Leaf7,
+    Leaf8,  Leaf9,  Leaf10, Leaf11, Leaf12, Leaf13, Leaf14, Leaf15,
+};
+
+//
+// C-style objects with a vtable pointer, as a C++ compiler would lay them out.
+//
+
+typedef struct SHAPE SHAPE;
+
+typedef struct SHAPE_VTBL
+{
+    uint32_t (*Step)(const SHAPE *Shape, uint32_t Value);
+} SHAPE_VTBL;
+
+struct SHAPE
+{
+    const SHAPE_VTBL *Vtbl;
+    uint32_t Bias;
+};
+
+#define DEFINE_METHOD(N) \
+    __declspec(noinline) uint32_t Step ## N(const SHAPE *Shape, uint32_t Value) { return Value + Shape->Bias + N; }
+
+DEFINE_METHOD(0)  DEFINE_METHOD(1)  DEFINE_METHOD(2)  DEFINE_METHOD(3)
+DEFINE_METHOD(4)  DEFINE_METHOD(5)  DEFINE_METHOD(6)  DEFINE_METHOD(7)
+DEFINE_METHOD(8)  DEFINE_METHOD(9)  DEFINE_METHOD(10) DEFINE_METHOD(11)
+DEFINE_METHOD(12) DEFINE_METHOD(13) DEFINE_METHOD(14) DEFINE_METHOD(15)
+
+const SHAPE_VTBL ShapeVtbls[MAX_TARGETS] =
+{
+    { Step0  }, { Step1  }, { Step2  }, { Step3  },
+    { Step4  }, { Step5  }, { Step6  }, { Step7  },
+    { Step8  }, { Step9  }, { Step10 }, { Step11 },
+    { Step12 }, { Step13 }, { Step14 }, { Step15 },
+};
+
+SHAPE Shapes[SEQ_LENGTH];
+
+//
+// The sequence of targets each indirect call site visits.
+//
+
+uint8_t Sequence[SEQ_LENGTH];
+
+void BuildSequence(uint32_t Targets, bool Random)
+{
+    uint32_t Seed = 12345;
+
+    for (uint32_t i = 0; i < SEQ_LENGTH; i++)
+    {
+        Seed = Seed * 1103515245 + 12345;
+        Sequence[i] = (uint8_t)(Random ? ((Seed >> 16) % Targets) : (i % Targets));
+
+        Shapes[i].Vtbl = &ShapeVtbls[Sequence[i]];
+        Shapes[i].Bias = 1;
+    }
+}
+
+__declspec(noinline) uint32_t Recurse(uint32_t Depth, uint32_t Value)
+{
+    if (Depth == 0)
+        return Value + VolatileZero;
+
+    return Recurse(Depth - 1, Value) + 1;
+}
+
+//
+// Timing helpers.  Every test returns its running total so that the
+// compiler cannot discard the calls.
+//
+
+LARGE_INTEGER TimerStart;
+
+void StartTimer()
+{
+    QueryPerformanceCounter(&TimerStart);
+}
+
+double StopTimerNs()
+{
+    LARGE_INTEGER Stop, Freq;
+    QueryPerformanceCounter(&Stop);
+    QueryPerformanceFrequency(&Freq);
+
+    return (double)(Stop.QuadPart - TimerStart.QuadPart) * 1e9 / (double)Freq.QuadPart;
+}
+
+uint32_t Sink = 0;
+double DirectNs = 0.0;
+
+void Report(const char *Name, uint32_t Targets, const char *Pattern, double Ns, uint32_t Calls)
+{
+    double NsPerCall = Ns / Calls;
+
+    printf("%-28s %3u  %-8s %9.2f %9.2f\n", Name, Targets, Pattern, NsPerCall, NsPerCall / DirectNs);
+}
+
+double TimeInline()
+{
+    uint32_t Total = 0;
+
+    StartTimer();
+
+    for (uint32_t i = 0; i < CALLS; i++)
+        Total = Total + 1 + VolatileZero;
+
+    double Ns = StopTimerNs();
+
+    Sink += Total;
+    return Ns;
+}
+
+double TimeDirect()
+{
+    uint32_t Total = 0;
+
+    StartTimer();
+
+    for (uint32_t i = 0; i < CALLS; i++)
+        Total = Leaf0(Total);
+
+    double Ns = StopTimerNs();
+
+    Sink += Total;
+    return Ns;
+}
+
+double TimeAsmDirect()
+{
+    uint32_t Total = 0;
+
+    StartTimer();
+
+    for (uint32_t i = 0; i < CALLS; i++)
+        Total = CallIncrement(Total);
+
+    double Ns = StopTimerNs();
+
+    Sink += Total;
+    return Ns;
+}
+
+// not inlined, so the compiler cannot turn the indirect call into a direct one
+
+__declspec(noinline) double TimeAsm(AsmProc *pfn)
+{
+    uint32_t Total = 0;
+
+    StartTimer();
+
+    for (uint32_t i = 0; i < CALLS; i++)
+        Total = (*pfn)(Total);
+
+    double Ns = StopTimerNs();
+
+    Sink += Total;
+    return Ns;
+}
+
+double TimeIndirect()
+{
+    uint32_t Total = 0;
+
+    StartTimer();
+
+    for (uint32_t i = 0; i < CALLS; i++)
+        Total = (*LeafTable[Sequence[i & (SEQ_LENGTH - 1)]])(Total);
+
+    double Ns = StopTimerNs();
+
+    Sink += Total;
+    return Ns;
+}
+
+double TimeVirtual()
+{
+    uint32_t Total = 0;
+
+    StartTimer();
+
+    for (uint32_t i = 0; i < CALLS; i++)
+    {
+        const SHAPE *Shape = &Shapes[i & (SEQ_LENGTH - 1)];
+        Total = Shape->Vtbl->Step(Shape, Total);
+    }
+
+    double Ns = StopTimerNs();
+
+    Sink += Total;
+    return Ns;
+}
+
+double TimeRecursion(uint32_t Depth)
+{
+    uint32_t Total = 0;
+    uint32_t Rounds = CALLS / Depth;
+
+    StartTimer();
+
+    for (uint32_t i = 0; i < Rounds; i++)
+        Total = Recurse(Depth, Total);
+
+    double Ns = StopTimerNs();
+
+    Sink += Total;
+    return Ns;
+}
+
+int __cdecl main()
+{
+    printf("\nCall path cost, %u calls per test.\n\n", CALLS);
+    printf("%-28s %3s  %-8s %9s %9s\n", "call path", "K", "pattern", "ns/call", "x direct");
+
+    // all results are relative to a plain direct call
+
+    DirectNs = TimeDirect() / CALLS;
+
+    Report("direct C call",             1, "-", TimeDirect(), CALLS);
+    Report("inlined (no call)",         1, "-", TimeInline(), CALLS);
+    Report("direct call into asm",      1, "-", TimeAsmDirect(), CALLS);
+    Report("indirect call into asm",    1, "-", TimeAsm(CallIncrement), CALLS);
+    Report("asm tail call",             1, "-", TimeAsm(CallTail), CALLS);
+    Report("asm thunk (jmp [mem])",     1, "-", TimeAsm(CallThunk), CALLS);
+    Report("return via pop+jmp",        1, "-", TimeAsm(CallPopJmp), CALLS);
+    Report("mismatched call/ret",       1, "-", TimeAsm(CallUnbalanced), CALLS);
+
+    for (uint32_t Random = 0; Random <= 1; Random++)
+    {
+        for (uint32_t Targets = 1; Targets <= MAX_TARGETS; Targets *= 2)
+        {
+            const char *Pattern = Random ? "random" : "cyclic";
+
+            BuildSequence(Targets, Random != 0);
+
+            Report("indirect via pointer",  Targets, Pattern, TimeIndirect(), CALLS);
+            Report("virtual via vtable",    Targets, Pattern, TimeVirtual(), CALLS);
+        }
+    }
+
+    // the return stack buffer is typically 16 to 32 entries deep
+
+    for (uint32_t Depth = 4; Depth <= 1024; Depth *= 2)
+    {
+        char Name[32];
+        sprintf_s(Name, sizeof(Name), "recursion depth %u", Depth);
+
+        Report(Name, 1, "-", TimeRecursion(Depth), (CALLS / Depth) * Depth);
+    }
+
+    return Sink == 0;
+}
+
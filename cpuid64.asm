@@ -6,6 +6,7 @@
 ;
 ;  2024-01-24   darekm
 ;  2025-07-26   darekm
+;  2026-10-19   darekm
 ;
 
     .RADIX  16t
@@ -36,5 +37,88 @@ CallXgetbv PROC C
     ret
 CallXgetbv ENDP
 
+;;
+;;  Call path helpers for CALLPATH.C
+;;
+;;  Each returns its argument plus one so that the callers can chain results.
+;;
+
+    align   4   ;; required for ARM64EC compatibility
+
+CallIncrement PROC C
+    IFDEF _X86_
+    mov   eax,dword ptr [esp+4]
+    ELSE
+    mov   eax,ecx
+    ENDIF
+    inc   eax
+    ret
+CallIncrement ENDP
+
+    align   4   ;; required for ARM64EC compatibility
+
+;; tail call, the direct JMP reuses the caller's return address
+
+CallTail PROC C
+    jmp   CallIncrement
+CallTail ENDP
+
+    align   4   ;; required for ARM64EC compatibility
+
+;; thunk, an indirect JMP through memory like an import or exit thunk
+
+CallThunk PROC C
+    IFDEF _X86_
+    jmp   dword ptr [ThunkTarget]
+    ELSE
+    jmp   qword ptr [ThunkTarget]
+    ENDIF
+CallThunk ENDP
+
+    align   4   ;; required for ARM64EC compatibility
+
+;; return through the stack without a RET, which leaves the return stack
+;; buffer holding a stale prediction for the caller's next RET
+
+CallPopJmp PROC C
+    IFDEF _X86_
+    mov   eax,dword ptr [esp+4]
+    inc   eax
+    pop   ecx
+    jmp   ecx
+    ELSE
+    lea   eax,[rcx+1]
+    pop   rdx
+    jmp   rdx
+    ENDIF
+CallPopJmp ENDP
+
+    align   4   ;; required for ARM64EC compatibility
+
+;; mismatched CALL/RET, the inner return address is discarded so the
+;; final RET does not return to where the return stack buffer predicts
+
+CallUnbalanced PROC C
+    call  @F
+@@:
+    IFDEF _X86_
+    add   esp,4
+    mov   eax,dword ptr [esp+4]
+    ELSE
+    add   rsp,8
+    mov   eax,ecx
+    ENDIF
+    inc   eax
+    ret
+CallUnbalanced ENDP
+
+    .DATA
+
+    IFDEF _X86_
+ThunkTarget DWORD CallIncrement
+    ELSE
+ThunkTarget QWORD CallIncrement
+    ENDIF
+
     END
 
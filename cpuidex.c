@@ -10,6 +10,7 @@
 //
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <intrin.h>
@@ -27,6 +28,8 @@ uint32_t MaxFuncExt = 0;
 
 uint32_t Warnings = 0;
 
+bool QuietLookUps = false;             // batch mode prints exactly one line per query
+
 typedef enum CPU_VENDOR
 {
     CPU_UNKNOWN = 0,
@@ -48,33 +51,107 @@ typedef enum CPUID_REGS
 
 extern unsigned __int64 CallXgetbv(unsigned int ECX);
 
+//
+// Each distinct Function and Sub pair is executed once and then answered from
+// this table, since CPUID traps to the hypervisor under virtualization.  Values
+// that differ between logical CPUs, such as the APIC ID, are read with
+// __cpuidex() directly.
+//
+
+#define CPUID_CACHE_SIZE (256)
+
+typedef struct CPUID_ENTRY
+{
+    uint32_t Function;
+    uint32_t Sub;
+    int      CpuInfo[4];
+} CPUID_ENTRY;
+
+CPUID_ENTRY CpuidCache[CPUID_CACHE_SIZE];
+uint32_t CpuidCacheCount = 0;
+
+void CachedCpuidex(int CpuInfo[4], uint32_t Function, uint32_t Sub)
+{
+    for (uint32_t i = 0; i < CpuidCacheCount; i++)
+    {
+        if ((CpuidCache[i].Function == Function) && (CpuidCache[i].Sub == Sub))
+        {
+            for (int Reg = 0; Reg < 4; Reg++)
+                CpuInfo[Reg] = CpuidCache[i].CpuInfo[Reg];
+
+            return;
+        }
+    }
+
+    __cpuidex(CpuInfo, Function, Sub);
+
+    if (CpuidCacheCount < CPUID_CACHE_SIZE)
+    {
+        CpuidCache[CpuidCacheCount].Function = Function;
+        CpuidCache[CpuidCacheCount].Sub = Sub;
+
+        for (int Reg = 0; Reg < 4; Reg++)
+            CpuidCache[CpuidCacheCount].CpuInfo[Reg] = CpuInfo[Reg];
+
+        CpuidCacheCount++;
+    }
+}
+
 //
 // Helper functions to probe CPUID by register, bit, bitfield, or string.
 //
 
-uint32_t LookUpReg(uint32_t Function, uint32_t Sub, CPUID_REGS Reg)
+//
+// When Function is out of range, Range and Limit, if not NULL, say which
+// range it is past and that range's highest function.
+//
+
+bool IsFunctionInRange(uint32_t Function, const char **Range, uint32_t *Limit)
 {
-    int CpuInfo[4] = { };
+    const char *Name = NULL;
+    uint32_t Max = 0;
 
     if ((Function > MaxFunc) && (Function < BaseFuncHyp))
     {
-        printf("Function %08X out of range for basic functions limit %08X\n", Function, MaxFunc);
-        return 0;
+        Name = "basic";
+        Max = MaxFunc;
     }
-
-    if (MaxFuncHyp && (Function > MaxFuncHyp) && (Function < BaseFuncExt))
+    else if (MaxFuncHyp && (Function > MaxFuncHyp) && (Function < BaseFuncExt))
     {
-        printf("Function %08X out of range for hyper functions limit %08X\n", Function, MaxFuncHyp);
-        return 0;
+        Name = "hyper";
+        Max = MaxFuncHyp;
+    }
+    else if (MaxFuncExt && (Function > MaxFuncExt))
+    {
+        Name = "extended";
+        Max = MaxFuncExt;
     }
 
-    if (MaxFuncExt && (Function > MaxFuncExt))
+    if (Range)
+        *Range = Name;
+
+    if (Limit)
+        *Limit = Max;
+
+    return Name == NULL;
+}
+
+uint32_t LookUpReg(uint32_t Function, uint32_t Sub, CPUID_REGS Reg)
+{
+    int CpuInfo[4] = { };
+
+    const char *Range;
+    uint32_t Limit;
+
+    if (!IsFunctionInRange(Function, &Range, &Limit))
     {
-        printf("Function %08X out of range for extended functions limit %08X\n", Function, MaxFuncExt);
+        if (!QuietLookUps)
+            printf("Function %08X out of range for %s functions limit %08X\n", Function, Range, Limit);
+
         return 0;
     }
 
-    __cpuidex(CpuInfo, Function, Sub);
+    CachedCpuidex(CpuInfo, Function, Sub);
 
     return CpuInfo[Reg];
 }
@@ -202,7 +279,6 @@ bool HasRTM()      { return LookUpRegBit(7, 0, CPUID_EBX, 11); }
 bool HasDEPRFPU()  { return LookUpRegBit(7, 0, CPUID_EBX, 13); }
 bool HasRDSEED()   { return LookUpRegBit(7, 0, CPUID_EBX, 18); }
 bool HasADX()      { return LookUpRegBit(7, 0, CPUID_EBX, 19); }
-bool HasRDPID()    { return LookUpRegBit(7, 0, CPUID_EBX, 22); }
 bool HasCLFLSHOP() { return LookUpRegBit(7, 0, CPUID_EBX, 23); }
 bool HasSHANI()    { return LookUpRegBit(7, 0, CPUID_EBX, 29); }
 
@@ -211,6 +287,9 @@ bool HasGFNI()     { return LookUpRegBit(7, 0, CPUID_ECX,  8); }
 bool HasVAES()     { return LookUpRegBit(7, 0, CPUID_ECX,  9); }
 bool HasVPCLMUL()  { return LookUpRegBit(7, 0, CPUID_ECX, 10); }
 bool HasLA57()     { return LookUpRegBit(7, 0, CPUID_ECX, 16); }
+bool HasRDPID()    { return LookUpRegBit(7, 0, CPUID_ECX, 22); }
+
+bool HasHYBRID()   { return LookUpRegBit(7, 0, CPUID_EDX, 15); }  // leaf 0x1A reports the core type
 
 bool HasSHA512()   { return LookUpRegBit(7, 1, CPUID_EAX,  0); }
 bool HasSM3()      { return LookUpRegBit(7, 1, CPUID_EAX,  1); }
@@ -256,6 +335,920 @@ bool HasAVX512POPCNTDQ(){return LookUpRegBit(7, 0, CPUID_ECX, 14); }
 #define WarnIfFeatureMissing(S,F) \
     if (0 == Has ## F ()) { printf ("Warning: feature %s is missing\n", S); Warnings++; }
 
+//
+// x86-64 psABI microarchitecture levels, which are what -march=x86-64-v2/v3/v4
+// and /arch:SSE4.2/AVX2/AVX512 target.
+//
+// See: https://gitlab.com/x86-psABIs/x86-64-ABI
+//
+// The names match the ShowIsFeaturePresent() labels so that the same table can
+// classify saved cpuidex output such as the files in results\.  LZCNT is shown
+// as ABM.  The SYSCALL bit of v1 is left out because Intel only reports it in
+// 64-bit mode, which would misclassify 32-bit runs.
+//
+
+// The OS must also enable the YMM and ZMM register state in XCR0.
+
+bool HasXCR0YMM()  { return HasOSXSAVE() && ((_xgetbv(0) & 0x06) == 0x06); }
+bool HasXCR0ZMM()  { return HasOSXSAVE() && ((_xgetbv(0) & 0xE6) == 0xE6); }
+
+typedef struct PSABI_FEATURE
+{
+    uint32_t    Level;
+    const char *Name;
+    bool      (*Has)();
+} PSABI_FEATURE;
+
+const PSABI_FEATURE PsAbiFeatures[] =
+{
+    { 1, "X87",      HasX87      },
+    { 1, "CMOV",     HasCMOV     },
+    { 1, "CX8",      HasCX8      },
+    { 1, "MMX",      HasMMX      },
+    { 1, "FXSAVE",   HasFXSR     },
+    { 1, "SSE",      HasSSE      },
+    { 1, "SSE2",     HasSSE2     },
+
+    { 2, "CX16",     HasCX16     },
+    { 2, "LAHF64",   HasLAHF64   },
+    { 2, "POPCNT",   HasPOPCNT   },
+    { 2, "SSE3",     HasSSE3     },
+    { 2, "SSSE3",    HasSSSE3    },
+    { 2, "SSE41",    HasSSE41    },
+    { 2, "SSE42",    HasSSE42    },
+
+    { 3, "AVX",      HasAVX      },
+    { 3, "AVX2",     HasAVX2     },
+    { 3, "BMI1",     HasBMI1     },
+    { 3, "BMI2",     HasBMI2     },
+    { 3, "F16C",     HasF16C     },
+    { 3, "FMA",      HasFMA      },
+    { 3, "ABM",      HasABM      },
+    { 3, "MOVBE",    HasMOVBE    },
+    { 3, "OSXSAVE",  HasOSXSAVE  },
+    { 3, "XCR0_YMM", HasXCR0YMM  },
+
+    { 4, "AVX512F",  HasAVX512F  },
+    { 4, "AVX512BW", HasAVX512BW },
+    { 4, "AVX512CD", HasAVX512CD },
+    { 4, "AVX512DQ", HasAVX512DQ },
+    { 4, "AVX512VL", HasAVX512VL },
+    { 4, "XCR0_ZMM", HasXCR0ZMM  },
+};
+
+#define PSABI_FEATURES  (sizeof(PsAbiFeatures) / sizeof(PsAbiFeatures[0]))
+#define PSABI_MAX_LEVEL (4)
+
+const char *PsAbiLevelNames[PSABI_MAX_LEVEL + 1] =
+{
+    "below x86-64",
+    "x86-64",
+    "x86-64-v2",
+    "x86-64-v3",
+    "x86-64-v4",
+};
+
+const char *PsAbiCompilerFlags[PSABI_MAX_LEVEL + 1] =
+{
+    "none, use a 32-bit x86 target",
+    "-march=x86-64     or /arch:SSE2",
+    "-march=x86-64-v2  or /arch:SSE4.2",
+    "-march=x86-64-v3  or /arch:AVX2",
+    "-march=x86-64-v4  or /arch:AVX512",
+};
+
+//
+// Feature sets are kept as a bit mask indexed by PsAbiFeatures[].
+//
+
+uint64_t GetPsAbiMask()
+{
+    uint64_t Mask = 0;
+
+    for (uint32_t i = 0; i < PSABI_FEATURES; i++)
+    {
+        if (PsAbiFeatures[i].Has())
+            Mask |= 1ull << i;
+    }
+
+    return Mask;
+}
+
+uint32_t GetPsAbiLevel(uint64_t Mask)
+{
+    uint32_t Level = 0;
+
+    for (Level = 1; Level <= PSABI_MAX_LEVEL; Level++)
+    {
+        for (uint32_t i = 0; i < PSABI_FEATURES; i++)
+        {
+            if ((PsAbiFeatures[i].Level == Level) && !(Mask & (1ull << i)))
+                return Level - 1;
+        }
+    }
+
+    return PSABI_MAX_LEVEL;
+}
+
+void ShowPsAbiMissing(uint64_t Mask, uint32_t Level)
+{
+    if (Level > PSABI_MAX_LEVEL)
+        return;
+
+    printf("Missing for %-12s =", PsAbiLevelNames[Level]);
+
+    for (uint32_t i = 0; i < PSABI_FEATURES; i++)
+    {
+        if ((PsAbiFeatures[i].Level <= Level) && !(Mask & (1ull << i)))
+            printf(" %s", PsAbiFeatures[i].Name);
+    }
+
+    printf("\n");
+}
+
+void ShowPsAbiLevel(uint64_t Mask)
+{
+    uint32_t Level = GetPsAbiLevel(Mask);
+
+    printf("x86-64 psABI level        = %s\n", PsAbiLevelNames[Level]);
+    printf("Recommended build target  = %s\n", PsAbiCompilerFlags[Level]);
+
+    ShowPsAbiMissing(Mask, Level + 1);
+}
+
+//
+// Read the feature rows of a saved cpuidex run.  Present features are shown by
+// name and missing ones as dashes.  Older versions printed OSXSAVE as OXSAVE.
+// If the run predates the XGETBV check, assume the OS enabled the register
+// state for whatever AVX and AVX-512 the CPU reports.
+//
+
+uint64_t ReadPsAbiMaskFromFile(const char *Path, bool *IsValid)
+{
+    FILE *File = NULL;
+    char Line[512];
+    uint64_t Mask = 0;
+    uint64_t Xcr0 = 0;
+    bool HasXcr0 = false;
+    bool InFeatures = false;
+
+    *IsValid = false;
+
+    if (fopen_s(&File, Path, "r") != 0)
+        return 0;
+
+    while (fgets(Line, sizeof(Line), File))
+    {
+        if (sscanf_s(Line, "xgetbv(0) intrinsic = %llX", &Xcr0) == 1)
+            HasXcr0 = true;
+
+        if (strstr(Line, "CPU features") || strstr(Line, "Modern features"))
+        {
+            InFeatures = true;
+            *IsValid = true;
+            continue;
+        }
+
+        if (strstr(Line, "Checking"))
+            InFeatures = false;
+
+        if (!InFeatures)
+            continue;
+
+        char *Context = NULL;
+
+        for (char *Token = strtok_s(Line, " \t\r\n", &Context); Token; Token = strtok_s(NULL, " \t\r\n", &Context))
+        {
+            if (!strcmp(Token, "OXSAVE"))
+                Token = "OSXSAVE";
+
+            for (uint32_t i = 0; i < PSABI_FEATURES; i++)
+            {
+                if (!strcmp(Token, PsAbiFeatures[i].Name))
+                    Mask |= 1ull << i;
+            }
+        }
+    }
+
+    fclose(File);
+
+    for (uint32_t i = 0; i < PSABI_FEATURES; i++)
+    {
+        if (PsAbiFeatures[i].Has == HasXCR0YMM)
+        {
+            if (HasXcr0 ? ((Xcr0 & 0x06) == 0x06) : (GetPsAbiLevel(Mask | (1ull << i)) >= 3))
+                Mask |= 1ull << i;
+        }
+
+        if (PsAbiFeatures[i].Has == HasXCR0ZMM)
+        {
+            if (HasXcr0 ? ((Xcr0 & 0xE6) == 0xE6) : (GetPsAbiLevel(Mask | (1ull << i)) >= 4))
+                Mask |= 1ull << i;
+        }
+    }
+
+    return Mask;
+}
+
+//
+// Classify each saved run, then the fleet as a whole.  The fleet can only be
+// built for the level that every host satisfies, i.e. the intersection.
+//
+
+typedef struct FLEET
+{
+    uint64_t Intersection;
+    uint32_t Population[PSABI_MAX_LEVEL + 1];
+    uint32_t Hosts;
+} FLEET;
+
+void ClassifyFleetHost(FLEET *Fleet, const char *Path)
+{
+    bool IsValid = false;
+    uint64_t Mask = ReadPsAbiMaskFromFile(Path, &IsValid);
+
+    if (!IsValid)
+    {
+        printf("%-14s %s\n", "unreadable", Path);
+        return;
+    }
+
+    uint32_t Level = GetPsAbiLevel(Mask);
+
+    printf("%-14s %s\n", PsAbiLevelNames[Level], Path);
+
+    Fleet->Intersection &= Mask;
+    Fleet->Population[Level]++;
+    Fleet->Hosts++;
+}
+
+//
+// The CRT does not expand wildcards in the command line unless setargv.obj
+// is linked in, so each argument is expanded here, relative to its own
+// directory.  An argument that matches nothing is classified as given.
+//
+
+int ShowFleetLevels(int Count, char **Paths)
+{
+    FLEET Fleet = { ~0ull };
+
+    printf("\n%-14s %s\n", "level", "snapshot");
+
+    for (int i = 0; i < Count; i++)
+    {
+        WIN32_FIND_DATAA FindData;
+        HANDLE hFind = FindFirstFileA(Paths[i], &FindData);
+
+        if (hFind == INVALID_HANDLE_VALUE)
+        {
+            ClassifyFleetHost(&Fleet, Paths[i]);
+            continue;
+        }
+
+        size_t DirLength = strlen(Paths[i]);
+
+        while ((DirLength > 0) && !strchr("\\/:", Paths[i][DirLength - 1]))
+            DirLength--;
+
+        do
+        {
+            char Path[MAX_PATH];
+
+            if (FindData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                continue;
+
+            if (sprintf_s(Path, sizeof(Path), "%.*s%s", (int)DirLength, Paths[i], FindData.cFileName) > 0)
+                ClassifyFleetHost(&Fleet, Path);
+        } while (FindNextFileA(hFind, &FindData));
+
+        FindClose(hFind);
+    }
+
+    if (Fleet.Hosts == 0)
+    {
+        printf("\nNo cpuidex snapshots found.\n");
+        return 1;
+    }
+
+    printf("\nPopulation of %u hosts:\n", Fleet.Hosts);
+
+    uint32_t AtLeast = 0;
+
+    for (int Level = PSABI_MAX_LEVEL; Level >= 0; Level--)
+    {
+        AtLeast += Fleet.Population[Level];
+        printf("%-14s = %4u hosts, %4u can run it\n", PsAbiLevelNames[Level], Fleet.Population[Level], AtLeast);
+    }
+
+    printf("\nFleet-wide intersection:\n");
+    ShowPsAbiLevel(Fleet.Intersection);
+
+    return 0;
+}
+
+//
+// Batch mode answers many queries from one process, for scripts that would
+// otherwise run cpuidex once per question.  Each input line is one of
+//
+//   Function [SubFunc]   a raw leaf, printed as by "cpuidex Function SubFunc"
+//   FEATURE              a feature name as shown in the feature rows, e.g. AVX2
+//   level                the x86-64 psABI level of this host
+//
+// and gets exactly one line of output, flushed right away so that a script can
+// keep a pipe open and read each answer as it goes.  Blank lines and lines
+// starting with # are skipped.
+//
+
+typedef struct FEATURE_NAME
+{
+    const char *Name;
+    bool      (*Has)();
+} FEATURE_NAME;
+
+const FEATURE_NAME FeatureNames[] =
+{
+    { "X87",             HasX87            },
+    { "TSC",             HasTSC            },
+    { "CMOV",            HasCMOV           },
+    { "FCMOV",           HasFCMOV          },
+    { "CX8",             HasCX8            },
+    { "MMX",             HasMMX            },
+    { "FXSAVE",          HasFXSR           },
+    { "SSE",             HasSSE            },
+    { "SSE2",            HasSSE2           },
+    { "HTT",             HasHTT            },
+    { "CLFLUSH",         HasCLFLUSH        },
+    { "SSE3",            HasSSE3           },
+    { "VME",             HasVME            },
+    { "DE",              HasDE             },
+    { "PSE",             HasPSE            },
+    { "MSR",             HasMSR            },
+    { "PAE",             HasPAE            },
+    { "APIC",            HasAPIC           },
+    { "SEP",             HasSEP            },
+    { "PAT",             HasPAT            },
+    { "CX16",            HasCX16           },
+    { "SSSE3",           HasSSSE3          },
+    { "SSE41",           HasSSE41          },
+    { "SSE42",           HasSSE42          },
+    { "POPCNT",          HasPOPCNT         },
+    { "AES",             HasAES            },
+    { "PCLMUL",          HasPCLMUL         },
+    { "XSAVE",           HasXSAVE          },
+    { "OSXSAVE",         HasOSXSAVE        },
+    { "RDTSCP",          HasRDTSCP         },
+    { "MOVBE",           HasMOVBE          },
+    { "MWAIT",           HasMONITOR        },
+    { "EIST",            HasEIST           },
+    { "VT-x",            HasVTX            },
+    { "SMX",             HasSMX            },
+    { "AVX",             HasAVX            },
+    { "F16C",            HasF16C           },
+    { "FMA",             HasFMA            },
+    { "RDRAND",          HasRDRAND         },
+    { "DEPRFPU",         HasDEPRFPU        },
+    { "TSCINV",          HasTSCINV         },
+    { "LAHF64",          HasLAHF64         },
+    { "ABM",             HasABM            },
+    { "SSE4A",           HasSSE4A          },
+    { "PREFETCH",        Has3DPREF         },
+    { "XOP",             HasXOP            },
+    { "LWP",             HasLWP            },
+    { "FMA4",            HasFMA4           },
+    { "TBM",             HasTBM            },
+    { "MWAITX",          HasMONITORX       },
+    { "MISALIGNSSE",     HasMISALNSSE      },
+    { "FSGSBASE",        HasFSGSBASE       },
+    { "RDSEED",          HasRDSEED         },
+    { "SMEP",            HasSMEP           },
+    { "FASTSTR",         HasREPMOVSB       },
+    { "CLFLUSHOPT",      HasCLFLSHOP       },
+    { "XSAVEOPT",        HasXSAVEOPT       },
+    { "XSAVEC",          HasXSAVEC         },
+    { "XGETBV",          HasXGETBV         },
+    { "XSAVES",          HasXSAVES         },
+    { "RDPID",           HasRDPID          },
+    { "BMI1",            HasBMI1           },
+    { "BMI2",            HasBMI2           },
+    { "AVX2",            HasAVX2           },
+    { "ADX",             HasADX            },
+    { "HLE",             HasHLE            },
+    { "RTM",             HasRTM            },
+    { "CET_SS",          HasCETSS          },
+    { "SHANI",           HasSHANI          },
+    { "GFNI",            HasGFNI           },
+    { "VAES",            HasVAES           },
+    { "VPCLMUL",         HasVPCLMUL        },
+    { "AVX-VNNI",        HasAVXVNNI        },
+    { "AVX-VNNI-INT8",   HasAVXVNNI8       },
+    { "AVX-VNNI-1NT16",  HasAVXVNNI16      },
+    { "AVX-IFMA",        HasAVXIFMA        },
+    { "AVX-NE-CONVERT",  HasAVXNECONV      },
+    { "SHA512",          HasSHA512         },
+    { "SM3",             HasSM3            },
+    { "SM4",             HasSM4            },
+    { "AVX512F",         HasAVX512F        },
+    { "AVX512DQ",        HasAVX512DQ       },
+    { "AVX512CD",        HasAVX512CD       },
+    { "AVX512BW",        HasAVX512BW       },
+    { "AVX512VL",        HasAVX512VL       },
+    { "AVX512_IFMA",     HasAVX512IFMA     },
+    { "AVX512_VNNI",     HasAVX512VNNI     },
+    { "AVX512_VBMI",     HasAVX512VBMI     },
+    { "AVX512_VBMI2",    HasAVX512VBMI2    },
+    { "AVX512_BF16",     HasAVX512BF16     },
+    { "AVX512_POPCNTDQ", HasAVX512POPCNTDQ },
+    { "CMPCCXADD",       HasCMPCCXADD      },
+    { "LASS",            HasLASS           },
+    { "LAM",             HasLAM            },
+    { "LA57",            HasLA57           },
+    { "AVX10",           HasAVX10          },
+    { "APX_F",           HasAPXF           },
+    { "RAOINT",          HasRAOINT         },
+    { "HYBRID",          HasHYBRID         },
+    { "XCR0_YMM",        HasXCR0YMM        },
+    { "XCR0_ZMM",        HasXCR0ZMM        },
+};
+
+#define FEATURE_NAMES (sizeof(FeatureNames) / sizeof(FeatureNames[0]))
+
+void ShowBatchQuery(char *Line)
+{
+    char *Context = NULL;
+    char *Token = strtok_s(Line, " \t\r\n", &Context);
+
+    if ((Token == NULL) || (Token[0] == '#'))
+        return;
+
+    if ((Token[0] >= '0') && (Token[0] <= '9'))
+    {
+        char *Sub = strtok_s(NULL, " \t\r\n", &Context);
+
+        uint32_t Function = strtoul(Token, NULL, 0);
+        uint32_t SubFunc = Sub ? strtoul(Sub, NULL, 0) : 0;
+
+        const char *Range;
+        uint32_t Limit;
+
+        printf("Function %08X[%08X]: ", Function, SubFunc);
+
+        if (IsFunctionInRange(Function, &Range, &Limit))
+        {
+            printf("%08X %08X %08X %08X\n",
+                LookUpReg(Function, SubFunc, CPUID_EAX),
+                LookUpReg(Function, SubFunc, CPUID_EBX),
+                LookUpReg(Function, SubFunc, CPUID_ECX),
+                LookUpReg(Function, SubFunc, CPUID_EDX));
+        }
+        else
+        {
+            printf("out of range for %s functions limit %08X\n", Range, Limit);
+        }
+    }
+
+    else if (!_stricmp(Token, "level"))
+    {
+        printf("level %s\n", PsAbiLevelNames[GetPsAbiLevel(GetPsAbiMask())]);
+    }
+
+    else
+    {
+        uint32_t i = 0;
+
+        while ((i < FEATURE_NAMES) && _stricmp(Token, FeatureNames[i].Name))
+            i++;
+
+        if (i < FEATURE_NAMES)
+            printf("%s %u\n", FeatureNames[i].Name, FeatureNames[i].Has() ? 1 : 0);
+        else
+            printf("%s unknown\n", Token);
+    }
+
+    fflush(stdout);
+}
+
+int ShowBatch(const char *Path)
+{
+    FILE *File = stdin;
+    char Line[256];
+
+    if ((Path != NULL) && (fopen_s(&File, Path, "r") != 0))
+    {
+        printf("Unable to open %s\n", Path);
+        return 1;
+    }
+
+    QuietLookUps = true;
+
+    while (fgets(Line, sizeof(Line), File))
+        ShowBatchQuery(Line);
+
+    QuietLookUps = false;
+
+    if (File != stdin)
+        fclose(File);
+
+    return 0;
+}
+
+//
+// Processor topology from the x2APIC ID of every logical CPU.
+//
+// Leaf 0x1F (or 0xB) gives the number of x2APIC ID bits at each level of the
+// package / die / module / core / SMT hierarchy.  Leaf 4 (or 0x8000001D on
+// AMD) gives how many IDs share each cache, which groups cores by L2 and L3.
+// Leaf 0x8000001E gives the AMD node and core IDs.  The IDs of every CPU are
+// read by running this thread on each CPU in turn.
+//
+
+#define MAX_CPUS    (1024)
+
+typedef struct LOGICAL_CPU
+{
+    WORD     Group;
+    BYTE     Number;
+    uint32_t ApicId;
+    uint32_t Package;
+    uint32_t Die;
+    uint32_t Module;
+    uint32_t Core;
+    uint32_t Thread;
+    uint32_t L2;
+    uint32_t L3;
+    uint32_t Node;
+    uint32_t CoreType;
+} LOGICAL_CPU;
+
+LOGICAL_CPU Cpus[MAX_CPUS];
+uint32_t CpuCount = 0;
+
+// Number of x2APIC ID bits at and below each level, 0 if the level is not
+// enumerated.  The ID of a level is the x2APIC ID shifted right by the shift
+// of the level below it.
+
+uint32_t SmtShift     = 0;
+uint32_t CoreShift    = 0;
+uint32_t ModuleShift  = 0;
+uint32_t TileShift    = 0;
+uint32_t DieShift     = 0;
+uint32_t PackageShift = 0;
+uint32_t L2Shift      = 0;
+uint32_t L3Shift      = 0;
+
+bool HasL3Cache = false;
+
+//
+// Leaf 0x1A EAX[31:24] core type on hybrid parts.
+//
+
+const char * LookUpCoreType(uint32_t CoreType)
+{
+    switch (CoreType)
+        {
+    case 0x00: return "-";
+    case 0x20: return "Atom (E-core)";
+    case 0x40: return "Core (P-core)";
+    default:   return "unknown core type";
+        }
+}
+
+uint32_t BitsToHold(uint32_t Count)
+{
+    uint32_t Bits = 0;
+
+    while ((1u << Bits) < Count)
+        Bits++;
+
+    return Bits;
+}
+
+void DecodeTopologyShifts()
+{
+    int CpuInfo[4];
+    uint32_t Leaf = (MaxFunc >= 0x1F) ? 0x1F : 0xB;
+
+    if (MaxFunc >= Leaf)
+    {
+        __cpuidex(CpuInfo, Leaf, 0);
+
+        if ((Leaf == 0x1F) && (CpuInfo[CPUID_EBX] == 0))
+            Leaf = 0xB;
+    }
+
+    if ((MaxFunc >= 0xB) && (__cpuidex(CpuInfo, Leaf, 0), CpuInfo[CPUID_EBX] != 0))
+    {
+        for (uint32_t Sub = 0; Sub < 8; Sub++)
+        {
+            __cpuidex(CpuInfo, Leaf, Sub);
+
+            uint32_t Type  = (CpuInfo[CPUID_ECX] >> 8) & 0xFF;
+            uint32_t Shift = CpuInfo[CPUID_EAX] & 0x1F;
+
+            if (Type == 0)
+                break;
+
+            switch (Type)
+                {
+            case 1: SmtShift    = Shift; break;
+            case 2: CoreShift   = Shift; break;
+            case 3: ModuleShift = Shift; break;
+            case 4: TileShift   = Shift; break;
+            case 5: DieShift    = Shift; break;
+                }
+
+            PackageShift = Shift;
+        }
+    }
+    else
+    {
+        // legacy enumeration: logical IDs per package from leaf 1, threads per core from AMD leaf 0x8000001E
+
+        PackageShift = BitsToHold((LookUpReg(1, 0, CPUID_EBX) >> 16) & 0xFF);
+
+        if (MaxFuncExt >= 0x80000008)
+        {
+            uint32_t CoreIdSize = (LookUpReg(0x80000008, 0, CPUID_ECX) >> 12) & 15;
+
+            if (CoreIdSize)
+                PackageShift = CoreIdSize;
+        }
+
+        if (MaxFuncExt >= 0x8000001E)
+            SmtShift = BitsToHold(((LookUpReg(0x8000001E, 0, CPUID_EBX) >> 8) & 0xFF) + 1);
+
+        CoreShift = PackageShift;
+    }
+
+    // cache sharing, using the AMD cache leaf when topology extensions are present
+
+    uint32_t CacheLeaf = 4;
+
+    if ((CpuVendor == CPU_AMD) && (MaxFuncExt >= 0x8000001D) && LookUpRegBit(0x80000001, 0, CPUID_ECX, 22))
+        CacheLeaf = 0x8000001D;
+
+    if ((CacheLeaf == 4) && (MaxFunc < 4))
+        return;
+
+    for (uint32_t Sub = 0; Sub < 16; Sub++)
+    {
+        __cpuidex(CpuInfo, CacheLeaf, Sub);
+
+        uint32_t Type    = CpuInfo[CPUID_EAX] & 0x1F;
+        uint32_t Level   = (CpuInfo[CPUID_EAX] >> 5) & 7;
+        uint32_t Sharing = ((CpuInfo[CPUID_EAX] >> 14) & 0xFFF) + 1;
+
+        if (Type == 0)
+            break;
+
+        if ((Level == 2) && (Type != 1))
+            L2Shift = BitsToHold(Sharing);
+
+        if ((Level == 3) && (Type != 1))
+        {
+            L3Shift = BitsToHold(Sharing);
+            HasL3Cache = true;
+        }
+    }
+}
+
+uint32_t ReadCurrentApicId()
+{
+    int CpuInfo[4];
+
+    if (MaxFunc >= 0xB)
+    {
+        __cpuidex(CpuInfo, 0xB, 0);
+
+        if (CpuInfo[CPUID_EBX] != 0)
+            return CpuInfo[CPUID_EDX];
+    }
+
+    __cpuidex(CpuInfo, 1, 0);
+    return ((uint32_t)CpuInfo[CPUID_EBX] >> 24) & 0xFF;
+}
+
+void EnumerateCpus()
+{
+    GROUP_AFFINITY Original;
+    GetThreadGroupAffinity(GetCurrentThread(), &Original);
+
+    DecodeTopologyShifts();
+
+    WORD Groups = GetActiveProcessorGroupCount();
+
+    for (WORD Group = 0; Group < Groups; Group++)
+    {
+        DWORD Count = GetActiveProcessorCount(Group);
+
+        for (DWORD Number = 0; (Number < Count) && (CpuCount < MAX_CPUS); Number++)
+        {
+            GROUP_AFFINITY Affinity = { 0 };
+            Affinity.Group = Group;
+            Affinity.Mask = (KAFFINITY)1 << Number;
+
+            if (!SetThreadGroupAffinity(GetCurrentThread(), &Affinity, NULL))
+                continue;
+
+            // make sure the thread has moved before reading the IDs
+
+            SwitchToThread();
+
+            LOGICAL_CPU *Cpu = &Cpus[CpuCount++];
+            uint32_t ApicId = ReadCurrentApicId();
+
+            Cpu->Group   = Group;
+            Cpu->Number  = (BYTE)Number;
+            Cpu->ApicId  = ApicId;
+            Cpu->Thread  = ApicId & ((1u << SmtShift) - 1);
+            Cpu->Core    = ApicId >> SmtShift;
+            Cpu->Module  = ModuleShift ? (ApicId >> CoreShift) : Cpu->Core;
+            Cpu->Package = ApicId >> PackageShift;
+            Cpu->Die     = DieShift ? (ApicId >> (TileShift ? TileShift : (ModuleShift ? ModuleShift : CoreShift))) : Cpu->Package;
+            Cpu->L2      = ApicId >> L2Shift;
+            Cpu->L3      = HasL3Cache ? (ApicId >> L3Shift) : Cpu->Package;
+            Cpu->Node    = 0;
+            Cpu->CoreType = 0;
+
+            if (HasHYBRID() && (MaxFunc >= 0x1A))
+            {
+                int CpuInfo[4];
+                __cpuidex(CpuInfo, 0x1A, 0);
+                Cpu->CoreType = (uint32_t)CpuInfo[CPUID_EAX] >> 24;
+            }
+
+            if ((CpuVendor == CPU_AMD) && (MaxFuncExt >= 0x8000001E))
+            {
+                int CpuInfo[4];
+                __cpuidex(CpuInfo, 0x8000001E, 0);
+                Cpu->Node = CpuInfo[CPUID_ECX] & 0xFF;
+            }
+        }
+    }
+
+    SetThreadGroupAffinity(GetCurrentThread(), &Original, NULL);
+}
+
+uint32_t CountDistinct(size_t Offset)
+{
+    uint32_t Distinct = 0;
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        uint32_t Id = *(uint32_t *)((uint8_t *)&Cpus[i] + Offset);
+        bool Seen = false;
+
+        for (uint32_t j = 0; (j < i) && !Seen; j++)
+            Seen = (*(uint32_t *)((uint8_t *)&Cpus[j] + Offset) == Id);
+
+        if (!Seen)
+            Distinct++;
+    }
+
+    return Distinct;
+}
+
+//
+// Print a set of CPUs as Windows processor group affinity masks and as a CPU list.
+//
+
+void ShowCpuSet(const char *Label, const bool *Selected)
+{
+    printf("  %-12s", Label);
+
+    for (WORD Group = 0; Group < GetActiveProcessorGroupCount(); Group++)
+    {
+        KAFFINITY Mask = 0;
+
+        for (uint32_t i = 0; i < CpuCount; i++)
+        {
+            if (Selected[i] && (Cpus[i].Group == Group))
+                Mask |= (KAFFINITY)1 << Cpus[i].Number;
+        }
+
+        if (Mask)
+            printf(" group %u mask 0x%llX", Group, (unsigned long long)Mask);
+    }
+
+    printf("  cpus");
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        if (Selected[i])
+            printf(" %u", i);
+    }
+
+    printf("\n");
+}
+
+//
+// A CPU leads its core (or its L3 domain) if no earlier CPU shares it.
+//
+
+bool IsFirstThreadOfCore(uint32_t Index)
+{
+    for (uint32_t j = 0; j < Index; j++)
+    {
+        if ((Cpus[j].Package == Cpus[Index].Package) && (Cpus[j].Core == Cpus[Index].Core))
+            return false;
+    }
+
+    return true;
+}
+
+bool IsFirstOfL3(uint32_t Index)
+{
+    for (uint32_t j = 0; j < Index; j++)
+    {
+        if (Cpus[j].L3 == Cpus[Index].L3)
+            return false;
+    }
+
+    return true;
+}
+
+int ShowTopology()
+{
+    LookUpVendorString();
+    EnumerateCpus();
+
+    if (CpuCount == 0)
+    {
+        printf("Unable to enumerate the logical processors.\n");
+        return 1;
+    }
+
+    printf("\nx2APIC ID shifts: SMT %u, core %u, module %u, tile %u, die %u, package %u, L2 %u, L3 %u\n",
+        SmtShift, CoreShift, ModuleShift, TileShift, DieShift, PackageShift, L2Shift, L3Shift);
+
+    printf("\n%4s %9s %8s %7s %4s %6s %5s %3s %4s %4s %4s  %s\n",
+        "cpu", "group:num", "x2apic", "package", "die", "module", "core", "smt", "L2", "L3", "node", "type");
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        LOGICAL_CPU *Cpu = &Cpus[i];
+
+        printf("%4u %6u:%-2u %8X %7u %4u %6u %5u %3u %4u %4u %4u  %s\n",
+            i, Cpu->Group, Cpu->Number, Cpu->ApicId, Cpu->Package, Cpu->Die, Cpu->Module,
+            Cpu->Core, Cpu->Thread, Cpu->L2, Cpu->L3, Cpu->Node, LookUpCoreType(Cpu->CoreType));
+    }
+
+    printf("\n%u packages, %u dies, %u modules, %u cores, %u logical CPUs, %u L2 and %u L3 domains\n",
+        CountDistinct(offsetof(LOGICAL_CPU, Package)),
+        CountDistinct(offsetof(LOGICAL_CPU, Die)),
+        CountDistinct(offsetof(LOGICAL_CPU, Module)),
+        CountDistinct(offsetof(LOGICAL_CPU, Core)),
+        CpuCount,
+        CountDistinct(offsetof(LOGICAL_CPU, L2)),
+        CountDistinct(offsetof(LOGICAL_CPU, L3)));
+
+    static bool Selected[MAX_CPUS];
+    char Label[32];
+
+    printf("\nAffinity plan: one worker per physical core, grouped by shared L3:\n");
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        if (!IsFirstOfL3(i))
+            continue;
+
+        for (uint32_t j = 0; j < CpuCount; j++)
+            Selected[j] = (Cpus[j].L3 == Cpus[i].L3) && IsFirstThreadOfCore(j);
+
+        sprintf_s(Label, sizeof(Label), "L3 %u", Cpus[i].L3);
+        ShowCpuSet(Label, Selected);
+    }
+
+    printf("\nAffinity plan: all logical CPUs, grouped by shared L3:\n");
+
+    for (uint32_t i = 0; i < CpuCount; i++)
+    {
+        if (!IsFirstOfL3(i))
+            continue;
+
+        for (uint32_t j = 0; j < CpuCount; j++)
+            Selected[j] = (Cpus[j].L3 == Cpus[i].L3);
+
+        sprintf_s(Label, sizeof(Label), "L3 %u", Cpus[i].L3);
+        ShowCpuSet(Label, Selected);
+    }
+
+    printf("\nAffinity plan: one worker per physical core:\n");
+
+    for (uint32_t j = 0; j < CpuCount; j++)
+        Selected[j] = IsFirstThreadOfCore(j);
+
+    ShowCpuSet("cores", Selected);
+
+    printf("\nAffinity plan: one worker per L3 domain:\n");
+
+    for (uint32_t j = 0; j < CpuCount; j++)
+        Selected[j] = IsFirstOfL3(j);
+
+    ShowCpuSet("L3 leaders", Selected);
+
+    return 0;
+}
+
 //
 // Return a string indicating the instruction set and mode of this process.
 //
@@ -399,6 +1392,33 @@ int __cdecl main(int argc, char **argv)
     MaxFuncExt = HasExtFuncs ? MaxFuncExt : 0;
 
     // now we can look up arbitrary functions
+    // check for one of the report modes
+
+    if ((argc > 1) && (argv[1][0] == '-'))
+    {
+        if (!_stricmp(argv[1], "-level"))
+        {
+            ShowPsAbiLevel(GetPsAbiMask());
+            return 0;
+        }
+
+        if (!_stricmp(argv[1], "-fleet"))
+            return ShowFleetLevels(argc - 2, &argv[2]);
+
+        if (!_stricmp(argv[1], "-topology"))
+            return ShowTopology();
+
+        if (!_stricmp(argv[1], "-batch"))
+            return ShowBatch((argc > 2) ? argv[2] : NULL);
+
+        printf("Usage: cpuidex [Function [SubFunc]]\n");
+        printf("       cpuidex -level                 show the x86-64 psABI level of this host\n");
+        printf("       cpuidex -fleet file [file...]  classify saved cpuidex output, e.g. results\\*.txt\n");
+        printf("       cpuidex -topology              show the CPU topology and thread affinity plans\n");
+        printf("       cpuidex -batch [file]          answer queries from a file or stdin, one line each\n");
+        return 1;
+    }
+
     // check if we're looking up a specific function
 
     if (argc > 1)
@@ -578,7 +1598,7 @@ int __cdecl main(int argc, char **argv)
     ShowIsFeaturePresent("XGETBV",  XGETBV);
     ShowIsFeaturePresent("XSAVES",  XSAVES);
     printf("\n");
-//  ShowIsFeaturePresent("RDPID",   RDPID);
+    ShowIsFeaturePresent("RDPID",   RDPID);
     ShowIsFeaturePresent("BMI1",    BMI1);
     ShowIsFeaturePresent("BMI2",    BMI2);
     ShowIsFeaturePresent("AVX2",    AVX2);
@@ -624,8 +1644,12 @@ int __cdecl main(int argc, char **argv)
     ShowIsFeaturePresent("AVX10",   AVX10);
     ShowIsFeaturePresent("APX_F",   APXF);
     ShowIsFeaturePresent("RAOINT",  RAOINT);
+    ShowIsFeaturePresent("HYBRID",  HYBRID);
     printf("\n");
 
+    if (HasHYBRID() && (MaxFunc >= 0x1A))
+        printf("\nHybrid CPU, this thread is running on %s\n", LookUpCoreType(LookUpReg(0x1A, 0, CPUID_EAX) >> 24));
+
     printf("\nChecking for possible missing features:\n");
 
     WarnIfFeatureMissing("CLFLUSH", CLFLUSH);
@@ -700,6 +1724,10 @@ int __cdecl main(int argc, char **argv)
     if (tsc_tries_left == 0)
             printf("TSC consistency checks passed\n");
 
+    printf("\nChecking x86-64 microarchitecture level:\n");
+
+    ShowPsAbiLevel(GetPsAbiMask());
+
     if (Warnings == 0)
         printf("\nNo checks failed!\n");
     else
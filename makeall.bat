@@ -64,6 +64,7 @@ cl -c %CL_ARGS% cpuidex.c
 cl -c %CL_ARGS% cpuidmax.c
 cl -c %CL_ARGS% cpuidmax-indirect.c
 cl -c %CL_ARGS% cpuidmax-intrin.c
+cl -c %CL_ARGS% callpath.c
 
 @rem maximum debug information, remove dead code
 set LINK_ARGS=-debug -release -opt:ref -incremental:no
@@ -108,6 +109,7 @@ link %LINK_ARGS% cpuidmax-indirect.obj %LINK_LIBS%
 )
 
 link %LINK_ARGS% cpuidmax-intrin.obj   %LINK_LIBS%
+link %LINK_ARGS% callpath.obj          %LINK_LIBS%
 
 @endlocal
 